@@ -17,17 +17,37 @@
  */
 
 #include "archi.h"
+#include "assetpack.h"
 #include "decl.h"
 #include <zlib.h>
 #include <string.h>
 #include <stdlib.h>
+#include <sys/stat.h>
 
 /* this value is used as a sanity check for filnename lengths
  */
 #define FNAMELEN 250
 
+/* the local data file that remembers the checksum of the archive
+ * together with the size and modification time it was calculated for:
+ * "TTID", size, mtime, checksum, all 4 bytes little endian
+ */
+#define IDENT_NAME "archive.id"
+#define IDENT_SIZE 16
+
+static Uint32 getidentlong(const Uint8 *p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((Uint32) p[3] << 24);
+}
+
+static void putidentlong(Uint8 *p, Uint32 v) {
+    p[0] = v;
+    p[1] = v >> 8;
+    p[2] = v >> 16;
+    p[3] = v >> 24;
+}
+
 archive::archive(FILE *stream) :
-        f(stream) {
+        f(stream), identsum(0), identvalid(false) {
 
     assert_msg(f, "Data file not found");
 
@@ -108,9 +128,70 @@ archive::~archive() {
     fclose(f);
 }
 
+Uint32 archive::ident(void) {
+
+    if (!identvalid) {
+        Uint8 buf[0x4000];
+        size_t len;
+        struct stat st;
+        Uint32 size = 0, mtime = 0;
+
+        /* reading the whole archive takes long, so the checksum is only
+         * calculated again when the size or the time of the file changed */
+        if (fstat(fileno(f), &st) == 0) {
+            size = st.st_size;
+            mtime = st.st_mtime;
+
+            FILE *id = open_local_data_file(IDENT_NAME);
+            if (id) {
+                if ((fread(buf, IDENT_SIZE, 1, id) == 1) && !memcmp(buf, "TTID", 4)
+                        && (getidentlong(buf + 4) == size) && (getidentlong(buf + 8) == mtime)) {
+                    identsum = getidentlong(buf + 12);
+                    identvalid = true;
+                }
+                fclose(id);
+            }
+            if (identvalid)
+                return identsum;
+        }
+
+        long pos = ftell(f);
+
+        identsum = adler32(0L, Z_NULL, 0);
+
+        fseek(f, 0, SEEK_SET);
+        while ((len = fread(buf, 1, sizeof(buf), f)) > 0)
+            identsum = adler32(identsum, buf, len);
+
+        fseek(f, pos, SEEK_SET);
+        identvalid = true;
+
+        if (size || mtime) {
+            memcpy(buf, "TTID", 4);
+            putidentlong(buf + 4, size);
+            putidentlong(buf + 8, mtime);
+            putidentlong(buf + 12, identsum);
+            write_local_data_file(IDENT_NAME, buf, IDENT_SIZE);
+        }
+    }
+
+    return identsum;
+}
+
 file::file(const archive *arc, const char *name) :
         bufferpos(0) {
 
+    /* the asset pack contains the graphics files already uncompressed */
+    Uint32 rawsize;
+    const Uint8 *raw = pak_rawfile(name, rawsize);
+
+    if (raw) {
+        fsize = rawsize;
+        buffer = new Uint8[fsize];
+        memcpy(buffer, raw, fsize);
+        return;
+    }
+
     for (Uint8 i = 0; i < arc->filecount; i++) {
         if (strncmp(name, arc->files[i].name, FNAMELEN) == 0) {
 
@@ -133,6 +214,8 @@ file::file(const archive *arc, const char *name) :
             /* free temporary buffer */
             delete[] b;
 
+            pak_putraw(name, buffer, fsize);
+
             return;
         }
     }
@@ -74,6 +74,12 @@ public:
      */
     Uint16 getword(void);
 
+    /* skip over size bytes of the file
+     */
+    void skip(Uint32 size) {
+        bufferpos += size;
+    }
+
     /* creates an RW operation type from this file */
     SDL_RWops *rwOps(void);
 
@@ -109,6 +115,13 @@ public:
      */
     ~archive();
 
+    /* returns a checksum over the whole archive file, this changes
+     * whenever one of the files inside the archive changes. It is kept
+     * in a local data file and only calculated again when the size or
+     * the modification time of the archive are different
+     */
+    Uint32 ident(void);
+
 private:
 
     FILE *f;
@@ -130,6 +143,11 @@ private:
      */
     Uint8 filecount;
 
+    /* the checksum over the whole archive file, calculated on first use
+     */
+    Uint32 identsum;
+    bool identvalid;
+
     /* the constructor for the archive file must access the files and
      * filecount members, so it must be a friend
      */
@@ -0,0 +1,701 @@
+/* Tower Toppler - Nebulus
+ * Copyright (C) 2000-2006  Andreas Rver
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+#include "assetpack.h"
+
+#include "archi.h"
+#include "configuration.h"
+#include "decl.h"
+
+#include <zlib.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <dirent.h>
+
+#ifndef WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/* layout of the pack, all numbers are little endian:
+ *
+ * header (PAK_HEADERSIZE bytes)
+ *   0  8 magic
+ *   8  2 version
+ *  10  1 bytes per pixel of the sprites
+ *  11  1 byte order of the pixels (0 = little, 1 = big endian)
+ *  12 16 red, green, blue and alpha mask of the sprites
+ *  28  4 identification of the archive the pack was made from
+ *  32  4 number of blocks
+ *  36  4 position of the block directory
+ *  40  4 adler32 of the block directory
+ *  44  4 adler32 of the header bytes 0-43
+ *
+ * the blocks, each starting at a multiple of PAK_ALIGN
+ *
+ * the block directory with one entry of PAK_ENTRYSIZE bytes per block
+ *   0  1 kind of block (raw file or sprite)
+ *   1  1 codec (stored or deflated)
+ *   2  1 section and 3 1 alpha option (only sprites)
+ *   4  4 position
+ *   8  4 stored size
+ *  12  4 uncompressed size
+ *  16  4 adler32 of the stored data
+ *  20  2 width, 22 2 height, 24 2 pitch, 26 2 flags (only sprites)
+ *  28 20 name (only raw files)
+ */
+
+#define PAK_MAGIC "TTPACK\x1a\0"
+#define PAK_HEADERSIZE 48
+#define PAK_ENTRYSIZE 48
+#define PAK_NAMELEN 20
+#define PAK_ALIGN 16
+
+typedef enum {
+    PAK_RAW, PAK_SURFACE
+} pak_kind;
+
+typedef enum {
+    PAK_STORED, PAK_DEFLATED
+} pak_codec;
+
+/* sprite flags */
+#define PAKF_SRCALPHA 1
+#define PAKF_RLE      2
+
+typedef struct {
+    Uint8 kind, codec, section, alpha;
+    Uint32 pos, stored, size, check;
+    Uint16 w, h, pitch, flags;
+    char name[PAK_NAMELEN];
+
+    /* the usable data of the block, either inside of the mapped
+     * file or in an extra buffer, when the block was deflated */
+    Uint8 *data;
+    bool own;
+} pak_entry;
+
+/* the reader */
+static Uint8 *pakdata;
+static Uint32 paksize;
+static bool pakmapped;
+static pak_entry *entries;
+static Uint32 entrycount;
+static Uint32 cursor;
+
+/* the recorder */
+static bool recording;
+static bool caching;
+static char cachefile[MAX_PATH];
+static bool reccompress;
+static Uint32 recident;
+static pak_entry *recentries;
+static Uint32 reccount, recsize;
+static Uint8 recsection, recalpha;
+static bool recskip;
+
+static Uint32 getlong(const Uint8 *p) {
+    return (Uint32) p[0] | ((Uint32) p[1] << 8) | ((Uint32) p[2] << 16) | ((Uint32) p[3] << 24);
+}
+
+static Uint16 getword(const Uint8 *p) {
+    return (Uint16) p[0] | ((Uint16) p[1] << 8);
+}
+
+static void putlong(Uint8 *p, Uint32 v) {
+    p[0] = v;
+    p[1] = v >> 8;
+    p[2] = v >> 16;
+    p[3] = v >> 24;
+}
+
+static void putword(Uint8 *p, Uint16 v) {
+    p[0] = v;
+    p[1] = v >> 8;
+}
+
+static Uint32 checksum(const Uint8 *data, Uint32 len) {
+    return adler32(adler32(0L, Z_NULL, 0), data, len);
+}
+
+/* the format of the sprites as SDL_DisplayFormatAlpha creates them
+ * for the current display */
+static bool displayformat(Uint8 &bpp, Uint32 *masks) {
+    SDL_Surface *s = SDL_CreateRGBSurface(SDL_SWSURFACE, 1, 1, 32, 0xFF0000, 0x00FF00, 0x0000FF,
+            0xFF000000);
+    if (!s)
+        return false;
+
+    SDL_Surface *d = SDL_DisplayFormatAlpha(s);
+    SDL_FreeSurface(s);
+    if (!d)
+        return false;
+
+    bpp = d->format->BytesPerPixel;
+    masks[0] = d->format->Rmask;
+    masks[1] = d->format->Gmask;
+    masks[2] = d->format->Bmask;
+    masks[3] = d->format->Amask;
+
+    SDL_FreeSurface(d);
+    return true;
+}
+
+static void freeentries(void) {
+    for (Uint32 i = 0; i < entrycount; i++)
+        if (entries[i].own)
+            delete[] entries[i].data;
+    delete[] entries;
+    entries = 0;
+    entrycount = 0;
+}
+
+static void freerecord(void) {
+    for (Uint32 i = 0; i < reccount; i++)
+        delete[] recentries[i].data;
+    delete[] recentries;
+    recentries = 0;
+    reccount = recsize = 0;
+}
+
+static void unmap(void) {
+    if (!pakdata)
+        return;
+#ifndef WIN32
+    if (pakmapped)
+        munmap(pakdata, paksize);
+    else
+#endif
+        delete[] pakdata;
+    pakdata = 0;
+    paksize = 0;
+}
+
+/* maps the whole file into memory, when the system can't
+ * do that it's read instead */
+static bool mapfile(FILE *f) {
+    fseek(f, 0, SEEK_END);
+    long len = ftell(f);
+    fseek(f, 0, SEEK_SET);
+
+    if (len < PAK_HEADERSIZE)
+        return false;
+
+    paksize = len;
+    pakmapped = false;
+
+#ifndef WIN32
+    /* private and writable, because SDL may touch the pixels
+     * when it encodes or decodes RLE sprites */
+    void *m = mmap(NULL, paksize, PROT_READ | PROT_WRITE, MAP_PRIVATE, fileno(f), 0);
+    if (m != MAP_FAILED) {
+        pakdata = (Uint8*) m;
+        pakmapped = true;
+        return true;
+    }
+#endif
+
+    pakdata = new Uint8[paksize];
+    if (fread(pakdata, paksize, 1, f) != 1) {
+        unmap();
+        return false;
+    }
+    return true;
+}
+
+static bool readentry(const Uint8 *p, pak_entry *e) {
+    e->kind = p[0];
+    e->codec = p[1];
+    e->section = p[2];
+    e->alpha = p[3];
+    e->pos = getlong(p + 4);
+    e->stored = getlong(p + 8);
+    e->size = getlong(p + 12);
+    e->check = getlong(p + 16);
+    e->w = getword(p + 20);
+    e->h = getword(p + 22);
+    e->pitch = getword(p + 24);
+    e->flags = getword(p + 26);
+    memcpy(e->name, p + 28, PAK_NAMELEN);
+    e->name[PAK_NAMELEN - 1] = 0;
+    e->data = 0;
+    e->own = false;
+
+    if ((e->pos % PAK_ALIGN) || (e->pos > paksize) || (e->stored > paksize - e->pos))
+        return false;
+
+    if (checksum(pakdata + e->pos, e->stored) != e->check)
+        return false;
+
+    if (e->kind == PAK_SURFACE && (Uint32) e->pitch * e->h != e->size)
+        return false;
+
+    if (e->codec == PAK_STORED) {
+        if (e->stored != e->size)
+            return false;
+        e->data = pakdata + e->pos;
+    } else if (e->codec == PAK_DEFLATED) {
+        uLongf len = e->size;
+        e->data = new Uint8[e->size];
+        e->own = true;
+        if ((uncompress(e->data, &len, pakdata + e->pos, e->stored) != Z_OK) || (len != e->size))
+            return false;
+    } else
+        return false;
+
+    return true;
+}
+
+/* maps the pack and checks that it fits to the archive and the display
+ * and that nothing is damaged, the file is closed in any case */
+static bool openpack(FILE *f, archive *arc) {
+    if (!f)
+        return false;
+
+    bool ok = mapfile(f);
+    fclose(f);
+
+    if (!ok)
+        return false;
+
+    const Uint8 *h = pakdata;
+    Uint8 bpp;
+    Uint32 masks[4];
+
+    if (memcmp(h, PAK_MAGIC, 8) || (getword(h + 8) != PAK_VERSION)
+            || (getlong(h + 44) != checksum(h, 44))) {
+        debugprintf(1, "asset pack has wrong version or is damaged\n");
+        unmap();
+        return false;
+    }
+
+    if (!displayformat(bpp, masks) || (h[10] != bpp)
+            || (h[11] != ((SDL_BYTEORDER == SDL_BIG_ENDIAN) ? 1 : 0)) || (getlong(h + 12) != masks[0])
+            || (getlong(h + 16) != masks[1]) || (getlong(h + 20) != masks[2])
+            || (getlong(h + 24) != masks[3])) {
+        debugprintf(1, "asset pack doesn't fit the display format\n");
+        unmap();
+        return false;
+    }
+
+    if (getlong(h + 28) != arc->ident()) {
+        debugprintf(1, "asset pack doesn't fit the data archive\n");
+        unmap();
+        return false;
+    }
+
+    Uint32 count = getlong(h + 32);
+    Uint32 dir = getlong(h + 36);
+
+    if ((dir > paksize) || (count > (paksize - dir) / PAK_ENTRYSIZE)
+            || (checksum(pakdata + dir, count * PAK_ENTRYSIZE) != getlong(h + 40))) {
+        debugprintf(1, "asset pack directory is damaged\n");
+        unmap();
+        return false;
+    }
+
+    entries = new pak_entry[count];
+    for (Uint32 i = 0; i < count; i++) {
+        entrycount = i + 1;
+        if (!readentry(pakdata + dir + i * PAK_ENTRYSIZE, &entries[i])) {
+            debugprintf(1, "asset pack block %i is damaged\n", i);
+            pak_close();
+            return false;
+        }
+    }
+
+    cursor = entrycount;
+
+    debugprintf(2, "using asset pack with %i blocks\n", entrycount);
+
+    return true;
+}
+
+/* the sprite cache is an asset pack that the game creates by itself, its
+ * name contains all the things the sprites depend on, so a cache for
+ * a different archive, display or alpha configuration is never found */
+static Uint32 formatkey(void) {
+    Uint8 key[18];
+    Uint32 masks[4];
+
+    if (!displayformat(key[0], masks))
+        return 0;
+
+    key[1] = (SDL_BYTEORDER == SDL_BIG_ENDIAN) ? 1 : 0;
+    for (int i = 0; i < 4; i++)
+        putlong(key + 2 + 4 * i, masks[i]);
+
+    return checksum(key, sizeof(key));
+}
+
+/* false when there is no cache directory or the name doesn't fit */
+static bool cachename(archive *arc, char *name, int len) {
+    char dir[MAX_PATH];
+
+    if (!get_local_cache_dir(dir, sizeof(dir)))
+        return false;
+
+    int n = snprintf(name, len, "%s/sprites-%08x-%08x-%x.pak", dir, arc->ident(), formatkey(),
+            (config.use_alpha_sprites() ? 1 : 0) | (config.use_alpha_font() ? 2 : 0)
+                    | (config.use_alpha_layers() ? 4 : 0));
+    return (n >= 0) && (n < len);
+}
+
+/* removes the caches that were made for another archive or display, the
+ * ones for other alpha configurations are kept, as they might be used
+ * again */
+static void removestale(archive *arc) {
+    char dir[MAX_PATH], path[MAX_PATH];
+    unsigned int id, fmt, alpha;
+
+    if (!get_local_cache_dir(dir, sizeof(dir)))
+        return;
+
+    DIR *d = opendir(dir);
+    if (!d)
+        return;
+
+    struct dirent *e;
+    while ((e = readdir(d)) != NULL) {
+        if ((sscanf(e->d_name, "sprites-%8x-%8x-%1x.pak", &id, &fmt, &alpha) == 3)
+                && (strstr(e->d_name, ".tmp") == NULL)
+                && ((id != arc->ident()) || (fmt != formatkey()))) {
+            int n = snprintf(path, sizeof(path), "%s/%s", dir, e->d_name);
+
+            /* a cut off name could be another file */
+            if ((n >= 0) && (n < (int) sizeof(path)))
+                remove(path);
+        }
+    }
+    closedir(d);
+}
+
+bool pak_open(archive *arc) {
+    pak_close();
+
+    /* the converter must always work from the archive */
+    if (recording)
+        return false;
+
+    if (openpack(open_data_file(PAK_FILENAME), arc))
+        return true;
+
+    /* no fitting pack came with the game, so use the sprite cache
+     * of an earlier start or create it during this one */
+    if (!cachename(arc, cachefile, sizeof(cachefile)))
+        return false;
+
+    if (openpack(fopen(cachefile, "rb"), arc)) {
+        debugprintf(2, "sprites from cache %s\n", cachefile);
+        return true;
+    }
+
+    pak_record_begin(arc, false);
+    caching = true;
+
+    return false;
+}
+
+void pak_cache_finish(void) {
+    if (!caching)
+        return;
+
+    caching = false;
+
+    /* several instances may do this at the same time, but the file
+     * is written under a private name and then renamed, so the cache
+     * is always complete */
+    if (pak_record_finish(cachefile)) {
+        debugprintf(2, "sprite cache %s written\n", cachefile);
+        removestale(dataarchive);
+    } else
+        debugprintf(1, "could not write sprite cache %s\n", cachefile);
+}
+
+void pak_close(void) {
+    freeentries();
+    unmap();
+    cursor = 0;
+
+    /* the sprite cache was not completed, so throw it away */
+    if (caching) {
+        caching = false;
+        recording = false;
+        freerecord();
+    }
+}
+
+bool pak_active(void) {
+    return entries != 0;
+}
+
+const Uint8 *pak_rawfile(const char *name, Uint32 &size) {
+    for (Uint32 i = 0; i < entrycount; i++)
+        if ((entries[i].kind == PAK_RAW) && !strncmp(entries[i].name, name, PAK_NAMELEN)) {
+            size = entries[i].size;
+            return entries[i].data;
+        }
+
+    return NULL;
+}
+
+void pak_beginsection(pak_section section, bool alpha) {
+
+    if (recording) {
+        /* the converter loads some sections more than once, only
+         * the first one is kept */
+        recsection = section;
+        recalpha = alpha ? 1 : 0;
+        recskip = false;
+        for (Uint32 i = 0; i < reccount; i++)
+            if ((recentries[i].kind == PAK_SURFACE) && (recentries[i].section == recsection)
+                    && (recentries[i].alpha == recalpha))
+                recskip = true;
+    }
+
+    for (cursor = 0; cursor < entrycount; cursor++)
+        if ((entries[cursor].kind == PAK_SURFACE) && (entries[cursor].section == section)
+                && (entries[cursor].alpha == (alpha ? 1 : 0)))
+            break;
+}
+
+SDL_Surface *pak_getsurface(int w, int h) {
+    if (cursor >= entrycount)
+        return NULL;
+
+    pak_entry *e = &entries[cursor];
+
+    if ((e->kind != PAK_SURFACE) || (e->w != w) || (e->h != h)) {
+        /* the pack doesn't fit to the loading order, so don't
+         * use it for the rest of this section */
+        cursor = entrycount;
+        return NULL;
+    }
+
+    SDL_Surface *s = SDL_CreateRGBSurfaceFrom(e->data, w, h, pakdata[10] * 8, e->pitch,
+            getlong(pakdata + 12), getlong(pakdata + 16), getlong(pakdata + 20),
+            getlong(pakdata + 24));
+
+    if (!s) {
+        cursor = entrycount;
+        return NULL;
+    }
+
+    if (e->flags & PAKF_SRCALPHA)
+        SDL_SetAlpha(s, SDL_SRCALPHA | ((e->flags & PAKF_RLE) ? SDL_RLEACCEL : 0),
+                SDL_ALPHA_OPAQUE);
+    else
+        SDL_SetAlpha(s, 0, SDL_ALPHA_OPAQUE);
+
+    cursor++;
+
+    return s;
+}
+
+/* --- recorder --- */
+
+static pak_entry *newentry(void) {
+    if (reccount == recsize) {
+        pak_entry *e = new pak_entry[recsize + 200];
+        if (reccount)
+            memcpy(e, recentries, reccount * sizeof(pak_entry));
+        delete[] recentries;
+        recentries = e;
+        recsize += 200;
+    }
+
+    pak_entry *e = &recentries[reccount++];
+    memset(e, 0, sizeof(pak_entry));
+    return e;
+}
+
+/* compresses the data if wanted and useful and stores it in the entry */
+static void storedata(pak_entry *e, const Uint8 *data, Uint32 size) {
+    e->size = size;
+    e->codec = PAK_STORED;
+    e->own = true;
+
+    if (reccompress) {
+        uLongf len = compressBound(size);
+        Uint8 *buf = new Uint8[len];
+
+        /* the fastest level, the point is loading speed, not size */
+        if ((compress2(buf, &len, data, size, 1) == Z_OK) && (len < size)) {
+            e->codec = PAK_DEFLATED;
+            e->stored = len;
+            e->data = buf;
+            e->check = checksum(buf, len);
+            return;
+        }
+        delete[] buf;
+    }
+
+    e->stored = size;
+    e->data = new Uint8[size];
+    memcpy(e->data, data, size);
+    e->check = checksum(data, size);
+}
+
+void pak_record_begin(archive *arc, bool compress) {
+    recording = true;
+    reccompress = compress;
+    recident = arc->ident();
+    reccount = 0;
+    recskip = true;
+}
+
+bool pak_recording(void) {
+    return recording;
+}
+
+void pak_putraw(const char *name, const Uint8 *data, Uint32 size) {
+    if (!recording || strlen(name) >= PAK_NAMELEN)
+        return;
+
+    for (Uint32 i = 0; i < reccount; i++)
+        if ((recentries[i].kind == PAK_RAW) && !strcmp(recentries[i].name, name))
+            return;
+
+    pak_entry *e = newentry();
+    e->kind = PAK_RAW;
+    strcpy(e->name, name);
+    storedata(e, data, size);
+}
+
+void pak_putsurface(SDL_Surface *s) {
+    if (!recording || recskip)
+        return;
+
+    pak_entry *e = newentry();
+    e->kind = PAK_SURFACE;
+    e->section = recsection;
+    e->alpha = recalpha;
+    e->w = s->w;
+    e->h = s->h;
+    e->pitch = s->pitch;
+    e->flags = ((s->flags & SDL_SRCALPHA) ? PAKF_SRCALPHA : 0)
+            | ((s->flags & (SDL_RLEACCEL | SDL_RLEACCELOK)) ? PAKF_RLE : 0);
+
+    SDL_LockSurface(s);
+    storedata(e, (const Uint8*) s->pixels, (Uint32) s->pitch * s->h);
+    SDL_UnlockSurface(s);
+}
+
+static bool writeblock(FILE *f, const Uint8 *data, Uint32 size) {
+    static const Uint8 zero[PAK_ALIGN] = { 0 };
+
+    if (size && fwrite(data, size, 1, f) != 1)
+        return false;
+
+    long pos = ftell(f);
+    if (pos % PAK_ALIGN)
+        return fwrite(zero, PAK_ALIGN - pos % PAK_ALIGN, 1, f) == 1;
+
+    return true;
+}
+
+bool pak_record_finish(const char *fname) {
+    char tmpname[MAX_PATH];
+    Uint8 head[PAK_HEADERSIZE];
+    Uint8 bpp;
+    Uint32 masks[4];
+    bool ok = displayformat(bpp, masks);
+
+    recording = false;
+
+#ifndef WIN32
+    int n = snprintf(tmpname, sizeof(tmpname), "%s.%i.tmp", fname, (int) getpid());
+#else
+    int n = snprintf(tmpname, sizeof(tmpname), "%s.tmp", fname);
+#endif
+
+    if ((n < 0) || (n >= (int) sizeof(tmpname)))
+        ok = false;
+
+    FILE *f = ok ? fopen(tmpname, "wb") : NULL;
+
+    if (f) {
+        Uint8 *dir = new Uint8[reccount * PAK_ENTRYSIZE + 1];
+
+        /* the header is written at the end, when everything is known */
+        memset(head, 0, PAK_HEADERSIZE);
+        ok = writeblock(f, head, PAK_HEADERSIZE);
+
+        for (Uint32 i = 0; ok && (i < reccount); i++) {
+            pak_entry *e = &recentries[i];
+            Uint8 *p = dir + i * PAK_ENTRYSIZE;
+
+            e->pos = ftell(f);
+            ok = writeblock(f, e->data, e->stored);
+
+            memset(p, 0, PAK_ENTRYSIZE);
+            p[0] = e->kind;
+            p[1] = e->codec;
+            p[2] = e->section;
+            p[3] = e->alpha;
+            putlong(p + 4, e->pos);
+            putlong(p + 8, e->stored);
+            putlong(p + 12, e->size);
+            putlong(p + 16, e->check);
+            putword(p + 20, e->w);
+            putword(p + 22, e->h);
+            putword(p + 24, e->pitch);
+            putword(p + 26, e->flags);
+            memcpy(p + 28, e->name, PAK_NAMELEN);
+        }
+
+        Uint32 dirpos = ftell(f);
+        if (ok)
+            ok = writeblock(f, dir, reccount * PAK_ENTRYSIZE);
+
+        memcpy(head, PAK_MAGIC, 8);
+        putword(head + 8, PAK_VERSION);
+        head[10] = bpp;
+        head[11] = (SDL_BYTEORDER == SDL_BIG_ENDIAN) ? 1 : 0;
+        putlong(head + 12, masks[0]);
+        putlong(head + 16, masks[1]);
+        putlong(head + 20, masks[2]);
+        putlong(head + 24, masks[3]);
+        putlong(head + 28, recident);
+        putlong(head + 32, reccount);
+        putlong(head + 36, dirpos);
+        putlong(head + 40, checksum(dir, reccount * PAK_ENTRYSIZE));
+        putlong(head + 44, checksum(head, 44));
+
+        if (ok)
+            ok = (fseek(f, 0, SEEK_SET) == 0) && (fwrite(head, PAK_HEADERSIZE, 1, f) == 1);
+
+        delete[] dir;
+
+        if (fclose(f) != 0)
+            ok = false;
+
+        /* only replace the old pack when the new one is complete */
+        if (ok)
+            ok = rename(tmpname, fname) == 0;
+        if (!ok)
+            remove(tmpname);
+    } else
+        ok = false;
+
+    freerecord();
+
+    return ok;
+}
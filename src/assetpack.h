@@ -0,0 +1,102 @@
+/* Tower Toppler - Nebulus
+ * Copyright (C) 2000-2006  Andreas Rver
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+#ifndef ASSETPACK_H
+#define ASSETPACK_H
+
+#include <SDL.h>
+
+/* this module handles the pre-converted asset pack. The pack contains
+ * the graphics files of the data archive in uncompressed form together
+ * with all the sprites that scr_loadsprites() creates, already in the
+ * pixel format of the display. When a fitting pack is found the loading
+ * of the graphics is reduced to mapping the file and verifying the
+ * checksums, otherwise everything is done the old way from the archive.
+ *
+ * The pack is created by the converter in tools/mkpack.cc, that runs the
+ * normal loading code with the recorder switched on.
+ */
+
+#define PAK_FILENAME "toppler.pak"
+#define PAK_VERSION 1
+
+/* the sprites are stored in sections, one for each group of sprites
+ * that is loaded together. The sprite order inside of a section is
+ * the order in which scr_loadsprites() is called */
+typedef enum {
+    PAK_SEC_TOWER, // steps, elevator and sticks, loaded once
+    PAK_SEC_OBJECTS, // toppler, robots and other objects
+    PAK_SEC_FONT,
+    PAK_SEC_SCROLLER,
+    PAK_SEC_MENU, // background picture of the menu
+    PAK_SEC_TITLE
+} pak_section;
+
+class archive;
+
+/* tries to open the asset pack. This fails when there is no pack or
+ * when it doesn't fit to the archive or the display format or is
+ * damaged. In that case the sprite cache in the local cache directory
+ * is tried, and when there is no fitting cache either, the game loads
+ * from the archive and the recorder collects everything for a new cache.
+ * The display must be initialized before this call
+ */
+bool pak_open(archive *arc);
+
+/* call this when all sprites are loaded, if a new sprite cache was
+ * recorded it is written now */
+void pak_cache_finish(void);
+
+/* unmaps the pack, only call this after all sprites are freed */
+void pak_close(void);
+
+/* true, if there is a usable pack */
+bool pak_active(void);
+
+/* returns the uncompressed contents of one file of the archive, or
+ * NULL if the pack doesn't contain it */
+const Uint8 *pak_rawfile(const char *name, Uint32 &size);
+
+/* selects the section for the following pak_getsurface() calls or, when
+ * recording, starts a new section. alpha is the alpha blending option
+ * that is in use for the sprites of this section
+ */
+void pak_beginsection(pak_section section, bool alpha);
+
+/* returns the next surface of the current section or NULL if there is
+ * none or if its size is not the expected one. The surface shares its
+ * pixel data with the pack
+ */
+SDL_Surface *pak_getsurface(int w, int h);
+
+/* --- the following functions are for the converter --- */
+
+/* switches the recorder on, from now on all raw files opened from the
+ * archive and all sprites are collected for the pack */
+void pak_record_begin(archive *arc, bool compress);
+bool pak_recording(void);
+
+/* collect one archive file or one converted sprite */
+void pak_putraw(const char *name, const Uint8 *data, Uint32 size);
+void pak_putsurface(SDL_Surface *s);
+
+/* writes all the collected data into the given file and switches
+ * the recorder off, returns false on error */
+bool pak_record_finish(const char *fname);
+
+#endif
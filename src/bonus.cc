@@ -24,6 +24,10 @@
 #include "points.h"
 #include "level.h"
 #include "sound.h"
+#include "random.h"
+#include "demo.h"
+#include "events.h"
+#include "game.h"
 
 #include <stdlib.h>
 
@@ -117,100 +121,190 @@ void bns_restart(void) {
     xpos = 0;
 }
 
-bool bns_game(void) {
-
-    /* game local x position, moved since the start of
-     * this bonus game
-     */
-    Uint32 xpos_ofs = 0;
-
-    /* when will the next fish appear */
-    Uint32 nextfish = 30;
-
-    /* when automatic is switched on the submarine will move
-     * automatically to the tower base
-     */
-    bool automatic = false;
+/* when will the next fish appear */
+static Uint32 nextfish;
 
-    /* the newtowercol is true, the towercolor has already been switched
-     * to the color of the tower we're going to arrive at
-     */
-    bool newtowercol = false;
+/* when automatic is switched on the submarine will move
+ * automatically to the tower base
+ */
+static bool automatic;
 
-    Uint8 b;
+/* starts the game logic of a bonus game, the fish come from the game
+ * random numbers, so the game is the same for the same seed
+ */
+static void start(Uint32 seed) {
+    rnd_seed(RND_GAME, seed);
+    evt_clear();
 
     subposx = SUBM_TARGET_X;
     subposy = SUBM_TARGET_Y;
 
     /* no fished and no torpedo visible at game start */
-    for (b = 0; b < fishcnt; b++)
+    for (int b = 0; b < fishcnt; b++)
         fish[b].x = -(SPR_FISHWID + 1);
     torpedox = -1;
 
     /* restart timer */
     time = 0;
 
-    key_readkey();
+    nextfish = 30;
+    automatic = false;
+}
 
-    do {
-        /* move torpedo */
-        if (torpedox >= 0) {
-            torpedox += torpedov;
-            torpedov += 1;
-            if (torpedox > (SCREEN_WIDTH + SPR_TORPWID))
-                torpedox = -1;
-            for (b = 0; b < fishcnt; b++) {
-                if (fish[b].x > 0 && fish[b].state >= 32) {
-                    if ((torpedox + SPR_TORPWID > fish[b].x) && (torpedox < fish[b].x + SPR_FISHWID)
-                            && (torpedoy + SPR_TORPHEI > fish[b].y)
-                            && (torpedoy < fish[b].y + SPR_FISHHEI)) {
-                        torpedox = -1;
-                        fish[b].state -= 32;
-                        ttsounds::instance()->stopsound(SND_TORPEDO);
-                    }
+/* one tick of the game logic with the keys of this tick, the fire key
+ * is set when it was pressed during the tick. The sounds are reported
+ * as events. Returns false when the submarine has arrived at the tower
+ */
+static bool step(Uint16 keys) {
+    Uint8 b;
+
+    /* move torpedo */
+    if (torpedox >= 0) {
+        torpedox += torpedov;
+        torpedov += 1;
+        if (torpedox > (SCREEN_WIDTH + SPR_TORPWID))
+            torpedox = -1;
+        for (b = 0; b < fishcnt; b++) {
+            if (fish[b].x > 0 && fish[b].state >= 32) {
+                if ((torpedox + SPR_TORPWID > fish[b].x) && (torpedox < fish[b].x + SPR_FISHWID)
+                        && (torpedoy + SPR_TORPHEI > fish[b].y)
+                        && (torpedoy < fish[b].y + SPR_FISHHEI)) {
+                    torpedox = -1;
+                    fish[b].state -= 32;
+                    evt_stopsound(SND_TORPEDO);
                 }
             }
         }
+    }
 
-        /* move submarine */
-        if (!automatic) {
-            if (key_keypressed(fire_key)) {
-                if (torpedox == -1) {
-                    torpedox = subposx + TORPEDO_OFS_X;
-                    torpedoy = subposy + TORPEDO_OFS_Y;
-                    torpedov = 6;
-                    ttsounds::instance()->startsound(SND_TORPEDO);
-                }
+    /* move submarine */
+    if (!automatic) {
+        if (keys & fire_key) {
+            if (torpedox == -1) {
+                torpedox = subposx + TORPEDO_OFS_X;
+                torpedoy = subposy + TORPEDO_OFS_Y;
+                torpedov = 6;
+                evt_sound(SND_TORPEDO);
             }
+        }
 
-            if ((key_keystat() & down_key) != 0) {
-                if (subposy < SUBM_MAX_Y)
-                    subposy += 8;
-            } else {
-                if ((key_keystat() & up_key) != 0) {
-                    if (subposy > SUBM_MIN_Y)
-                        subposy -= 8;
-                }
+        if ((keys & down_key) != 0) {
+            if (subposy < SUBM_MAX_Y)
+                subposy += 8;
+        } else {
+            if ((keys & up_key) != 0) {
+                if (subposy > SUBM_MIN_Y)
+                    subposy -= 8;
             }
+        }
 
-            if ((key_keystat() & left_key) != 0) {
-                if (subposx > SUBM_MIN_X)
-                    subposx -= 16;
-            } else {
-                if ((key_keystat() & right_key) != 0) {
-                    if (subposx < SUBM_MAX_X)
-                        subposx += 8;
-                }
-            }
+        if ((keys & left_key) != 0) {
+            if (subposx > SUBM_MIN_X)
+                subposx -= 16;
         } else {
-            if (subposx > SUBM_TARGET_X)
-                subposx -= 18;
-            else if (subposx < SUBM_TARGET_X)
-                subposx += 8;
+            if ((keys & right_key) != 0) {
+                if (subposx < SUBM_MAX_X)
+                    subposx += 8;
+            }
+        }
+    } else {
+        if (subposx > SUBM_TARGET_X)
+            subposx -= 18;
+        else if (subposx < SUBM_TARGET_X)
+            subposx += 8;
+
+        if (subposy > SUBM_TARGET_Y)
+            subposy -= 8;
+    }
 
-            if (subposy > SUBM_TARGET_Y)
-                subposy -= 8;
+    /* move the fish */
+    for (b = 0; b < fishcnt; b++) {
+        if (fish[b].x >= -SPR_FISHWID) {
+            fish[b].x -= 8;
+            fish[b].y += fish[b].ydir;
+            if (fish[b].y > 300 || fish[b].y < 80)
+                fish[b].ydir = -fish[b].ydir;
+
+            if (fish[b].state >= 32)
+                fish[b].state = ((fish[b].state + 1) & 31) + 32;
+            else
+                fish[b].state = (fish[b].state + 1) & 31;
+
+            if ((fish[b].state < 32) && (fish[b].x > subposx - 40)
+                    && (fish[b].x < subposx + 120) && (fish[b].y > subposy - 40)
+                    && (fish[b].y < subposy + 40)) {
+                pts_add(50);
+                evt_sound(SND_HIT);
+                fish[b].x = -(SPR_FISHWID + 1);
+            }
+        }
+    }
+
+    /* nextfish handling */
+    if (nextfish > 0)
+        nextfish--;
+    else {
+        for (b = 0; b < fishcnt; b++) {
+            if (fish[b].x < -SPR_FISHWID) {
+                fish[b].x = SCREEN_WIDTH;
+                fish[b].y = rnd_range(RND_GAME, 140) + 120;
+                fish[b].state = 32;
+                do {
+                    fish[b].ydir = rnd_range(RND_GAME, 10) - 5;
+                } while (fish[b].ydir == 0);
+                nextfish = rnd_range(RND_GAME, 20) + 5;
+                break;
+            }
         }
+    }
+
+    /* end of game, switch to automatic, stop scrolling */
+    if (time == gametime) {
+        automatic = true;
+        if ((subposx == SUBM_TARGET_X) && (subposy == SUBM_TARGET_Y))
+            return false;
+    } else {
+        xpos += 4;
+        time++;
+    }
+
+    if (!((time + 20) & 0x3f))
+        evt_sound(SND_SONAR);
+
+    return true;
+}
+
+bool bns_game(void) {
+
+    /* the newtowercol is true, the towercolor has already been switched
+     * to the color of the tower we're going to arrive at
+     */
+    bool newtowercol = false;
+
+    Uint32 seed = rnd_next(RND_COSMETIC);
+
+    start(seed);
+
+    if (dem_journal_active()) {
+        Uint8 mark[6];
+
+        mark[0] = lev_towernr();
+        mark[1] = lev_towernr() >> 8;
+        for (int i = 0; i < 4; i++)
+            mark[2 + i] = seed >> (8 * i);
+        dem_journal_mark(DEM_JNL_BONUS, mark, 6);
+    }
+
+    key_readkey();
+
+    do {
+        /* the torpedo is started by pressing fire, not by holding it */
+        Uint16 keys = (key_keystat() & ~fire_key) | (key_keypressed(fire_key) ? fire_key : 0);
+
+        dem_journal_keys(keys);
+
+        if (!step(keys))
+            break;
 
         /* escape or pause key pressed */
         if (key_keypressed(break_key))
@@ -223,74 +317,32 @@ bool bns_game(void) {
 
         key_readkey();
 
-        /* move the fish */
-        for (b = 0; b < fishcnt; b++) {
-            if (fish[b].x >= -SPR_FISHWID) {
-                fish[b].x -= 8;
-                fish[b].y += fish[b].ydir;
-                if (fish[b].y > 300 || fish[b].y < 80)
-                    fish[b].ydir = -fish[b].ydir;
-
-                if (fish[b].state >= 32)
-                    fish[b].state = ((fish[b].state + 1) & 31) + 32;
-                else
-                    fish[b].state = (fish[b].state + 1) & 31;
-
-                if ((fish[b].state < 32) && (fish[b].x > subposx - 40)
-                        && (fish[b].x < subposx + 120) && (fish[b].y > subposy - 40)
-                        && (fish[b].y < subposy + 40)) {
-                    pts_add(50);
-                    ttsounds::instance()->startsound(SND_HIT);
-                    fish[b].x = -(SPR_FISHWID + 1);
-                }
-            }
-        }
-
-        /* nextfish handling */
-        if (nextfish > 0)
-            nextfish--;
-        else {
-            for (b = 0; b < fishcnt; b++) {
-                if (fish[b].x < -SPR_FISHWID) {
-                    fish[b].x = SCREEN_WIDTH;
-                    fish[b].y = rand() / (RAND_MAX / 140) + 120;
-                    fish[b].state = 32;
-                    do {
-                        fish[b].ydir = rand() / (RAND_MAX / 10) - 5;
-                    } while (fish[b].ydir == 0);
-                    nextfish = rand() / (RAND_MAX / 20) + 5;
-                    break;
-                }
-            }
-        }
-
         /* change towercolor in the middle of the game */
         if ((time > gametime / 2) && !newtowercol) {
             scr_settowercolor(lev_towercol_red(), lev_towercol_green(), lev_towercol_blue());
             newtowercol = true;
         }
 
-        /* end of game, switch to automatic, stop scrolling */
-        if (time == gametime) {
-            automatic = true;
-            if ((subposx == SUBM_TARGET_X) && (subposy == SUBM_TARGET_Y))
-                break;
-        } else {
-            xpos += 4;
-            xpos_ofs += 4;
-            time++;
-        }
-
-        if (!((time + 20) & 0x3f))
-            ttsounds::instance()->startsound(SND_SONAR);
-
         /* display screen and wait */
         show();
         scr_swap();
-        ttsounds::instance()->play();
+        gam_playevents();
         dcl_wait();
 
     } while (true);
 
     return true;
 }
+
+void bns_simstart(Uint32 seed) {
+    start(seed);
+}
+
+bool bns_simstep(Uint16 keys) {
+    bool playing = step(keys);
+
+    /* nobody is listening, the events are dropped */
+    evt_clear();
+
+    return playing;
+}
@@ -19,6 +19,8 @@
 #ifndef BONUS_H
 #define BONUS_H
 
+#include <SDL_types.h>
+
 /* this module contains the bonus game with the submarine and fish catching
  it is currently not very well tuned */
 
@@ -31,4 +33,12 @@ bool bns_game(void);
  */
 void bns_restart(void);
 
+/* the bonus game without graphics, sound and waiting for replaying a
+ * journal. bns_simstart() starts it with the seed from the journal,
+ * bns_simstep() runs one tick with the keys the journal recorded and
+ * returns false when the game is over
+ */
+void bns_simstart(Uint32 seed);
+bool bns_simstep(Uint16 keys);
+
 #endif
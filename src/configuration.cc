@@ -106,12 +106,15 @@ configuration::configuration(FILE *glob, FILE *local) {
     i_status_top = true; /* is status line top or bottom of screen? */
     i_editor_towerpagesize = -1;
     i_editor_towerstarthei = -5;
+    i_editor_undodepth = 100;
     i_curr_password[0] = 0;
     i_start_lives = 3;
     i_editor_towername[0] = 0;
     i_debug_level = 0;
     i_game_speed = DEFAULT_GAME_SPEED;
     i_nobonus = false;
+    i_max_robots = DEFAULT_ROBOTS;
+    i_journal = false;
 
     first_data = 0;
     need_save = (local == 0);
@@ -128,6 +131,7 @@ configuration::configuration(FILE *glob, FILE *local) {
     CNF_BOOL( "status_top", &i_status_top);
     CNF_INT( "editor_pagesize", &i_editor_towerpagesize);
     CNF_INT( "editor_towerstarthei", &i_editor_towerstarthei);
+    CNF_INT( "editor_undodepth", &i_editor_undodepth);
     CNF_INT( "waves_type", &i_waves_type);
     CNF_KEY( "key_fire", fire_key);
     CNF_KEY( "key_up", up_key);
@@ -138,6 +142,8 @@ configuration::configuration(FILE *glob, FILE *local) {
     CNF_INT( "start_lives", &i_start_lives);
     CNF_INT( "game_speed", &i_game_speed);
     CNF_BOOL( "nobonus", &i_nobonus);
+    CNF_INT( "max_robots", &i_max_robots);
+    CNF_BOOL( "journal", &i_journal);
 
 #ifdef __BLACKBERRY__
 #else
@@ -159,6 +165,11 @@ configuration::configuration(FILE *glob, FILE *local) {
         i_game_speed = 0;
     else if (i_game_speed > MAX_GAME_SPEED)
         i_game_speed = MAX_GAME_SPEED;
+
+    if (i_max_robots < 1)
+        i_max_robots = 1;
+    else if (i_max_robots > MAX_ROBOTS)
+        i_max_robots = MAX_ROBOTS;
 }
 
 configuration::~configuration(void) {
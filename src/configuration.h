@@ -154,6 +154,15 @@ public:
         i_editor_towerstarthei = sz;
     }
 
+    /* the number of editing steps the editor can undo */
+    int editor_undodepth() const {
+        return i_editor_undodepth;
+    }
+    void editor_undodepth(int d) {
+        need_save = true;
+        i_editor_undodepth = d;
+    }
+
     int start_lives() const {
         return i_start_lives;
     }
@@ -184,6 +193,14 @@ public:
         i_game_speed = spd;
     }
 
+    int max_robots() const {
+        return i_max_robots;
+    }
+    void max_robots(int num) {
+        need_save = true;
+        i_max_robots = num;
+    }
+
     int nobonus() const {
         return i_nobonus;
     }
@@ -192,6 +209,15 @@ public:
         i_nobonus = on;
     }
 
+    /* record the games into a session journal, see demo.h */
+    bool journal() const {
+        return i_journal;
+    }
+    void journal(bool on) {
+        need_save = true;
+        i_journal = on;
+    }
+
 private:
 
     FILE *f;
@@ -227,11 +253,14 @@ private:
     bool i_status_top;
     int i_editor_towerpagesize;
     int i_editor_towerstarthei;
+    int i_editor_undodepth;
     int i_start_lives;
     char i_curr_password[PASSWORD_LEN + 1];
     int i_debug_level;
     int i_game_speed;
     int i_nobonus;
+    int i_max_robots;
+    bool i_journal;
 
     bool need_save;
 };
@@ -29,6 +29,8 @@
 
 #ifndef WIN32
 #include <pwd.h>
+#else
+#include <direct.h>
 #endif
 
 static bool wait_overflow = false;
@@ -179,6 +181,31 @@ bool get_data_file_path(const char * name, char * f, int len) {
 #endif
 }
 
+bool get_local_cache_dir(char * f, int len) {
+#ifndef WIN32
+    checkdir();
+#ifdef __BLACKBERRY__
+    snprintf(f, len, "%s/cache", homedir());
+#else
+    snprintf(f, len, "%s/.toppler/cache", homedir());
+#endif
+    DIR *d = opendir(f);
+    if (d) {
+        closedir(d);
+        return true;
+    }
+    return mkdir(f, S_IRWXU) == 0;
+#else
+    snprintf(f, len, "cache");
+    DIR *d = opendir(f);
+    if (d) {
+        closedir(d);
+        return true;
+    }
+    return _mkdir(f) == 0;
+#endif
+}
+
 FILE *open_local_config_file(const char *name) {
 #ifndef WIN32
     checkdir();
@@ -246,6 +273,43 @@ FILE *create_local_data_file(const char *name) {
 #endif
 }
 
+bool write_local_data_file(const char *name, const void *data, size_t size) {
+    char path[MAX_PATH], tmpname[MAX_PATH];
+
+#ifndef WIN32
+    checkdir();
+#ifdef __BLACKBERRY__
+    snprintf(path, sizeof(path), "%s/%s", homedir(), name);
+#else
+    snprintf(path, sizeof(path), "%s/.toppler/%s", homedir(), name);
+#endif
+    snprintf(tmpname, sizeof(tmpname), "%s.%i.tmp", path, (int) getpid());
+#else
+    snprintf(path, sizeof(path), "%s", name);
+    snprintf(tmpname, sizeof(tmpname), "%s.tmp", name);
+#endif
+
+    FILE *f = fopen(tmpname, "wb");
+    if (!f)
+        return false;
+
+    bool ok = !size || (fwrite(data, size, 1, f) == 1);
+    if (fclose(f) != 0)
+        ok = false;
+
+#ifdef WIN32
+    /* rename doesn't replace existing files here */
+    if (ok)
+        remove(path);
+#endif
+    if (ok)
+        ok = rename(tmpname, path) == 0;
+    if (!ok)
+        remove(tmpname);
+
+    return ok;
+}
+
 static int sort_by_name(const void *a, const void *b) {
     return (strcmp((*((struct dirent **) a))->d_name, ((*(struct dirent **) b))->d_name));
 }
@@ -178,6 +178,19 @@
 
 #define PASSWORD_CHARS "abcdefghijklmnopqrstuvwxyz0123456789"
 
+/* the variables that hold the state of a game (mission, tower, toppler,
+ robots, elevators, snowball, points and random numbers) are kept
+ separately for each thread, so independent games, e.g. with
+ gam_simulate(), can run in several threads at the same time. The list
+ of missions is shared, so lev_findmissions() must be done before other
+ threads start. Graphics, sound and the snapshot ring belong to the main
+ thread, other threads must not use them */
+#ifdef _MSC_VER
+#define GAME_STATE __declspec(thread)
+#else
+#define GAME_STATE __thread
+#endif
+
 void dcl_setdebuglevel(int level);
 void debugprintf(int lvl, const char *fmt, ...);
 
@@ -197,18 +210,33 @@ FILE *create_local_config_file(const char *name);
 FILE *open_local_data_file(const char *name);
 FILE *create_local_data_file(const char *name);
 
+/* writes size bytes of data into the local data file with the given name.
+ * The data is written into a temporary file that then replaces the old
+ * file, so there is either the old or the complete new file, never a
+ * part of it. Returns false on errors, the old file is kept then
+ */
+bool write_local_data_file(const char *name, const void *data, size_t size);
+
 /* returns the filename that would be opened with open_data_file in
  * f, f is max len characters
  * returns true, if the file pointer of open_data_file would be not NULL
  */
 bool get_data_file_path(const char * fname, char * f, int len);
 
+/* returns the directory for cached data in f, f is max len characters,
+ * the directory is created, if it doesn't exist
+ * returns false, if there is no such directory
+ */
+bool get_local_cache_dir(char * f, int len);
+
 /* Is the TT window active? */
 extern bool tt_has_focus;
 
 #define MENU_DCLSPEED 4
 #define DEFAULT_GAME_SPEED 0
 #define MAX_GAME_SPEED 3  /* from 0 to this; bigger == faster */
+#define DEFAULT_ROBOTS 4
+#define MAX_ROBOTS 64  /* most robots (including the cross) at the same time */
 /* set dcl_wait() delay, and return the previous delay */
 int dcl_update_speed(int spd);
 
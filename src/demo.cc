@@ -0,0 +1,466 @@
+/* Tower Toppler - Nebulus
+ * Copyright (C) 2000-2006  Andreas Rver
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+#include "demo.h"
+#include "decl.h"
+
+#include <SDL_thread.h>
+#include <string.h>
+
+/* runs of up to this many ticks fit into the first byte */
+#define SHORTRUN 7
+
+/* the pool keeps at most this many free chunks */
+#define POOLSIZE 16
+
+static const char runletters[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdef";
+
+void dem_start(dem_stream &s, const Uint8 *data, Uint32 size) {
+    s.data = data;
+    s.size = data ? size : 0;
+    s.pos = 0;
+    s.keys = 0;
+    s.left = 0;
+}
+
+/* reads a number of up to 32 bits, 7 bits per byte */
+static bool getnumber(const Uint8 *data, Uint32 size, Uint32 &pos, Uint32 &n) {
+    Uint8 b;
+    int shift = 0;
+
+    n = 0;
+    do {
+        if ((pos >= size) || (shift > 28))
+            return false;
+        b = data[pos++];
+        n |= (Uint32) (b & 0x7f) << shift;
+        shift += 7;
+    } while (b & 0x80);
+
+    return true;
+}
+
+/* reads the start of the next run, returns false at the end */
+static bool next_run(const Uint8 *data, Uint32 size, Uint32 &pos, Uint16 &keys, Uint32 &len) {
+    if (pos >= size)
+        return false;
+
+    Uint8 b = data[pos++];
+
+    keys = b & DEM_KEYS;
+    len = (b >> 5) + 1;
+
+    if (len > SHORTRUN) {
+        Uint32 n;
+
+        if (!getnumber(data, size, pos, n))
+            return false;
+        len = SHORTRUN + 1 + n;
+    }
+
+    return true;
+}
+
+Uint16 dem_next(dem_stream &s) {
+    if (!s.left && !next_run(s.data, s.size, s.pos, s.keys, s.left)) {
+        s.pos = s.size;
+        return 0;
+    }
+
+    s.left--;
+    return s.keys;
+}
+
+bool dem_ended(const dem_stream &s) {
+    return !s.left && (s.pos >= s.size);
+}
+
+int dem_length(const Uint8 *data, Uint32 size) {
+    Uint32 pos = 0, len, sum = 0;
+    Uint16 keys;
+
+    while (next_run(data, size, pos, keys, len))
+        sum += len;
+
+    return sum;
+}
+
+static GAME_STATE dem_chunk *pool = NULL;
+static GAME_STATE int poolcount = 0;
+
+static dem_chunk *getchunk(void) {
+    dem_chunk *c = pool;
+
+    if (c) {
+        pool = c->next;
+        poolcount--;
+    } else
+        c = new dem_chunk;
+
+    c->next = NULL;
+    c->kind = DEM_JNL_KEYS;
+    c->used = 0;
+    return c;
+}
+
+static void putchunk(dem_chunk *c) {
+    if (poolcount >= POOLSIZE) {
+        delete c;
+        return;
+    }
+    c->next = pool;
+    pool = c;
+    poolcount++;
+}
+
+void dem_freepool(void) {
+    while (pool) {
+        dem_chunk *c = pool;
+        pool = c->next;
+        delete c;
+    }
+    poolcount = 0;
+}
+
+/* adds a new chunk, if the last one has no room for the given
+ * number of bytes. A run is never split over two chunks, the chunks
+ * of the journal are read independently of each other */
+static void reserve(dem_packer &p, Uint32 bytes) {
+    if (!p.last || (p.last->used + bytes > DEM_CHUNKSIZE)) {
+        dem_chunk *c = getchunk();
+
+        if (p.last)
+            p.last->next = c;
+        else
+            p.first = c;
+        p.last = c;
+    }
+}
+
+static void putbyte(dem_packer &p, Uint8 b) {
+    p.last->data[p.last->used++] = b;
+    p.size++;
+}
+
+static void close_run(dem_packer &p) {
+    if (!p.run)
+        return;
+
+    if (p.run <= SHORTRUN) {
+        reserve(p, 1);
+        putbyte(p, p.keys | ((p.run - 1) << 5));
+    } else {
+        Uint32 n = p.run - SHORTRUN - 1;
+
+        reserve(p, 6);
+        putbyte(p, p.keys | (SHORTRUN << 5));
+        while (n >= 0x80) {
+            putbyte(p, (n & 0x7f) | 0x80);
+            n >>= 7;
+        }
+        putbyte(p, n);
+    }
+    p.run = 0;
+}
+
+void dem_pack_start(dem_packer &p) {
+    p.first = p.last = NULL;
+    p.size = 0;
+    p.keys = 0;
+    p.run = 0;
+    p.len = 0;
+}
+
+void dem_pack(dem_packer &p, Uint16 keys, Uint32 count) {
+    keys &= DEM_KEYS;
+
+    if (!count)
+        return;
+
+    if (p.run && (keys != p.keys))
+        close_run(p);
+
+    p.keys = keys;
+    p.run += count;
+    p.len += count;
+}
+
+Uint8 *dem_pack_finish(dem_packer &p, Uint32 &size, int &len) {
+    close_run(p);
+
+    Uint8 *d = p.size ? new Uint8[p.size] : NULL;
+    Uint32 pos = 0;
+
+    while (p.first) {
+        dem_chunk *c = p.first;
+
+        p.first = c->next;
+        memcpy(d + pos, c->data, c->used);
+        pos += c->used;
+        putchunk(c);
+    }
+
+    size = p.size;
+    len = p.len;
+
+    dem_pack_start(p);
+    return d;
+}
+
+void dem_text(FILE *out, const Uint8 *data, Uint32 size, int width) {
+    Uint32 pos = 0, len;
+    Uint16 keys;
+    int col = 0;
+
+    while (next_run(data, size, pos, keys, len)) {
+        char token[16];
+
+        if (len > 1)
+            snprintf(token, sizeof(token), "%c%u", runletters[keys], len);
+        else
+            snprintf(token, sizeof(token), "%c", runletters[keys]);
+
+        int l = strlen(token);
+
+        if (col && (col + l > width)) {
+            fprintf(out, "\n");
+            col = 0;
+        }
+        fprintf(out, "%s", token);
+        col += l;
+    }
+
+    if (col)
+        fprintf(out, "\n");
+}
+
+bool dem_parse(dem_packer &p, const char *line) {
+    while (*line && (*line != '\n') && (*line != '\r')) {
+        const char *c = strchr(runletters, *line);
+
+        if (!c || !*c)
+            return false;
+
+        line++;
+
+        Uint32 len = 0;
+        while ((*line >= '0') && (*line <= '9'))
+            len = 10 * len + (*line++ - '0');
+
+        dem_pack(p, c - runletters, len ? len : 1);
+    }
+
+    return true;
+}
+
+/* the journal. The recorder hands full chunks to the writer thread in
+ * the queue, the writer gives them back in the done list, from where
+ * they go into the pool of the recorder again */
+static struct {
+    FILE *f;
+    SDL_Thread *thread;
+    SDL_mutex *lock;
+    SDL_cond *queued; // signalled when a chunk is queued or the journal stops
+    bool stop;
+    bool failed; // the writer couldn't write everything
+    dem_chunk *queue, *queuelast;
+    dem_chunk *done;
+    dem_packer keys;
+} journal;
+
+static bool putblock(FILE *f, const dem_chunk *c) {
+    Uint8 head[6];
+    Uint32 n = c->used;
+    int len = 0;
+
+    head[len++] = c->kind;
+    while (n >= 0x80) {
+        head[len++] = (n & 0x7f) | 0x80;
+        n >>= 7;
+    }
+    head[len++] = n;
+
+    return (fwrite(head, len, 1, f) == 1) && (!c->used || (fwrite(c->data, c->used, 1, f) == 1));
+}
+
+static int journal_writer(void *) {
+    while (true) {
+        SDL_LockMutex(journal.lock);
+        while (!journal.queue && !journal.stop)
+            SDL_CondWait(journal.queued, journal.lock);
+
+        dem_chunk *c = journal.queue;
+        if (c) {
+            journal.queue = c->next;
+            if (!journal.queue)
+                journal.queuelast = NULL;
+        }
+        SDL_UnlockMutex(journal.lock);
+
+        /* everything is written */
+        if (!c)
+            return 0;
+
+        if (!putblock(journal.f, c))
+            journal.failed = true;
+
+        SDL_LockMutex(journal.lock);
+        c->next = journal.done;
+        journal.done = c;
+        SDL_UnlockMutex(journal.lock);
+    }
+}
+
+static void journal_queue(dem_chunk *c) {
+    c->next = NULL;
+
+    SDL_LockMutex(journal.lock);
+    if (journal.queuelast)
+        journal.queuelast->next = c;
+    else
+        journal.queue = c;
+    journal.queuelast = c;
+
+    dem_chunk *done = journal.done;
+    journal.done = NULL;
+    SDL_CondSignal(journal.queued);
+    SDL_UnlockMutex(journal.lock);
+
+    while (done) {
+        dem_chunk *d = done;
+        done = d->next;
+        putchunk(d);
+    }
+}
+
+/* queues the full chunks of keys, or all of them, when the keys end
+ * because of a marker */
+static void journal_flush(bool all) {
+    dem_packer &p = journal.keys;
+
+    if (all)
+        close_run(p);
+
+    while (p.first && ((p.first != p.last) || all)) {
+        dem_chunk *c = p.first;
+
+        p.first = c->next;
+        p.size -= c->used;
+        journal_queue(c);
+    }
+
+    if (!p.first)
+        p.last = NULL;
+}
+
+bool dem_journal_start(const char *fname) {
+    if (journal.f)
+        dem_journal_stop();
+
+    journal.f = create_local_data_file(fname);
+    if (!journal.f)
+        return false;
+
+    fwrite(DEM_JNL_MAGIC, 8, 1, journal.f);
+
+    journal.queue = journal.queuelast = journal.done = NULL;
+    journal.stop = journal.failed = false;
+    dem_pack_start(journal.keys);
+    journal.lock = SDL_CreateMutex();
+    journal.queued = SDL_CreateCond();
+    journal.thread = SDL_CreateThread(journal_writer, NULL);
+
+    return true;
+}
+
+bool dem_journal_active(void) {
+    return journal.f != NULL;
+}
+
+void dem_journal_mark(dem_jnlblock kind, const Uint8 *data, Uint32 size) {
+    if (!journal.f || (size > DEM_CHUNKSIZE))
+        return;
+
+    journal_flush(true);
+
+    dem_chunk *c = getchunk();
+
+    c->kind = kind;
+    c->used = size;
+    if (size)
+        memcpy(c->data, data, size);
+    journal_queue(c);
+}
+
+void dem_journal_keys(Uint16 keys) {
+    if (!journal.f)
+        return;
+
+    dem_pack(journal.keys, keys);
+    journal_flush(false);
+}
+
+bool dem_journal_stop(void) {
+    if (!journal.f)
+        return false;
+
+    journal_flush(true);
+
+    /* the writer ends when the queue is empty */
+    SDL_LockMutex(journal.lock);
+    journal.stop = true;
+    SDL_CondSignal(journal.queued);
+    SDL_UnlockMutex(journal.lock);
+    SDL_WaitThread(journal.thread, NULL);
+
+    while (journal.done) {
+        dem_chunk *c = journal.done;
+        journal.done = c->next;
+        putchunk(c);
+    }
+
+    SDL_DestroyCond(journal.queued);
+    SDL_DestroyMutex(journal.lock);
+
+    bool ok = !journal.failed && (fclose(journal.f) == 0);
+    journal.f = NULL;
+
+    return ok;
+}
+
+bool dem_journal_read(FILE *in, Uint8 &kind, Uint8 *data, Uint32 &size) {
+    Uint8 head[6];
+    Uint32 pos = 0, len = 0;
+    int c;
+
+    if ((c = fgetc(in)) == EOF)
+        return false;
+    kind = c;
+
+    /* the size, the same way as the numbers in the runs */
+    do {
+        if ((c = fgetc(in)) == EOF)
+            return false;
+        head[len++] = c;
+    } while ((c & 0x80) && (len < sizeof(head)));
+
+    if (!getnumber(head, len, pos, size) || (size > DEM_CHUNKSIZE))
+        return false;
+
+    return !size || (fread(data, size, 1, in) == 1);
+}
@@ -0,0 +1,142 @@
+/* Tower Toppler - Nebulus
+ * Copyright (C) 2000-2006  Andreas Rver
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+#ifndef DEMO_H
+#define DEMO_H
+
+#include <SDL_types.h>
+#include <stdio.h>
+
+/* the compact form of the tower demos. A demo is the list of the key
+ * states, one for each tick, of which the game only uses the 5 bits of
+ * up, down, left, right and fire. The demo is stored as runs of equal
+ * key states, each run starts with a byte with the keys in bits 0-4
+ * and the length of the run in bits 5-7:
+ *   0-6: the run is 1 to 7 ticks long
+ *     7: the run is 8 ticks plus the following number long
+ * the number is stored with 7 bits per byte, lowest first, bit 7 is set
+ * in all bytes but the last one. The demos are played directly from
+ * this form, without unpacking them into one key state per tick
+ */
+
+#define DEM_KEYS 0x1f
+
+/* reads the keys of a packed demo one tick after the other. The stream
+ * only points into the demo, it can be copied to continue at the same
+ * place later on */
+typedef struct {
+    const Uint8 *data;
+    Uint32 size, pos;
+    Uint16 keys; // of the current run
+    Uint32 left; // ticks left in the current run
+} dem_stream;
+
+void dem_start(dem_stream &s, const Uint8 *data, Uint32 size);
+
+/* the keys for the next tick, no keys after the end of the demo */
+Uint16 dem_next(dem_stream &s);
+
+/* the number of ticks of a packed demo */
+int dem_length(const Uint8 *data, Uint32 size);
+
+/* true, when all keys of the demo have been read */
+bool dem_ended(const dem_stream &s);
+
+/* the packed bytes are collected in chunks of this size. The chunks
+ * come from a pool and go back to it, so recording doesn't allocate
+ * memory or copy what is already recorded, however long it runs */
+#define DEM_CHUNKSIZE 4096
+
+typedef struct dem_chunk {
+    struct dem_chunk *next;
+    Uint8 kind; // of the journal block
+    Uint32 used;
+    Uint8 data[DEM_CHUNKSIZE];
+} dem_chunk;
+
+/* collects the key states of a demo and packs them */
+typedef struct {
+    dem_chunk *first, *last;
+    Uint32 size; // of the packed bytes in all chunks
+    Uint16 keys; // of the open run
+    Uint32 run; // length of the open run
+    int len; // number of ticks added so far
+} dem_packer;
+
+void dem_pack_start(dem_packer &p);
+
+/* adds count ticks with the given keys */
+void dem_pack(dem_packer &p, Uint16 keys, Uint32 count = 1);
+
+/* returns the packed demo, allocated with new[], and its size and
+ * length in ticks, NULL for an empty demo. The chunks go back to
+ * the pool and the packer is empty again */
+Uint8 *dem_pack_finish(dem_packer &p, Uint32 &size, int &len);
+
+/* frees the chunks in the pool of the calling thread */
+void dem_freepool(void);
+
+/* text form of the demos for the tower files. Each run is a letter for
+ * the keys (A-Z for 0-25, a-f for 26-31) followed by the length of the
+ * run in decimal, the length is left out for runs of one tick.
+ * dem_text() writes the demo in lines of at most width characters,
+ * dem_parse() adds the runs of one line to the packer and returns false
+ * when the line contains anything else
+ */
+void dem_text(FILE *out, const Uint8 *data, Uint32 size, int width);
+bool dem_parse(dem_packer &p, const char *line);
+
+/* the session journal records the keys of a whole game, over all
+ * towers and bonus games, into a file in the local data directory.
+ * The file starts with DEM_JNL_MAGIC, followed by blocks of a kind
+ * byte, the size of the data as a number like in the runs and the
+ * data. The keys are in DEM_JNL_KEYS blocks in the packed form, all
+ * of these blocks between two markers together form one demo. In the
+ * bonus game the fire key means it was pressed during the tick. Full
+ * chunks are written by a thread in the background, so the game never
+ * waits for the disk. Only one thread may record a journal
+ */
+#define DEM_JNL_MAGIC "TTJRNL\x1a\0"
+
+typedef enum {
+    DEM_JNL_KEYS,
+    DEM_JNL_SESSION, // name of the mission
+    DEM_JNL_TOWER, // a tower is started: tower number (2 bytes), seed (4 bytes), robots (1 byte)
+    DEM_JNL_BONUS // the bonus game before the tower: tower number (2 bytes), seed (4 bytes)
+} dem_jnlblock;
+
+/* starts the journal, returns false if the file can't be created */
+bool dem_journal_start(const char *fname);
+bool dem_journal_active(void);
+
+/* adds a marker, the data must not be longer than DEM_CHUNKSIZE */
+void dem_journal_mark(dem_jnlblock kind, const Uint8 *data, Uint32 size);
+
+/* adds the keys of one tick */
+void dem_journal_keys(Uint16 keys);
+
+/* writes everything that is left and closes the file, returns false
+ * if not everything could be written */
+bool dem_journal_stop(void);
+
+/* reads the next block of a journal into data, that must have room
+ * for DEM_CHUNKSIZE bytes, returns false at the end or on errors.
+ * The magic at the start of the file must be skipped before */
+bool dem_journal_read(FILE *in, Uint8 &kind, Uint8 *data, Uint32 &size);
+
+#endif
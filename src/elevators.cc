@@ -21,6 +21,7 @@
 #include "level.h"
 #include "decl.h"
 #include "toppler.h"
+#include "snapshot.h"
 
 #include <stdlib.h>
 
@@ -32,28 +33,28 @@
  is always drawn in such a way that the last one will appear or disappear
  below the platform under the toppler */
 
-static struct {
-    /* the current position of the platform */
-    Uint8 angle;
-    Uint16 vertical;
+/* the elevators are stored as one array for each field */
 
-    /* time until the elevator falls down */
-    Sint8 time;
+/* the current position of the platform */
+static GAME_STATE Uint8 ele_angle[MAX_ELE];
+static GAME_STATE Uint16 ele_vertical[MAX_ELE];
 
-    /* background value necessary because in between the stations it
-     is impossible to show a platform so we save the actual value
-     there and force a station at the position, when the elevator moves
-     further down we restore the value there */
-    Uint8 bg;
-} elevators[MAX_ELE];
+/* time until the elevator falls down */
+static GAME_STATE Sint8 ele_time[MAX_ELE];
 
-static Sint8 active_ele;
-static Sint8 ele_dir;
+/* background value necessary because in between the stations it
+ is impossible to show a platform so we save the actual value
+ there and force a station at the position, when the elevator moves
+ further down we restore the value there */
+static GAME_STATE Uint8 ele_bg[MAX_ELE];
+
+static GAME_STATE Sint8 active_ele;
+static GAME_STATE Sint8 ele_dir;
 
 void ele_init(void) {
 
     for (Uint8 t = 0; t < MAX_ELE; t++)
-        elevators[t].time = -1;
+        ele_time[t] = -1;
 
     active_ele = -1;
 }
@@ -69,19 +70,19 @@ void ele_select(Uint16 row, Uint8 col) {
     row--;
 
     for (int t = 0; t < MAX_ELE; t++) {
-        if ((elevators[t].time == -1) && (what == 0)) {
+        if ((ele_time[t] == -1) && (what == 0)) {
             what = 1;
             active_ele = t;
         }
-        if ((elevators[t].angle == col) && (elevators[t].vertical == row)) {
+        if ((ele_angle[t] == col) && (ele_vertical[t] == row)) {
             what = 2;
             active_ele = t;
         }
     }
 
-    elevators[active_ele].angle = col;
-    elevators[active_ele].vertical = row;
-    elevators[active_ele].time = -1;
+    ele_angle[active_ele] = col;
+    ele_vertical[active_ele] = row;
+    ele_time[active_ele] = -1;
 
 }
 
@@ -89,7 +90,7 @@ void ele_activate(Sint8 dir) {
 
     assert_msg(active_ele != -1, "Work with unselected elevator, activate.");
 
-    lev_platform2stick(elevators[active_ele].vertical, elevators[active_ele].angle);
+    lev_platform2stick(ele_vertical[active_ele], ele_angle[active_ele]);
     ele_dir = dir;
     if (dir == -1)
         ele_move();
@@ -100,13 +101,13 @@ void ele_move(void) {
     assert_msg(active_ele != -1, "Work with unselected elevator, move.");
 
     if (ele_dir == 1) {
-        elevators[active_ele].vertical++;
+        ele_vertical[active_ele]++;
 
-        lev_empty2stick(elevators[active_ele].vertical, elevators[active_ele].angle);
+        lev_empty2stick(ele_vertical[active_ele], ele_angle[active_ele]);
     } else {
-        lev_stick2empty(elevators[active_ele].vertical, elevators[active_ele].angle);
+        lev_stick2empty(ele_vertical[active_ele], ele_angle[active_ele]);
 
-        elevators[active_ele].vertical--;
+        ele_vertical[active_ele]--;
     }
 }
 
@@ -115,9 +116,9 @@ bool ele_is_atstop(void) {
     assert_msg(active_ele != -1, "Work with unselected elevator, is_atstop.");
 
     if (ele_dir == 1)
-        return lev_is_station(elevators[active_ele].vertical + 1, elevators[active_ele].angle);
+        return lev_is_station(ele_vertical[active_ele] + 1, ele_angle[active_ele]);
     else
-        return lev_is_station(elevators[active_ele].vertical, elevators[active_ele].angle);
+        return lev_is_station(ele_vertical[active_ele], ele_angle[active_ele]);
 }
 
 void ele_deactivate(void) {
@@ -127,38 +128,55 @@ void ele_deactivate(void) {
     if (ele_dir == 1)
         ele_move();
 
-    lev_stick2platform(elevators[active_ele].vertical, elevators[active_ele].angle);
+    lev_stick2platform(ele_vertical[active_ele], ele_angle[active_ele]);
 
     Uint8 ae = active_ele;
     active_ele = -1;
 
-    if (!lev_is_station(elevators[ae].vertical, elevators[ae].angle))
-        elevators[ae].bg = lev_putplatform(elevators[ae].vertical, elevators[ae].angle);
-    else if (lev_is_bottom_station(elevators[ae].vertical, elevators[ae].angle))
+    if (!lev_is_station(ele_vertical[ae], ele_angle[ae]))
+        ele_bg[ae] = lev_putplatform(ele_vertical[ae], ele_angle[ae]);
+    else if (lev_is_bottom_station(ele_vertical[ae], ele_angle[ae]))
         return;
     else
-        elevators[ae].bg = lev_tower(elevators[ae].vertical, elevators[ae].angle);
+        ele_bg[ae] = lev_tower(ele_vertical[ae], ele_angle[ae]);
 
-    elevators[ae].time = 0x7d;
+    ele_time[ae] = 0x7d;
 }
 
 void ele_update(void) {
 
     for (Uint8 t = 0; t < MAX_ELE; t++) {
-        if (elevators[t].time == 0) {
-            lev_restore(elevators[t].vertical, elevators[t].angle, elevators[t].bg);
-            lev_platform2empty(elevators[t].vertical, elevators[t].angle);
-            elevators[t].vertical--;
-            lev_stick2platform(elevators[t].vertical, elevators[t].angle);
-            if (lev_is_bottom_station(elevators[t].vertical, elevators[t].angle)) {
-                elevators[t].time = -1;
+        if (ele_time[t] == 0) {
+            lev_restore(ele_vertical[t], ele_angle[t], ele_bg[t]);
+            lev_platform2empty(ele_vertical[t], ele_angle[t]);
+            ele_vertical[t]--;
+            lev_stick2platform(ele_vertical[t], ele_angle[t]);
+            if (lev_is_bottom_station(ele_vertical[t], ele_angle[t])) {
+                ele_time[t] = -1;
                 top_sidemove();
             } else
-                elevators[t].bg = lev_putplatform(elevators[t].vertical, elevators[t].angle);
+                ele_bg[t] = lev_putplatform(ele_vertical[t], ele_angle[t]);
         }
 
-        if (elevators[t].time > 0)
-            elevators[t].time--;
+        if (ele_time[t] > 0)
+            ele_time[t]--;
     }
 }
 
+void ele_savestate(unsigned char *&p) {
+    SNP_PUTN(p, ele_angle, MAX_ELE);
+    SNP_PUTN(p, ele_vertical, MAX_ELE);
+    SNP_PUTN(p, ele_time, MAX_ELE);
+    SNP_PUTN(p, ele_bg, MAX_ELE);
+    SNP_PUT(p, active_ele);
+    SNP_PUT(p, ele_dir);
+}
+
+void ele_loadstate(const unsigned char *&p) {
+    SNP_GETN(p, ele_angle, MAX_ELE);
+    SNP_GETN(p, ele_vertical, MAX_ELE);
+    SNP_GETN(p, ele_time, MAX_ELE);
+    SNP_GETN(p, ele_bg, MAX_ELE);
+    SNP_GET(p, active_ele);
+    SNP_GET(p, ele_dir);
+}
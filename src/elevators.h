@@ -47,4 +47,8 @@ void ele_deactivate(void);
 /* call once per update to check elevator falldown */
 void ele_update(void);
 
+/* snapshot support, see snapshot.h */
+void ele_savestate(unsigned char *&p);
+void ele_loadstate(const unsigned char *&p);
+
 #endif
@@ -0,0 +1,89 @@
+/* Tower Toppler - Nebulus
+ * Copyright (C) 2000-2006  Andreas Rver
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+#include "events.h"
+
+#include "decl.h"
+
+/* room for the start or stop and the volume of every sound and the cross */
+#define EVT_MAX 64
+
+static GAME_STATE evt_event events[EVT_MAX];
+static GAME_STATE int eventcount = 0;
+
+/* true, if the new event replaces the old one */
+static bool replaces(const evt_event &old, Uint8 type, Uint8 snd) {
+    if (type == EVT_CROSSCOLOR)
+        return old.type == EVT_CROSSCOLOR;
+    if (type == EVT_SOUNDVOL)
+        return (old.type == EVT_SOUNDVOL) && (old.par[0] == snd);
+
+    /* starting and stopping the same sound, the last one counts */
+    return ((old.type == EVT_SOUND) || (old.type == EVT_STOPSOUND)) && (old.par[0] == snd);
+}
+
+static void add(Uint8 type, Uint8 a, Uint8 b, Uint8 c) {
+    int i;
+
+    for (i = 0; i < eventcount; i++)
+        if (replaces(events[i], type, a))
+            break;
+
+    if (i == eventcount) {
+        if (eventcount == EVT_MAX)
+            return;
+        eventcount++;
+    }
+
+    events[i].type = type;
+    events[i].par[0] = a;
+    events[i].par[1] = b;
+    events[i].par[2] = c;
+}
+
+void evt_sound(int snd) {
+    add(EVT_SOUND, snd, 0, 0);
+}
+
+void evt_stopsound(int snd) {
+    add(EVT_STOPSOUND, snd, 0, 0);
+}
+
+void evt_soundvol(int snd, int vol) {
+    if (vol < 0)
+        vol = 0;
+    if (vol > 255)
+        vol = 255;
+    add(EVT_SOUNDVOL, snd, vol, 0);
+}
+
+void evt_crosscolor(Uint8 r, Uint8 g, Uint8 b) {
+    add(EVT_CROSSCOLOR, r, g, b);
+}
+
+int evt_count(void) {
+    return eventcount;
+}
+
+const evt_event *evt_events(void) {
+    return events;
+}
+
+void evt_clear(void) {
+    eventcount = 0;
+}
@@ -0,0 +1,58 @@
+/* Tower Toppler - Nebulus
+ * Copyright (C) 2000-2006  Andreas Rver
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+#ifndef EVENTS_H
+#define EVENTS_H
+
+#include <SDL_types.h>
+
+/* the game logic doesn't call the sound system or the screen module
+ * directly, it writes what should be presented into this buffer. After
+ * each tick, or each frame when several ticks are shown at once, the
+ * game drains the buffer and starts the sounds. Without graphics the
+ * buffer is simply cleared.
+ *
+ * The buffer has a fixed size and needs no allocation. An event replaces
+ * an older one of the same kind for the same sound, so the buffer never
+ * holds more than one of each and can't overflow however many ticks
+ * are run between two drains
+ */
+
+typedef enum {
+    EVT_SOUND, // start the sound
+    EVT_STOPSOUND, // stop the sound
+    EVT_SOUNDVOL, // set the volume of the sound
+    EVT_CROSSCOLOR // new color for the cross robot
+} evt_type;
+
+typedef struct {
+    Uint8 type;
+    Uint8 par[3]; // sound and volume, or red, green and blue for the cross
+} evt_event;
+
+void evt_sound(int snd);
+void evt_stopsound(int snd);
+void evt_soundvol(int snd, int vol);
+void evt_crosscolor(Uint8 r, Uint8 g, Uint8 b);
+
+/* the events since the last evt_clear() in the order they happened */
+int evt_count(void);
+const evt_event *evt_events(void);
+void evt_clear(void);
+
+#endif
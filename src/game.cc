@@ -30,6 +30,10 @@
 #include "toppler.h"
 #include "snowball.h"
 #include "sound.h"
+#include "random.h"
+#include "snapshot.h"
+#include "events.h"
+#include "configuration.h"
 
 #include <string.h>
 #include <stdlib.h>
@@ -52,14 +56,15 @@ void gam_newgame(void) {
     pts_reset();
 }
 
-void gam_loadtower(Uint8 tow) {
+void gam_loadtower(Uint16 tow) {
     lev_selecttower(tow);
 }
 
 void gam_arrival(void) {
     int b, toppler, delay = 0;
 
-    rob_initialize();
+    /* only here the player's choice is used, it goes into the journal */
+    rob_initialize(config.max_robots());
     snb_init();
     const char *passwd = lev_get_passwd();
 
@@ -242,6 +247,35 @@ static void new_height(int verticalpos, int &reached_height) {
     }
 }
 
+/* hands the sounds and colors the game logic asked for since the
+ last call to the sound system and the screen and plays the sounds */
+void gam_playevents(void) {
+    const evt_event *e = evt_events();
+
+    for (int i = 0; i < evt_count(); i++, e++)
+        switch (e->type) {
+        case EVT_SOUND:
+            ttsounds::instance()->startsound(e->par[0]);
+            break;
+        case EVT_STOPSOUND:
+            ttsounds::instance()->stopsound(e->par[0]);
+            break;
+        case EVT_SOUNDVOL:
+            ttsounds::instance()->setsoundvol(e->par[0], e->par[1]);
+            break;
+        case EVT_CROSSCOLOR:
+            scr_setcrosscolor(e->par[0], e->par[1], e->par[2]);
+            break;
+        }
+
+    evt_clear();
+    ttsounds::instance()->play();
+}
+
+/* the volume last given to the water sound, -1 when it has to be
+ given again because a new tower is started */
+static int watervolume = -1;
+
 /* updates the position of the tower on screen
  with respect to the position of the animal
 
@@ -268,8 +302,12 @@ static unsigned short towerpos(int verticalpos, int &tower_position, int anglepo
     sts_move(j, i);
     tower_position += i;
 
-    ttsounds::instance()->setsoundvol(SND_WATER,
-            verticalpos >= MIX_MAX_VOLUME * 2 / 5 ? 0 : MIX_MAX_VOLUME * 2 / 5 - verticalpos);
+    /* the volume changes seldom, don't bother the mixer every frame */
+    i = verticalpos >= MIX_MAX_VOLUME * 2 / 5 ? 0 : MIX_MAX_VOLUME * 2 / 5 - verticalpos;
+    if (i != watervolume) {
+        ttsounds::instance()->setsoundvol(SND_WATER, i);
+        watervolume = i;
+    }
 
     return tower_position;
 }
@@ -409,7 +447,7 @@ static void akt_time(int &time, int &timecount, gam_states &state) {
             timecount = 0;
             time--;
             if ((time >= 0) && (time <= 20 || (time <= 40 && (time % 2))))
-                ttsounds::instance()->startsound(SND_ALARM);
+                evt_sound(SND_ALARM);
             if (time == 0)
                 state = STATE_TIMEOUT;
         }
@@ -447,6 +485,28 @@ static void get_keys(Sint8 &left_right, Sint8 &up_down, bool &space, Uint16 ksta
         space = false;
 }
 
+/* one tick of the game logic with the given keys */
+static void sim_tick(Uint16 keys, int &time, int &timecount, int &reached_height,
+        gam_states &state) {
+    Sint8 left_right, up_down;
+    bool space;
+
+    get_keys(left_right, up_down, space, keys);
+
+    ele_update();
+    snb_movesnowball();
+    top_updatetoppler(left_right, up_down, space);
+
+    if (!top_dying())
+        rob_new(top_verticalpos());
+
+    rob_update();
+    top_testcollision();
+
+    akt_time(time, timecount, state);
+    new_height(top_verticalpos(), reached_height);
+}
+
 static void escape(gam_states &state, int &tower_position, int &tower_anglepos, int time) {
 
     ttsounds::instance()->stopsound(SND_WATER);
@@ -482,14 +542,12 @@ gam_result gam_towergame(Uint8 &anglepos, Uint16 &resttime, int &demo, void *dem
 
     static Uint8 door3[6] = { 0x17, 0x18, 0x18, 0x19, 0x19, 0xb };
 
-    Sint8 left_right, up_down;
-    bool space;
-
     gam_states state = STATE_PLAYING;
 
-    int demolen = 0, demo_alloc = 0;
+    int demolen = 0;
     Uint16 demokeys = 0;
-    Uint16 *dbuf = *(Uint16 **) demobuf;
+    dem_packer *recorder = (demo == -1) ? (dem_packer *) demobuf : NULL;
+    dem_stream *dstream = (demo > 0) ? (dem_stream *) demobuf : NULL;
 
     screenflag drawflags = SF_NONE;
 
@@ -514,12 +572,31 @@ gam_result gam_towergame(Uint8 &anglepos, Uint16 &resttime, int &demo, void *dem
     assert_msg(!(((demo == -1) || (demo > 0)) && !demobuf),
             "Trying to play or record a null demo.");
 
+    if (demo > 0)
+        rnd_seed(RND_GAME, lev_towerdemoseed());
+    else
+        rnd_seed(RND_GAME, rnd_next(RND_COSMETIC));
+
+    if (!demo && dem_journal_active()) {
+        Uint8 mark[7];
+        Uint32 seed = rnd_getseed(RND_GAME);
+
+        mark[0] = lev_towernr();
+        mark[1] = lev_towernr() >> 8;
+        for (int i = 0; i < 4; i++)
+            mark[2 + i] = seed >> (8 * i);
+        mark[6] = rob_count();
+        dem_journal_mark(DEM_JNL_TOWER, mark, 7);
+    }
+
     top_init();
 
     reached_height = tower_position = top_verticalpos();
     tower_angle = top_anglepos();
 
     ele_init();
+    evt_clear();
+    watervolume = -1;
     key_readkey();
 
     do {
@@ -528,29 +605,19 @@ gam_result gam_towergame(Uint8 &anglepos, Uint16 &resttime, int &demo, void *dem
         bg_tower_angle = tower_angle;
         bg_time = time;
 
-        if ((demo > 0) && (demolen < demo) && dbuf) {
-            demokeys = dbuf[demolen++];
-            get_keys(left_right, up_down, space, demokeys);
+        if ((demo > 0) && (demolen < demo) && dstream) {
+            demokeys = dem_next(*dstream);
+            demolen++;
             if ((demolen >= demo) || key_keystat())
                 state = STATE_ABORTED;
-        } else {
+        } else
             demokeys = key_keystat();
-            get_keys(left_right, up_down, space, demokeys);
-        }
 
         if (demo == -1) {
-            if ((demolen >= demo_alloc) || (dbuf == NULL)) {
-                demo_alloc += 200;
-                Uint16 *tmp = new Uint16[demo_alloc];
-                if (demolen && (dbuf)) {
-                    (void) memcpy(tmp, dbuf, demolen * sizeof(Uint16));
-                    delete[] dbuf;
-                }
-                dbuf = tmp;
-                *(Uint16 **) demobuf = tmp;
-            }
-            dbuf[demolen++] = demokeys;
-        }
+            dem_pack(*recorder, demokeys);
+            demolen++;
+        } else if (!demo)
+            dem_journal_keys(demokeys);
 
         if ((demo >= 0) && (demolen > demo)) {
             state = STATE_ABORTED;
@@ -574,22 +641,12 @@ gam_result gam_towergame(Uint8 &anglepos, Uint16 &resttime, int &demo, void *dem
         if (!demo)
             key_readkey();
 
-        ele_update();
-        snb_movesnowball();
-        top_updatetoppler(left_right, up_down, space);
+        sim_tick(demokeys, time, timecount, reached_height, state);
 
-        if (!top_dying())
-            rob_new(top_verticalpos());
-
-        rob_update();
-        top_testcollision();
-
-        akt_time(time, timecount, state);
-        new_height(top_verticalpos(), reached_height);
         scr_drawall(towerpos(top_verticalpos(), tower_position, top_anglepos(), tower_angle),
                 (4 - top_anglepos()) & 0x7f, time, false, 0, 0, drawflags);
         scr_swap();
-        ttsounds::instance()->play();
+        gam_playevents();
         dcl_wait();
     } while (!top_ended() && (state == STATE_PLAYING));
 
@@ -611,12 +668,12 @@ gam_result gam_towergame(Uint8 &anglepos, Uint16 &resttime, int &demo, void *dem
         while (lev_towerrows() > tower_position / 4 + 4) {
 
             lev_removelayer(lev_towerrows() - 1);
-            ttsounds::instance()->startsound(SND_CRUMBLE);
+            evt_sound(SND_CRUMBLE);
             rob_update();
             scr_drawall(towerpos(top_verticalpos(), tower_position, top_anglepos(), tower_angle),
                     (4 - top_anglepos()) & 0x7f, time, false, 0, 0, drawflags);
             scr_swap();
-            ttsounds::instance()->play();
+            gam_playevents();
 
             dcl_wait();
 
@@ -627,7 +684,7 @@ gam_result gam_towergame(Uint8 &anglepos, Uint16 &resttime, int &demo, void *dem
 
             if (top_verticalpos() > 8) {
                 lev_removelayer(top_verticalpos() / 4 - 2);
-                ttsounds::instance()->startsound(SND_CRUMBLE);
+                evt_sound(SND_CRUMBLE);
                 top_drop1layer();
             }
 
@@ -635,7 +692,7 @@ gam_result gam_towergame(Uint8 &anglepos, Uint16 &resttime, int &demo, void *dem
             scr_drawall(towerpos(top_verticalpos(), tower_position, top_anglepos(), tower_angle),
                     (4 - top_anglepos()) & 0x7f, time, false, 0, 0, drawflags);
             scr_swap();
-            ttsounds::instance()->play();
+            gam_playevents();
 
             dcl_wait();
         }
@@ -676,3 +733,259 @@ gam_result gam_towergame(Uint8 &anglepos, Uint16 &resttime, int &demo, void *dem
     }
 }
 
+void gam_simstart(Uint32 seed, snp_loop &loop, int robots) {
+    rnd_seed(RND_GAME, seed);
+    rob_initialize(robots);
+    snb_init();
+    top_init();
+    ele_init();
+    evt_clear();
+
+    loop.time = lev_towertime();
+    loop.timecount = 0;
+    loop.reached_height = top_verticalpos();
+}
+
+bool gam_simstep(Uint16 keys, snp_loop &loop) {
+    gam_states state = STATE_PLAYING;
+
+    sim_tick(keys, loop.time, loop.timecount, loop.reached_height, state);
+
+    /* nobody is listening, the events are dropped */
+    evt_clear();
+
+    return !top_ended() && (state == STATE_PLAYING);
+}
+
+/* gam_simulate() with the keys either from the array or the stream */
+static void simulate(const Uint16 *keys, dem_stream *stream, int keylen, Uint32 seed,
+        gam_simresult &res, int robots) {
+
+    snp_loop loop;
+    int frames = 0;
+    bool playing = true;
+
+    gam_simstart(seed, loop, robots);
+
+    while (playing && (frames < keylen)) {
+        playing = gam_simstep(keys ? keys[frames] : dem_next(*stream), loop);
+        frames++;
+    }
+
+    /* the game stops without the toppler having ended only when
+     the time is over */
+    res.timeout = !playing && !top_ended();
+    res.technic = top_technic();
+
+    if (top_targetreached()) {
+        /* the same points as bonus() counts up */
+        int lif = pts_lifes();
+
+        pts_add((loop.time / 10) * 10 + res.technic * 10 + 100 * 10);
+        if (lev_lasttower())
+            pts_add(lif * 5000);
+        res.result = GAME_FINISHED;
+    } else if (top_died() || res.timeout) {
+        pts_died();
+        res.result = GAME_DIED;
+    } else
+        res.result = GAME_ABORTED;
+
+    res.resttime = loop.time;
+    res.frames = frames;
+    res.points = pts_points();
+}
+
+void gam_simulate(const Uint16 *keys, int keylen, Uint32 seed, gam_simresult &res, int robots) {
+    simulate(keys, NULL, keylen, seed, res, robots);
+}
+
+void gam_simulate(dem_stream demo, int keylen, Uint32 seed, gam_simresult &res, int robots) {
+    simulate(NULL, &demo, keylen, seed, res, robots);
+}
+
+/* the demo player keeps at most this many snapshots of the demo */
+#define DEMO_KEYFRAMES 256
+
+/* ticks per shown frame at unlimited speed and ticks for one seek step */
+#define DEMO_FASTTICKS 32
+#define DEMO_SEEKTICKS 180
+
+/* forgets the events of ticks that are not shown, after a seek or with
+ fast playback gam_playevents() would otherwise start all their sounds
+ at once. Only the last color of the cross is kept, it belongs to the
+ state on the screen */
+static void drop_events(void) {
+    const evt_event *e = evt_events();
+    evt_event cross;
+
+    cross.type = EVT_SOUND;
+    for (int i = 0; i < evt_count(); i++)
+        if (e[i].type == EVT_CROSSCOLOR)
+            cross = e[i];
+
+    evt_clear();
+    if (cross.type == EVT_CROSSCOLOR)
+        evt_crosscolor(cross.par[0], cross.par[1], cross.par[2]);
+}
+
+/* restores the state at the given tick. The ticks played last are in
+ the snapshot ring (snapshot.h), so going back a little is only a
+ restore. Otherwise the state comes from the keyframe before the tick
+ and the ticks after it are simulated again and put into the ring */
+static void demo_seek(int target, Uint8 **keyframe, const dem_stream *keypos, int interval,
+        dem_stream &demo, snp_loop &loop, gam_states &state) {
+
+    demo = keypos[target / interval];
+    state = STATE_PLAYING;
+
+    if (snp_ring_restore(target, loop)) {
+        for (int t = target - target % interval; t < target; t++)
+            dem_next(demo);
+        return;
+    }
+
+    snp_restore(keyframe[target / interval], loop);
+    snp_ring_clear();
+
+    int t = target - target % interval;
+
+    snp_ring_push(t, loop);
+    while (t < target) {
+        sim_tick(dem_next(demo), loop.time, loop.timecount, loop.reached_height, state);
+        snp_ring_push(++t, loop);
+    }
+}
+
+void gam_demoplayer(int demolen, dem_stream demo) {
+
+    static const int speeds[] = { 1, 2, 4, 0 };
+    static Uint8 buf[SNP_MAXSIZE];
+
+    Uint8 *keyframe[DEMO_KEYFRAMES];
+    dem_stream keypos[DEMO_KEYFRAMES];
+    int keyframes = 0;
+    int interval = demolen / DEMO_KEYFRAMES + 1;
+
+    gam_states state = STATE_PLAYING;
+    snp_loop loop;
+    int end, tick, speed = 0;
+    bool paused = false, quit = false;
+
+    if (interval < SNP_KEYINTERVAL)
+        interval = SNP_KEYINTERVAL;
+
+    gam_simstart(lev_towerdemoseed(), loop);
+
+    /* play the demo once without output to find its end, remembering
+     the state every interval ticks for seeking */
+    for (end = 0;; end++) {
+        if (end % interval == 0) {
+            Uint32 len = snp_save(buf, loop);
+            keyframe[keyframes] = new Uint8[len];
+            memcpy(keyframe[keyframes], buf, len);
+            keypos[keyframes++] = demo;
+        }
+        if ((end >= demolen) || top_ended() || (state != STATE_PLAYING))
+            break;
+        sim_tick(dem_next(demo), loop.time, loop.timecount, loop.reached_height, state);
+    }
+    evt_clear();
+    watervolume = -1;
+
+    tick = 0;
+    snp_ring_clear();
+    demo_seek(tick, keyframe, keypos, interval, demo, loop, state);
+
+    int tower_position = top_verticalpos();
+    int tower_angle = top_anglepos();
+
+    key_readkey();
+
+    do {
+        int target = -1;
+
+        switch (key_readkey()) {
+        case fire_key:
+            paused = !paused;
+            break;
+        case right_key:
+            if (paused)
+                target = tick + 1;
+            else if (speed < SIZE(speeds) - 1)
+                speed++;
+            break;
+        case left_key:
+            if (paused)
+                target = tick - 1;
+            else if (speed > 0)
+                speed--;
+            break;
+        case up_key:
+            target = tick + DEMO_SEEKTICKS;
+            break;
+        case down_key:
+            target = tick - DEMO_SEEKTICKS;
+            break;
+        case break_key:
+            quit = true;
+            break;
+        default:
+            break;
+        }
+
+        if (target != -1) {
+            if (target < 0)
+                target = 0;
+            if (target > end)
+                target = end;
+
+            if (target == tick + 1) {
+                sim_tick(dem_next(demo), loop.time, loop.timecount, loop.reached_height, state);
+                snp_ring_push(target, loop);
+            } else if (target != tick) {
+                demo_seek(target, keyframe, keypos, interval, demo, loop, state);
+                drop_events();
+            }
+
+            if (target != tick + 1)
+                tower_position = top_verticalpos();
+            tick = target;
+        }
+
+        /* at higher speeds only every few ticks are shown */
+        if (!paused) {
+            int n = speeds[speed] ? speeds[speed] : DEMO_FASTTICKS;
+
+            while (n-- && (tick < end)) {
+                /* only the sounds of the tick that is shown are played */
+                drop_events();
+                sim_tick(dem_next(demo), loop.time, loop.timecount, loop.reached_height, state);
+                snp_ring_push(++tick, loop);
+            }
+        }
+
+        char s[40];
+
+        if (paused || (tick == end))
+            snprintf(s, 40, _("Pause %i/%i"), tick, end);
+        else if (speeds[speed])
+            snprintf(s, 40, _("%ix %i/%i"), speeds[speed], tick, end);
+        else
+            snprintf(s, 40, _("Fast %i/%i"), tick, end);
+
+        scr_drawall(towerpos(top_verticalpos(), tower_position, top_anglepos(), tower_angle),
+                (4 - top_anglepos()) & 0x7f, loop.time, false, 0, 0, SF_DEMO);
+        scr_writetext_center(SCREEN_HEIGHT - FONT_HEIGHT, s);
+        scr_swap();
+        gam_playevents();
+
+        if (speeds[speed] || paused)
+            dcl_wait();
+    } while (!quit);
+
+    for (int k = 0; k < keyframes; k++)
+        delete[] keyframe[k];
+
+    key_readkey();
+}
@@ -21,6 +21,10 @@
 
 #include <SDL_types.h>
 
+#include "snapshot.h"
+#include "demo.h"
+#include "decl.h"
+
 /* return values of towergame */
 typedef enum {
     GAME_FINISHED, // the tower has been finished successfully
@@ -38,16 +42,21 @@ void gam_done(void);
 void gam_newgame(void);
 
 /* initializes the tower specific data structures */
-void gam_loadtower(Uint8 tow);
+void gam_loadtower(Uint16 tow);
 
 /* leave toppler at the base of the tower */
 void gam_arrival(void);
 
 /* plays the towergame.
+ the game logic random numbers are seeded with the seed of the tower
+ demo when a demo is shown, otherwise with a new seed that can be
+ read with rnd_getseed(RND_GAME) afterwards.
  if demo is > 0, then demo == demo length, shows demo,
- getting keys from demobuf.
+ getting keys from the dem_stream demobuf points to.
  if demo == -1, then records a demo, and returns the demo length
- in demo, and the allocated buffer in demobuf.
+ in demo, the keys are added to the dem_packer demobuf points to.
+ In a normal game the keys go into the session journal, when it is
+ recorded.
  if demo == -2, then a testplay is done, just like demo recording, but
  without the recording
  if demo == 0, normal game
@@ -57,4 +66,48 @@ gam_result gam_towergame(Uint8 &anglepos, Uint16 &resttime, int &demo, void *dem
 /* pick up the toppler at the base of the tower */
 void gam_pick_up(Uint8 anglepos, Uint16 time);
 
+/* hands the sounds and colors the game logic reported as events
+ (events.h) to the sound system and the screen and plays the sounds */
+void gam_playevents(void);
+
+/* shows a demo of the selected tower with the possibility to pause it
+ (fire), to go single steps forward and backward while paused (left and
+ right), to change the speed between 1x, 2x, 4x and unlimited (left and
+ right) and to jump 10 seconds forward or back (up and down). Break
+ ends the player. The demo is simulated once before it is shown to
+ find its end and to store snapshots for seeking
+ */
+void gam_demoplayer(int demolen, dem_stream demo);
+
+/* the outcome of a simulated towergame */
+typedef struct {
+    gam_result result; // GAME_ABORTED when the keys ran out
+    bool timeout; // the toppler died because the time ran out
+    Uint16 resttime;
+    int frames; // number of keys used
+    unsigned int points; // including the bonus for a finished tower
+    int technic;
+} gam_simresult;
+
+/* plays the selected tower without graphics, sound and waiting, with
+ the keys taken from keys, one entry per frame like in the demos. The
+ game logic runs exactly as in gam_towergame() so the result is the
+ same a player would get with these keys and seed. Points and lifes are
+ taken from the current game, call gam_newgame() before the first tower.
+ robots is the number of robots the game was played with
+ */
+void gam_simulate(const Uint16 *keys, int keylen, Uint32 seed, gam_simresult &res,
+        int robots = DEFAULT_ROBOTS);
+void gam_simulate(dem_stream demo, int keylen, Uint32 seed, gam_simresult &res,
+        int robots = DEFAULT_ROBOTS);
+
+/* step by step simulation for tools that drive the game logic themselves,
+ together with the snapshots these can go back and try other keys.
+ gam_simstart() starts the selected tower like gam_simulate() does, with
+ the given number of robots,
+ gam_simstep() runs one tick and returns false when the tower is
+ finished, the toppler died or the time ran out */
+void gam_simstart(Uint32 seed, snp_loop &loop, int robots = DEFAULT_ROBOTS);
+bool gam_simstep(Uint16 keys, snp_loop &loop);
+
 #endif
@@ -18,8 +18,10 @@
 
 #include "keyb.h"
 #include "decl.h"
+#include "timing.h"
 
 #include <SDL.h>
+#include <string.h>
 
 static ttkey keydown, keytyped;
 static char chartyped;
@@ -36,6 +38,33 @@ SDL_Joystick *joy;
 
 #define JOYSTICK_DEADZONE 6000
 
+/* the SDL queue is read once per frame, all the calls during the frame
+ * use what was read then. Only when a frame takes longer than this many
+ * milliseconds, e.g. in a loop that waits for a key without drawing,
+ * the queue is read again */
+#define KEY_REPOLL 20
+
+/* the key events of the last frames, with the time they were taken
+ * from the queue. seq counts all events, the event with number n is in
+ * ring[n % KEY_RING] */
+#define KEY_RING 64
+
+typedef struct {
+    double time; // tim_ms() when the event was read
+    ttkey key;
+    bool pressed;
+} key_event;
+
+static key_event ring[KEY_RING];
+static Uint32 ringseq, framestart; // the first event of the current frame
+
+static bool polled; // the queue was read during this frame
+static double polltime;
+
+/* time from reading a key press to showing the next frame */
+static Uint32 lat_count;
+static double lat_sum, lat_max;
+
 bool tt_has_focus;
 
 struct _ttkeyconv {
@@ -48,6 +77,22 @@ struct _ttkeyconv {
 { up_key, SDLK_UP }, { down_key, SDLK_DOWN }, { left_key, SDLK_LEFT }, { right_key, SDLK_RIGHT }, {
         fire_key, SDLK_SPACE }, { break_key, SDLK_ESCAPE }, { pause_key, SDLK_p }, };
 
+/* ttkeyconv[] indexed by the SDLKey, for the menu the first entry of a
+ * key is used, for the game the last one */
+static ttkey keyconv[2][SDLK_LAST];
+
+static void build_keyconv(void) {
+    memset(keyconv, 0, sizeof(keyconv));
+
+    for (int i = SIZE(ttkeyconv) - 1; i >= 0; i--)
+        if ((ttkeyconv[i].key > SDLK_UNKNOWN) && (ttkeyconv[i].key < SDLK_LAST))
+            keyconv[0][ttkeyconv[i].key] = ttkeyconv[i].outval;
+
+    for (int i = 0; i < SIZE(ttkeyconv); i++)
+        if ((ttkeyconv[i].key > SDLK_UNKNOWN) && (ttkeyconv[i].key < SDLK_LAST))
+            keyconv[1][ttkeyconv[i].key] = ttkeyconv[i].outval;
+}
+
 void key_redefine(ttkey code, SDLKey key) {
     int i;
 
@@ -56,6 +101,8 @@ void key_redefine(ttkey code, SDLKey key) {
             ttkeyconv[i].key = key;
             break;
         }
+
+    build_keyconv();
 }
 
 void key_init(void) {
@@ -89,10 +136,16 @@ void key_init(void) {
     sdlkeytyped = SDLK_UNKNOWN;
     mouse_button = mouse_x = mouse_y = 0;
     mouse_moved = false;
+    ringseq = framestart = 0;
+    polled = false;
+    build_keyconv();
 }
 
 static void handleEvents(void) {
     SDL_Event e;
+
+    polled = true;
+    polltime = tim_ms();
 #ifdef __BLACKBERRY__
 #else
     if (joy_action) {
@@ -156,12 +209,12 @@ static void handleEvents(void) {
         case SDL_KEYDOWN:
         case SDL_KEYUP:
 
-            ttkey key = no_key;
-            for (int tmpk = 0; tmpk < SIZE(ttkeyconv); tmpk++)
-                if (ttkeyconv[tmpk].key == e.key.keysym.sym) {
-                    key = ttkeyconv[tmpk].outval;
-                    break;
-                }
+            ttkey key = key_sdlkey2conv(e.key.keysym.sym, false);
+            key_event &ev = ring[ringseq++ % KEY_RING];
+
+            ev.time = polltime;
+            ev.key = key;
+            ev.pressed = (e.key.state == SDL_PRESSED);
 
             if (e.key.state == SDL_PRESSED) {
 
@@ -190,18 +243,66 @@ void key_done(void) {
 #endif
 }
 
+/* reads the queue, if that wasn't done during this frame */
+static void pollEvents(void) {
+    if (!polled || (tim_ms() - polltime >= KEY_REPOLL))
+        handleEvents();
+}
+
+void key_frame(void) {
+    double now = tim_ms();
+
+    /* the events older than the ring are lost for the measurement */
+    if (ringseq - framestart > KEY_RING)
+        framestart = ringseq - KEY_RING;
+
+    for (Uint32 i = framestart; i != ringseq; i++) {
+        const key_event &ev = ring[i % KEY_RING];
+
+        if (ev.pressed) {
+            double l = now - ev.time;
+
+            lat_count++;
+            lat_sum += l;
+            if (l > lat_max)
+                lat_max = l;
+        }
+    }
+
+    framestart = ringseq;
+    polled = false;
+}
+
+void key_printlatency(FILE *out) {
+    if (!lat_count)
+        return;
+
+    fprintf(out, "input latency: %u key presses, average %.3f ms, max %.3f ms\n", lat_count,
+            lat_sum / lat_count, lat_max);
+}
+
 Uint16 key_keystat(void) {
-    handleEvents();
-    return keydown;
+    pollEvents();
+
+    /* keys pressed and released again within one frame are still
+     * seen for that frame */
+    Uint16 keys = keydown;
+    Uint32 first = (ringseq - framestart > KEY_RING) ? ringseq - KEY_RING : framestart;
+
+    for (Uint32 i = first; i != ringseq; i++)
+        if (ring[i % KEY_RING].pressed)
+            keys |= ring[i % KEY_RING].key;
+
+    return keys;
 }
 
 bool key_keypressed(ttkey key) {
-    handleEvents();
+    pollEvents();
     return (keytyped & key) != 0;
 }
 
 SDLKey key_sdlkey(void) {
-    handleEvents();
+    pollEvents();
     SDLKey tmp = sdlkeytyped;
     sdlkeytyped = SDLK_UNKNOWN;
     keytyped = no_key;
@@ -210,7 +311,7 @@ SDLKey key_sdlkey(void) {
 }
 
 void key_keydatas(SDLKey &sdlkey, ttkey &tkey, char &ch) {
-    handleEvents();
+    pollEvents();
     sdlkey = sdlkeytyped;
     tkey = keytyped;
     ch = chartyped;
@@ -236,25 +337,14 @@ SDLKey key_conv2sdlkey(ttkey k, bool game) {
 }
 
 ttkey key_sdlkey2conv(SDLKey k, bool game) {
-    register int i;
-
-    if (k != SDLK_UNKNOWN) {
-        if (game) {
-            for (i = SIZE(ttkeyconv) - 1; i >= 0; i--)
-                if (ttkeyconv[i].key == k)
-                    return ttkeyconv[i].outval;
-        } else {
-            for (i = 0; i < SIZE(ttkeyconv); i++)
-                if (ttkeyconv[i].key == k)
-                    return ttkeyconv[i].outval;
-        }
-    }
+    if ((k > SDLK_UNKNOWN) && (k < SDLK_LAST))
+        return keyconv[game ? 1 : 0][k];
 
     return no_key;
 }
 
 ttkey key_readkey(void) {
-    handleEvents();
+    pollEvents();
 
     ttkey i = keytyped;
 
@@ -272,13 +362,14 @@ void wait_for_focus(void) {
         handleEvents();
     }
 
+    framestart = ringseq;
     keytyped = no_key;
     chartyped = 0;
     sdlkeytyped = SDLK_UNKNOWN;
 }
 
 char key_chartyped(void) {
-    handleEvents();
+    pollEvents();
     int erg = chartyped;
     chartyped = 0;
     return erg;
@@ -292,6 +383,9 @@ void key_wait_for_none(keyb_wait_proc bg) {
             (*bg)();
     } while (keydown);
 
+    /* the presses that were waited for are over, they don't count for
+     * the next frame */
+    framestart = ringseq;
     keytyped = no_key;
     chartyped = 0;
     sdlkeytyped = SDLK_UNKNOWN;
@@ -299,7 +393,7 @@ void key_wait_for_none(keyb_wait_proc bg) {
 
 bool key_mouse(Uint16 *x, Uint16 *y, ttkey *bttn) {
     bool tmp = mouse_moved;
-    handleEvents();
+    pollEvents();
     switch (mouse_button) {
     default:
         *bttn = no_key;
@@ -23,6 +23,7 @@
 
 #include <SDL_types.h>
 #include <SDL_keyboard.h>
+#include <stdio.h>
 
 typedef enum {
     no_key = 0x0000,
@@ -44,7 +45,17 @@ void key_done(void);
 /* waits until the game window gets focus */
 void wait_for_focus(void);
 
-/* returns bitmask with currently pressed keys */
+/* the SDL event queue is read only once for each frame. Call this
+ whenever a frame is shown, it measures the time from reading the key
+ presses of the frame until now and starts the next frame */
+void key_frame(void);
+
+/* prints the average and the longest time from reading a key press
+ until the frame was shown */
+void key_printlatency(FILE *out);
+
+/* returns bitmask with currently pressed keys, including the keys that
+ were pressed and released again during this frame */
 Uint16 key_keystat(void);
 
 /* true, if key is pressed */
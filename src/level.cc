@@ -23,48 +23,73 @@
 #include "archi.h"
 #include "configuration.h"
 #include "screen.h"
+#include "snapshot.h"
 
 #endif
 
 #include "decl.h"
+#include "demo.h"
+#include <SDL_thread.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <sys/stat.h>
+#include <zlib.h>
 
 #define TOWERWID 16
 
-/* tower block flags */
+/* tower block flags, flag n is the property of the row masks
+ * for lev_mask n, so keep them in the same order */
 #define TBF_NONE     0x0000
 #define TBF_EMPTY    0x0001 /* block is not solid */
 #define TBF_PLATFORM 0x0002 /* block is a platform */
 #define TBF_STATION  0x0004 /* block is a lift station */
 #define TBF_DEADLY   0x0008 /* block is deadly */
 #define TBF_ROBOT    0x0010 /* block is a robot */
+#define TBF_STICK    0x0020 /* block contains a stick */
+#define TBF_BOX      0x0040 /* block is a box */
+#define TBF_DOOR     0x0080 /* block is part of a door */
+#define TBF_ELEVATOR 0x0100 /* block is part of an elevator */
 
 struct _tblockdata {
     const char *nam; /* name */
     char ch; /* representation in saved tower file */
     Uint16 tf; /* flags; TBF_foo */
-}static towerblockdata[NUM_TBLOCKS] = { { "space", ' ', TBF_EMPTY }, { "lift top stop", 'v',
-        TBF_EMPTY | TBF_STATION }, { "lift middle stop", '+', TBF_EMPTY | TBF_STATION }, {
-        "lift bottom stop", 0, TBF_EMPTY | TBF_STATION }, { "robot 1", '1', TBF_EMPTY | TBF_DEADLY
-        | TBF_ROBOT }, { "robot 2", '2', TBF_EMPTY | TBF_DEADLY | TBF_ROBOT }, { "robot 3", '3',
-        TBF_EMPTY | TBF_DEADLY | TBF_ROBOT },
-        { "robot 4", '4', TBF_EMPTY | TBF_DEADLY | TBF_ROBOT }, { "robot 5", '5', TBF_EMPTY
-                | TBF_DEADLY | TBF_ROBOT }, { "robot 6", '6', TBF_EMPTY | TBF_DEADLY | TBF_ROBOT },
-        { "robot 7", '7', TBF_EMPTY | TBF_DEADLY | TBF_ROBOT }, { "stick", '!', /*TBF_PLATFORM*/}, {
-                "step", '-', TBF_PLATFORM }, { "vanisher step", '.', TBF_PLATFORM }, {
-                "slider > step", '>', TBF_PLATFORM }, { "slider < step", '<', TBF_PLATFORM }, {
-                "box", 'b', TBF_NONE }, { "door", '#', TBF_EMPTY },
-        { "target door", 'T', TBF_EMPTY }, { "stick top", 0, TBF_STATION /*|TBF_PLATFORM*/}, {
-                "stick middle", 0, TBF_STATION /*|TBF_PLATFORM*/},
-        { "stick bottom", 0, TBF_STATION /*|TBF_PLATFORM*/}, { "lift top", 0, TBF_STATION
-                | TBF_PLATFORM }, { "lift middle", 0, TBF_STATION | TBF_PLATFORM }, { "lift bottom",
-                '^', TBF_STATION | TBF_PLATFORM }, { "stick at door", 0, },
-        { "stick at target", 0, }, { "lift at door", 0, TBF_STATION | TBF_PLATFORM }, {
-                "lift at target", 0, TBF_STATION | TBF_PLATFORM }, };
-
-/* Sections in the data files; do not change the order,
+}static towerblockdata[NUM_TBLOCKS] = {
+        { "space", ' ', TBF_EMPTY },
+        { "lift top stop", 'v', TBF_EMPTY | TBF_STATION },
+        { "lift middle stop", '+', TBF_EMPTY | TBF_STATION },
+        { "lift bottom stop", 0, TBF_EMPTY | TBF_STATION },
+        { "robot 1", '1', TBF_EMPTY | TBF_DEADLY | TBF_ROBOT },
+        { "robot 2", '2', TBF_EMPTY | TBF_DEADLY | TBF_ROBOT },
+        { "robot 3", '3', TBF_EMPTY | TBF_DEADLY | TBF_ROBOT },
+        { "robot 4", '4', TBF_EMPTY | TBF_DEADLY | TBF_ROBOT },
+        { "robot 5", '5', TBF_EMPTY | TBF_DEADLY | TBF_ROBOT },
+        { "robot 6", '6', TBF_EMPTY | TBF_DEADLY | TBF_ROBOT },
+        { "robot 7", '7', TBF_EMPTY | TBF_DEADLY | TBF_ROBOT },
+        { "stick", '!', TBF_STICK /*|TBF_PLATFORM*/},
+        { "step", '-', TBF_PLATFORM },
+        { "vanisher step", '.', TBF_PLATFORM },
+        { "slider > step", '>', TBF_PLATFORM },
+        { "slider < step", '<', TBF_PLATFORM },
+        { "box", 'b', TBF_BOX },
+        { "door", '#', TBF_EMPTY | TBF_DOOR },
+        { "target door", 'T', TBF_EMPTY | TBF_DOOR },
+        { "stick top", 0, TBF_STATION | TBF_STICK | TBF_ELEVATOR /*|TBF_PLATFORM*/},
+        { "stick middle", 0, TBF_STATION | TBF_STICK | TBF_ELEVATOR /*|TBF_PLATFORM*/},
+        { "stick bottom", 0, TBF_STATION | TBF_STICK | TBF_ELEVATOR /*|TBF_PLATFORM*/},
+        { "lift top", 0, TBF_STATION | TBF_PLATFORM | TBF_ELEVATOR },
+        { "lift middle", 0, TBF_STATION | TBF_PLATFORM | TBF_ELEVATOR },
+        { "lift bottom", '^', TBF_STATION | TBF_PLATFORM | TBF_ELEVATOR },
+        { "stick at door", 0, TBF_STICK | TBF_DOOR },
+        { "stick at target", 0, TBF_STICK },
+        { "lift at door", 0, TBF_STATION | TBF_PLATFORM },
+        { "lift at target", 0, TBF_STATION | TBF_PLATFORM }, };
+
+/* Sections in the tower files and in missions of version 1, missions
+ * of version 1 start with the name and prio, the number of towers and
+ * the position of the index with the start of each tower, a list of
+ * sections that ends with TSS_END. Do not change the order,
  * and always add new ones to the end, so that we keep
  * compatibility with old towers/missions.
  * (the loader silently ignores unrecognized sections)
@@ -79,26 +104,606 @@ char tss_string_color[] = "color";
 char tss_string_data[] = "data";
 char tss_string_demo[] = "demo";
 char tss_string_robot[] = "robot";
+char tss_string_keys[] = "keys";
 
-static Uint8 * mission = NULL;
-static Uint8 towerheight;
-static Uint8 towerrobot;
-static Uint8 tower[256][TOWERWID];
-static char towername[TOWERNAMELEN + 1];
-static Uint8 towernumber;
-static Uint8 towercolor_red, towercolor_green, towercolor_blue;
-static Uint16 towertime;
-static Uint16 *towerdemo = NULL;
-static int towerdemo_len = 0;
-
-typedef struct mission_node {
+/* layout of missions of version 2, all numbers are little endian:
+ *
+ * header (MIS_HEADERSIZE bytes)
+ *   0  8 magic
+ *   8  2 version
+ *  10  1 prio
+ *  11  1 length of the name
+ *  12 32 name
+ *  44  4 number of towers
+ *  48  4 crc32 of the tower table
+ *  52  8 reserved
+ *  60  4 crc32 of the header bytes 0-59
+ *
+ * the tower table with one entry of MIS_ENTRYSIZE bytes per tower
+ *   0  4 position of the tower data
+ *   4  4 length of the tower data
+ *   8  4 crc32 of the tower data
+ *  12  2 height
+ *  14  2 time
+ *  16  1 robot
+ *  17  3 red, green, blue
+ *  20  4 number of keys of the demo
+ *  24  4 seed of the demo
+ *  28  1 codec of the demo
+ *  29  1 highest block number used in the tower
+ *  30  2 reserved
+ *  32  8 password
+ *  40 20 name
+ *  60  4 reserved
+ *
+ * the tower data, each starting at a multiple of MIS_ALIGN: the blocks
+ * of the tower, 16 bytes for each row from the bottom up, followed by
+ * the demo. So the blocks of a tower can be used without decoding and
+ * everything that lists the towers only needs the table
+ */
+#define MIS_MAGIC "TTMISS\x1a\0"
+#define MIS_VERSION 2
+#define MIS_HEADERSIZE 64
+#define MIS_ENTRYSIZE 64
+#define MIS_NAMELEN 32
+#define MIS_ALIGN 16
+
+/* the codecs of the demo */
+typedef enum {
+    MIS_DEMO_NONE,
+    MIS_DEMO_DEFLATED, // 16 bit numbers, one for each tick, deflated
+    MIS_DEMO_PACKED, // the packed form of demo.h
+    MIS_DEMO_PACKED_DEFLATED // the packed form, deflated
+} mis_democodec;
+
+static GAME_STATE Uint8 * mission = NULL;
+static GAME_STATE Uint16 towerheight;
+static GAME_STATE Uint8 towerrobot;
+static GAME_STATE char towername[TOWERNAMELEN + 1];
+static GAME_STATE Uint16 towernumber;
+static GAME_STATE bool towerfrommission; // the tower was selected from the mission, not loaded or created
+static GAME_STATE Uint8 towercolor_red, towercolor_green, towercolor_blue;
+static GAME_STATE Uint16 towertime;
+static GAME_STATE Uint8 *towerdemo = NULL; // packed, see demo.h
+static GAME_STATE Uint32 towerdemo_size = 0;
+static GAME_STATE int towerdemo_len = 0;
+static GAME_STATE Uint32 towerdemo_seed = 0;
+
+/* the tower is stored in chunks of rows. A chunk is only allocated when
+ * a block is put into one of its rows, missing chunks are empty. So
+ * the memory a tower needs grows with the rows that are used and
+ * everything that only looks at some rows costs the same for all
+ * heights */
+#define CHUNK_ROWS 64
+#define NUM_CHUNKS ((LEV_MAXROWS + CHUNK_ROWS - 1) / CHUNK_ROWS)
+
+typedef struct {
+    Uint8 block[CHUNK_ROWS][TOWERWID];
+    /* for each row and each property of lev_mask a mask of the columns
+     * with blocks that have this property. They are kept up to date by
+     * all functions that change the tower, so that the collision tests
+     * can check the whole width of a figure at once */
+    Uint16 mask[CHUNK_ROWS][NUM_TMASKS];
+    /* the row is in changedrows */
+    bool changed[CHUNK_ROWS];
+#ifdef __BLACKBERRY__
+#else
+    /* the cells changed since the last consistency check, one bit for
+     * each column of a row. The check only looks at the rows these
+     * changes can have an effect on, see lev_is_consistent() */
+    Uint16 changedcells[CHUNK_ROWS];
+#endif
+} tower_chunk;
+
+static GAME_STATE tower_chunk *towerchunk[NUM_CHUNKS];
+
+/* the rows that were changed since the tower was selected, created or
+ * loaded together with their contents from before, sorted by row. The
+ * snapshots only contain these rows, so their size depends on what
+ * happened in the game and not on the height of the tower */
+typedef struct {
+    Uint16 row;
+    Uint8 orig[TOWERWID];
+} changed_row;
+
+static GAME_STATE changed_row *changedrows = NULL;
+static GAME_STATE int changedcount = 0, changedsize = 0;
+
+#ifdef __BLACKBERRY__
+#else
+static GAME_STATE bool changedall = true;
+
+/* the rows with changedcells, so that the consistency check only
+ * visits those. Each row is in the list only once, it is added when
+ * the first cell of the row changes */
+static GAME_STATE Uint16 *dirtyrows = NULL;
+static GAME_STATE int dirtycount = 0, dirtysize = 0;
+
+/* one change in the undo journal of the editor */
+typedef enum {
+    JRN_CELL, // one block changed from oldblock to newblock
+    JRN_INSROW, // an empty row was inserted
+    JRN_DELROW // an empty row was removed
+} jrn_kind;
+
+typedef struct {
+    Uint8 kind;
+    Uint16 row;
+    Uint8 col;
+    Uint8 oldblock;
+    Uint8 newblock;
+} jrn_entry;
+
+/* the number of changes the journal can hold, when it is full the
+ * oldest steps are forgotten */
+#define JRN_SIZE 0x10000
+
+static void jrn_add(jrn_kind kind, int row, int col = 0, Uint8 oldblock = 0, Uint8 newblock = 0);
+static void free_check(void);
+#endif
+
+static Uint16 blockflags(Uint8 block) {
+    return (block < NUM_TBLOCKS) ? towerblockdata[block].tf : TBF_NONE;
+}
+
+/* the chunk containing the row, NULL if it is not allocated or the row
+ * is outside of the tower */
+static inline tower_chunk *chunk_of(int row) {
+    return ((unsigned) row < LEV_MAXROWS) ? towerchunk[row / CHUNK_ROWS] : NULL;
+}
+
+/* the chunk containing the row, allocated with empty rows when it
+ * doesn't exist yet. The row must be inside of the tower */
+static tower_chunk *chunk_for(int row) {
+    tower_chunk *&c = towerchunk[row / CHUNK_ROWS];
+
+    if (!c) {
+        c = new tower_chunk;
+        memset(c, 0, sizeof(tower_chunk));
+        memset(c->block, TB_EMPTY, sizeof(c->block));
+        for (int r = 0; r < CHUNK_ROWS; r++)
+            for (Uint16 f = blockflags(TB_EMPTY), k = 0; f; f >>= 1, k++)
+                if (f & 1)
+                    c->mask[r][k] = 0xffff;
+    }
+    return c;
+}
+
+/* the block at the position, rows outside of the tower are empty */
+static inline Uint8 block_at(int row, int col) {
+    tower_chunk *c = chunk_of(row);
+    return c ? c->block[row % CHUNK_ROWS][col] : (Uint8) TB_EMPTY;
+}
+
+/* the blocks of one row or NULL if the row is empty because its chunk
+ * doesn't exist */
+static inline const Uint8 *row_blocks(int row) {
+    tower_chunk *c = chunk_of(row);
+    return c ? c->block[row % CHUNK_ROWS] : NULL;
+}
+
+static void free_chunks(void) {
+    for (int i = 0; i < NUM_CHUNKS; i++) {
+        if (towerchunk[i])
+            delete towerchunk[i];
+        towerchunk[i] = NULL;
+    }
+}
+
+/* forgets the changed rows, the tower as it is now is the one the
+ * snapshots are taken against */
+static void reset_changes(void) {
+    for (int i = 0; i < changedcount; i++) {
+        tower_chunk *c = chunk_of(changedrows[i].row);
+        if (c)
+            c->changed[changedrows[i].row % CHUNK_ROWS] = false;
+    }
+    changedcount = 0;
+}
+
+/* adds the row to changedrows, its chunk must exist */
+static void add_change(int row) {
+    tower_chunk *c = chunk_of(row);
+    int i = changedcount;
+
+    if (changedcount == changedsize) {
+        changed_row *n = new changed_row[changedsize ? 2 * changedsize : 64];
+        if (changedrows) {
+            memcpy(n, changedrows, changedcount * sizeof(changed_row));
+            delete[] changedrows;
+        }
+        changedrows = n;
+        changedsize = changedsize ? 2 * changedsize : 64;
+    }
+
+    while ((i > 0) && (changedrows[i - 1].row > row))
+        i--;
+    memmove(changedrows + i + 1, changedrows + i, (changedcount - i) * sizeof(changed_row));
+    changedcount++;
+
+    changedrows[i].row = row;
+    memcpy(changedrows[i].orig, c->block[row % CHUNK_ROWS], TOWERWID);
+    c->changed[row % CHUNK_ROWS] = true;
+}
+
+#ifdef __BLACKBERRY__
+#else
+/* notes the changed cells of a row for the consistency check */
+static void mark_cells(tower_chunk *c, int row, Uint16 cells) {
+    Uint16 &m = c->changedcells[row % CHUNK_ROWS];
+
+    if (changedall)
+        return;
+
+    if (!m) {
+        if (dirtycount == dirtysize) {
+            Uint16 *n = new Uint16[dirtysize ? 2 * dirtysize : 64];
+            if (dirtyrows) {
+                memcpy(n, dirtyrows, dirtycount * sizeof(Uint16));
+                delete[] dirtyrows;
+            }
+            dirtyrows = n;
+            dirtysize = dirtysize ? 2 * dirtysize : 64;
+        }
+        dirtyrows[dirtycount++] = row;
+    }
+    m |= cells;
+}
+#endif
+
+/* recalculates the masks for the rows from up to but excluding to */
+static void update_masks(int from, int to) {
+#ifdef __BLACKBERRY__
+#else
+    if ((from == 0) && (to == LEV_MAXROWS))
+        changedall = true;
+#endif
+    for (int row = from; row < to; row++) {
+        tower_chunk *c = chunk_of(row);
+
+        /* missing chunks are empty and don't change */
+        if (!c) {
+            row |= CHUNK_ROWS - 1;
+            continue;
+        }
+
+        Uint16 *m = c->mask[row % CHUNK_ROWS];
+        const Uint8 *b = c->block[row % CHUNK_ROWS];
+
+        memset(m, 0, sizeof(c->mask[0]));
+
+        for (int col = 0; col < TOWERWID; col++)
+            for (Uint16 f = blockflags(b[col]), k = 0; f; f >>= 1, k++)
+                if (f & 1)
+                    m[k] |= 1 << col;
+#ifdef __BLACKBERRY__
+#else
+        mark_cells(c, row, 0xffff);
+#endif
+    }
+}
+
+/* changes one block of the tower together with the masks. Rows
+ * outside of the tower can't contain blocks */
+static void set_block(int row, int col, Uint8 block) {
+    if ((unsigned) row >= LEV_MAXROWS)
+        return;
+
+    tower_chunk *c = chunk_of(row);
+    int r = row % CHUNK_ROWS;
+    Uint16 f = blockflags(block);
+
+    if (!c) {
+        if (block == TB_EMPTY)
+            return;
+        c = chunk_for(row);
+    }
+
+    if (c->block[r][col] == block)
+        return;
+
+    if (!c->changed[r])
+        add_change(row);
+#ifdef __BLACKBERRY__
+#else
+    mark_cells(c, row, 1 << col);
+    jrn_add(JRN_CELL, row, col, c->block[r][col], block);
+#endif
+    c->block[r][col] = block;
+
+    for (int k = 0; k < NUM_TMASKS; k++, f >>= 1)
+        if (f & 1)
+            c->mask[r][k] |= 1 << col;
+        else
+            c->mask[r][k] &= ~(1 << col);
+}
+
+/* replaces the tower by height rows of blocks, 16 for each row */
+static void put_rows(const Uint8 *blocks, int height) {
+    static const Uint8 empty[TOWERWID] = { 0 };
+
+    free_chunks();
+    changedcount = 0;
+
+    for (int row = 0; row < height; row++)
+        if (memcmp(blocks + row * TOWERWID, empty, TOWERWID))
+            memcpy(chunk_for(row)->block[row % CHUNK_ROWS], blocks + row * TOWERWID, TOWERWID);
+
+    update_masks(0, LEV_MAXROWS);
+}
+
+/* copies the blocks of the rows from up to but excluding to into
+ * blocks, 16 for each row */
+static void get_rows(Uint8 *blocks, int from, int to) {
+    for (int row = from; row < to; row++, blocks += TOWERWID) {
+        const Uint8 *b = row_blocks(row);
+        if (b)
+            memcpy(blocks, b, TOWERWID);
+        else
+            memset(blocks, TB_EMPTY, TOWERWID);
+    }
+}
+
+/* copies the row from into the row to */
+static void copy_row(int to, int from) {
+    const Uint8 *b = row_blocks(from);
+
+    if (b)
+        memcpy(chunk_for(to)->block[to % CHUNK_ROWS], b, TOWERWID);
+    else if (chunk_of(to))
+        memset(chunk_of(to)->block[to % CHUNK_ROWS], TB_EMPTY, TOWERWID);
+}
+
+/* moves the rows from position on up by one and puts an empty row
+ * at position. The rows move, so the changes start again from here */
+static void insert_row(int position) {
+    reset_changes();
+    for (int row = towerheight; row > position; row--)
+        copy_row(row, row - 1);
+    copy_row(position, -1);
+    towerheight++;
+    update_masks(position, towerheight);
+}
+
+/* removes the row at position and moves the rows above down by one */
+static void remove_row(int position) {
+    reset_changes();
+    for (int row = position; row + 1 < towerheight; row++)
+        copy_row(row, row + 1);
+    towerheight--;
+    copy_row(towerheight, -1);
+    update_masks(position, towerheight + 1);
+}
+
+#ifdef __BLACKBERRY__
+#else
+/* the journal is a ring of changes, the changes of step n are the ones
+ * from jrn_start(n) up to jrn_start(n + 1). Steps jrn_first up to
+ * jrn_cur can be undone, steps jrn_cur up to jrn_last redone, and the
+ * changes of the open step jrn_cur are collected from jrn_start(jrn_cur)
+ * up to jrn_pos. Positions and step numbers only grow, the index into
+ * the rings is taken modulo their size */
+static GAME_STATE jrn_entry *journal = NULL;
+static GAME_STATE Uint32 *jrn_steps = NULL;
+static GAME_STATE int jrn_depth;
+static GAME_STATE Uint32 jrn_first, jrn_cur, jrn_last, jrn_pos;
+static GAME_STATE bool jrn_paused;
+static GAME_STATE bool jrn_overflow; // the open step doesn't fit into the journal
+
+static Uint32 &jrn_start(Uint32 step) {
+    return jrn_steps[step % (jrn_depth + 2)];
+}
+
+static void jrn_add(jrn_kind kind, int row, int col, Uint8 oldblock, Uint8 newblock) {
+    if (!journal || jrn_paused || jrn_overflow)
+        return;
+
+    /* a new change makes the undone steps unreachable */
+    jrn_last = jrn_cur;
+
+    /* make room by forgetting the oldest steps */
+    while ((jrn_first < jrn_cur) && (jrn_pos + 1 - jrn_start(jrn_first) > JRN_SIZE))
+        jrn_first++;
+
+    if (jrn_pos + 1 - jrn_start(jrn_first) > JRN_SIZE) {
+        jrn_overflow = true;
+        return;
+    }
+
+    jrn_entry &e = journal[jrn_pos % JRN_SIZE];
+    e.kind = kind;
+    e.row = row;
+    e.col = col;
+    e.oldblock = oldblock;
+    e.newblock = newblock;
+    jrn_pos++;
+}
+
+/* does or reverts one change of the journal */
+static void jrn_apply(const jrn_entry &e, bool undo) {
+    switch (e.kind) {
+    case JRN_CELL:
+        set_block(e.row, e.col, undo ? e.oldblock : e.newblock);
+        break;
+    case JRN_INSROW:
+        if (undo)
+            remove_row(e.row);
+        else
+            insert_row(e.row);
+        break;
+    case JRN_DELROW:
+        if (undo)
+            insert_row(e.row);
+        else
+            remove_row(e.row);
+        break;
+    }
+}
+
+void lev_undo_init(int depth) {
+    delete[] journal;
+    delete[] jrn_steps;
+    journal = NULL;
+    jrn_steps = NULL;
+
+    if (depth <= 0)
+        return;
+
+    journal = new jrn_entry[JRN_SIZE];
+    jrn_steps = new Uint32[depth + 2];
+    jrn_depth = depth;
+    jrn_first = jrn_cur = jrn_last = jrn_pos = 0;
+    jrn_start(0) = 0;
+    jrn_paused = false;
+    jrn_overflow = false;
+}
+
+void lev_undo_mark(void) {
+    if (!journal)
+        return;
+
+    if (jrn_overflow) {
+        /* the step was too big to be recorded, so the steps before
+         * it can't be undone either */
+        jrn_first = jrn_last = jrn_cur;
+        jrn_start(jrn_cur) = jrn_pos;
+        jrn_overflow = false;
+        return;
+    }
+
+    if (jrn_pos == jrn_start(jrn_cur))
+        return;
+
+    jrn_cur++;
+    jrn_start(jrn_cur) = jrn_pos;
+    jrn_last = jrn_cur;
+    if (jrn_cur - jrn_first > (Uint32) jrn_depth)
+        jrn_first++;
+}
+
+void lev_undo_pause(bool pause) {
+    jrn_paused = pause;
+}
+
+bool lev_undo(void) {
+    lev_undo_mark();
+
+    if (!journal || (jrn_cur == jrn_first))
+        return false;
+
+    bool was = jrn_paused;
+
+    jrn_cur--;
+    jrn_paused = true;
+    for (Uint32 p = jrn_start(jrn_cur + 1); p > jrn_start(jrn_cur); p--)
+        jrn_apply(journal[(p - 1) % JRN_SIZE], true);
+    jrn_paused = was;
+    jrn_pos = jrn_start(jrn_cur);
+
+    return true;
+}
+
+bool lev_redo(void) {
+    lev_undo_mark();
+
+    if (!journal || (jrn_cur == jrn_last))
+        return false;
+
+    bool was = jrn_paused;
+
+    jrn_paused = true;
+    for (Uint32 p = jrn_start(jrn_cur); p < jrn_start(jrn_cur + 1); p++)
+        jrn_apply(journal[p % JRN_SIZE], false);
+    jrn_paused = was;
+    jrn_cur++;
+    jrn_pos = jrn_start(jrn_cur);
+
+    return true;
+}
+#endif
+
+/* changes whenever a new mission is loaded */
+static GAME_STATE Uint32 missiongeneration = 1;
+static GAME_STATE bool missionvalid; // the structure of the loaded mission is ok
+static GAME_STATE Uint16 missiontowers;
+static GAME_STATE Uint32 missionindex; // position of the tower start positions in the mission
+static GAME_STATE bool mission2; // the mission is of version 2
+
+/* the last decoded towers, so that selecting the same tower again, e.g.
+ * after the toppler died or for the demos in the menu, only needs to
+ * copy the data */
+#define TOWERCACHE_SIZE 4
+
+static GAME_STATE struct {
+    Uint32 generation; // of the mission the tower belongs to, 0 for unused entries
+    Uint32 lastuse;
+    Uint16 number;
+    Uint16 height;
+    Uint8 robot;
+    Uint8 red, green, blue;
+    Uint16 time;
+    char name[TOWERNAMELEN + 1];
+    Uint8 *data; // height rows of 16 blocks
+    Uint8 *demo; // packed
+    Uint32 demo_size;
+    int demo_len;
+    Uint32 demo_seed;
+} towercache[TOWERCACHE_SIZE];
+
+static GAME_STATE Uint32 towercache_clock;
+
+static void free_towercache(void) {
+    for (int t = 0; t < TOWERCACHE_SIZE; t++) {
+        if (towercache[t].demo)
+            delete[] towercache[t].demo;
+        if (towercache[t].data)
+            delete[] towercache[t].data;
+        towercache[t].demo = NULL;
+        towercache[t].data = NULL;
+        towercache[t].generation = 0;
+    }
+}
+
+/* all the mission files that were found, in the order of the scan. The
+ * same information is kept in the mission index file, so that the
+ * files only need to be read again, when they have changed */
+typedef struct {
     char name[30];
     char fname[MAX_PATH];
     Uint8 prio; // the lower prio, the further in front the mission will be in the list
-    mission_node *next;
-} mission_node;
-
-mission_node * missions;
+    Uint16 dir; // the directory the file was found in
+    Uint32 mtime, size; // of the file, when the information was read
+    Uint16 towers; // number of towers in the mission
+    bool demo; // true, if at least one tower has a demo
+    Uint32 demofirst; // the towers with a demo in the demo list
+    Uint16 demos;
+} mission_file;
+
+static mission_file *mfiles = NULL;
+static int mfilecount = 0, mfilesize = 0;
+
+/* the towers with a demo of a mission file, in a list for all files,
+ * the towers of each file follow each other */
+typedef struct {
+    Uint16 tower;
+    Uint32 length; // number of ticks
+} demo_tower;
+
+typedef struct {
+    demo_tower *tower;
+    Uint32 count, size;
+} demo_list;
+
+static demo_list mdemos;
+
+/* the demos of the usable missions, built with the mission list */
+static lev_demoinfo *demoindex = NULL;
+static Uint32 demoindexcount = 0;
+
+/* the usable missions, index into mfiles, sorted by prio. Missions
+ * with the same name as an earlier one are left out */
+static Uint16 *missions = NULL;
+static int missioncount = 0;
 
 #ifndef CREATOR
 #ifdef __BLACKBERRY__
@@ -141,98 +746,759 @@ char conv_towercode2char(Uint8 code) {
     return towerblockdata[TB_EMPTY].ch;
 }
 
-static void add_mission(char const *fname) {
+static Uint32 getlong(const Uint8 *p) {
+    return (Uint32) p[0] + ((Uint32) p[1] << 8) + ((Uint32) p[2] << 16) + ((Uint32) p[3] << 24);
+}
+
+static Uint16 getword(const Uint8 *p) {
+    return (Uint16) p[0] + ((Uint16) p[1] << 8);
+}
+
+static Uint32 checksum(const Uint8 *data, Uint32 len) {
+    return crc32(crc32(0L, Z_NULL, 0), data, len);
+}
+
+static void add_demotower(demo_list &l, Uint16 tower, Uint32 length) {
+    if (l.count == l.size) {
+        demo_tower *n = new demo_tower[l.size + 50];
+        if (l.count)
+            memcpy(n, l.tower, l.count * sizeof(demo_tower));
+        delete[] l.tower;
+        l.tower = n;
+        l.size += 50;
+    }
+    l.tower[l.count].tower = tower;
+    l.tower[l.count].length = length;
+    l.count++;
+}
+
+static void free_demolist(demo_list &l) {
+    delete[] l.tower;
+    l.tower = NULL;
+    l.count = l.size = 0;
+}
+
+/* true, if the mission in memory is one of version 2 or later */
+static bool is_mission2(const Uint8 *m, Uint32 size) {
+    return (size >= MIS_HEADERSIZE) && !memcmp(m, MIS_MAGIC, 8);
+}
+
+/* scan_mission() for missions of version 2. Everything but the tower
+ * data is checked with the table, the tower data only if blocksok is
+ * given */
+static bool scan_mission2(const Uint8 *m, Uint32 size, Uint16 &towers, Uint32 &index, bool &demo,
+        bool *blocksok, demo_list *demos) {
+
+    towers = 0;
+    demo = false;
+    if (blocksok)
+        *blocksok = true;
+
+    if ((getword(m + 8) != MIS_VERSION) || (getlong(m + 60) != checksum(m, 60)))
+        return false;
+
+    Uint32 n = getlong(m + 44);
+    if ((n > 0xffff) || (n * MIS_ENTRYSIZE > size - MIS_HEADERSIZE)
+            || (getlong(m + 48) != checksum(m + MIS_HEADERSIZE, n * MIS_ENTRYSIZE)))
+        return false;
+
+    towers = n;
+    index = MIS_HEADERSIZE;
+
+    for (Uint32 t = 0; t < n; t++) {
+        const Uint8 *e = m + MIS_HEADERSIZE + t * MIS_ENTRYSIZE;
+        Uint32 pos = getlong(e), len = getlong(e + 4);
+        Uint32 height = getword(e + 12);
+
+        if ((pos % MIS_ALIGN) || (pos > size) || (len > size - pos) || (height > LEV_MAXROWS)
+                || (height * TOWERWID > len))
+            return false;
+
+        if (getlong(e + 20)) {
+            demo = true;
+            if (demos)
+                add_demotower(*demos, t, getlong(e + 20));
+        }
+
+        if (blocksok) {
+            if (checksum(m + pos, len) != getlong(e + 8))
+                return false;
+            if (e[29] >= NUM_TBLOCKS)
+                *blocksok = false;
+        }
+    }
+
+    return true;
+}
+
+/* checks the structure of a mission in memory and finds out the number
+ * of towers, the position of the tower index and if there are demos,
+ * returns false if the mission is damaged. If blocksok is given, it is
+ * set to false when a tower contains unknown blocks. The towers with
+ * a demo are added to demos, if given. This is done
+ * directly on the bytemaps without decoding any of the towers */
+static bool scan_mission(const Uint8 *m, Uint32 size, Uint16 &towers, Uint32 &index, bool &demo,
+        bool *blocksok = NULL, demo_list *demos = NULL) {
+
+    if (is_mission2(m, size))
+        return scan_mission2(m, size, towers, index, demo, blocksok, demos);
+
+    towers = 0;
+    if ((size < 1) || ((Uint32) m[0] + 7 > size))
+        return false;
 
-    char mname[30];
-    Uint8 prio;
+    towers = m[m[0] + 2];
+    demo = false;
+    if (blocksok)
+        *blocksok = true;
 
-    FILE * f = fopen(fname, OPEN_FOR_READING);
+    Uint32 idxpos = getlong(m + m[0] + 3);
+
+    if (idxpos > size)
+        return false;
+
+    index = idxpos;
+
+    if (4 * (Uint32) towers > size - idxpos)
+        return false;
+
+    for (int t = 0; t < towers; t++) {
+        Uint32 pos = getlong(m + idxpos + 4 * t);
+        Uint8 section;
+
+        do {
+            if ((pos > size) || (size - pos < 5))
+                return false;
+
+            section = m[pos];
+            Uint32 len = getlong(m + pos + 1);
+            pos += 5;
+
+            if (len > size - pos)
+                return false;
+
+            if ((section == TSS_DEMO) && (len >= 2) && (m[pos] || m[pos + 1])) {
+                demo = true;
+                if (demos)
+                    add_demotower(*demos, t, getword(m + pos));
+            }
+
+            if ((section == TSS_TOWERDATA) && blocksok) {
+                Uint32 height = len ? m[pos] : 0;
+                Uint32 blocks = 0;
+
+                if (len < 1 + 2 * height)
+                    return false;
+
+                /* the bytemap contains one byte for each bit set in the bitmap */
+                for (Uint32 i = 0; i < 2 * height; i++)
+                    for (Uint8 b = m[pos + 1 + i]; b; b &= b - 1)
+                        blocks++;
+
+                if (len < 1 + 2 * height + blocks)
+                    return false;
+
+                for (Uint32 i = 0; i < blocks; i++)
+                    if (m[pos + 1 + 2 * height + i] >= NUM_TBLOCKS)
+                        *blocksok = false;
+            }
+
+            pos += len;
+        } while (section != TSS_END);
+    }
+
+    return true;
+}
+
+/* a small hash table from strings to indices, used to find missions
+ * with the same name, the index entries for a file name and the tower
+ * for a password */
+typedef struct {
+    int *slot;
+    int size;
+} strtable;
+
+static Uint32 strhash(const char *s) {
+    Uint32 h = 2166136261u;
+    while (*s)
+        h = (h ^ (Uint8) *s++) * 16777619u;
+    return h;
+}
+
+static void st_init(strtable &t, int entries) {
+    t.size = 16;
+    while (t.size < 2 * entries)
+        t.size *= 2;
+    t.slot = new int[t.size];
+    for (int i = 0; i < t.size; i++)
+        t.slot[i] = -1;
+}
+
+static void st_done(strtable &t) {
+    delete[] t.slot;
+    t.slot = NULL;
+}
+
+/* returns the slot for the key, that is either the one containing the
+ * index for the key or the empty one where it belongs. keyof returns
+ * the key for an index */
+static int st_slot(const strtable &t, const char *key, const char *(*keyof)(int)) {
+    Uint32 h = strhash(key) & (t.size - 1);
+
+    while ((t.slot[h] >= 0) && strcmp(keyof(t.slot[h]), key))
+        h = (h + 1) & (t.size - 1);
+
+    return h;
+}
+
+/* returns the index stored for the key or -1 */
+static int st_find(const strtable &t, const char *key, const char *(*keyof)(int)) {
+    return t.slot ? t.slot[st_slot(t, key, keyof)] : -1;
+}
+
+/* stores idx for the key, when the key is not yet in the table and
+ * returns -1, otherwise the index already stored is returned */
+static int st_insert(strtable &t, const char *key, int idx, const char *(*keyof)(int)) {
+    int h = st_slot(t, key, keyof);
+
+    if (t.slot[h] >= 0)
+        return t.slot[h];
+
+    t.slot[h] = idx;
+    return -1;
+}
+
+/* the passwords of all towers of the loaded mission and a table to find
+ * the tower for a password. Both are built once for each mission, the
+ * first time a password is needed */
+static GAME_STATE char (*towerpasswd)[PASSWORD_LEN + 1] = NULL;
+static GAME_STATE strtable passwdtable;
+static GAME_STATE Uint32 passwdgeneration;
+
+static const char *tower_passwd(int i) {
+    return towerpasswd[i];
+}
+
+static void free_passwords(void) {
+    if (passwdtable.slot)
+        st_done(passwdtable);
+    if (towerpasswd)
+        delete[] towerpasswd;
+    towerpasswd = NULL;
+    passwdgeneration = 0;
+}
+
+/* reads the whole file of the mission into memory, returns NULL if the
+ * file can't be read */
+static Uint8 *read_missionfile(Uint16 num, Uint32 &size) {
+    FILE *in = fopen(mfiles[missions[num]].fname, OPEN_FOR_READING);
+    if (!in)
+        return NULL;
+
+    /* find out file size */
+    fseek(in, 0, SEEK_END);
+    size = ftell(in);
+
+    /* get enough memory and load the whole file into memory */
+    Uint8 *data = new Uint8[size ? size : 1];
+    fseek(in, 0, SEEK_SET);
+    if (size && (fread(data, size, 1, in) != 1))
+        size = 0;
+
+    fclose(in);
+    return data;
+}
+
+/* makes the mission in memory the mission of the calling thread, it
+ * takes over the data. valid, towers and index are the results of
+ * scan_mission() */
+static void set_mission(Uint8 *data, Uint32 size, bool valid, Uint16 towers, Uint32 index) {
+    if (mission)
+        delete[] mission;
+    mission = data;
+
+    /* the towers of the old mission are no longer valid */
+    missiongeneration++;
+
+    mission2 = is_mission2(mission, size);
+    missionvalid = valid;
+    missiontowers = towers;
+    missionindex = index;
+}
+
+/* the mission that is loaded in the background. The thread reads and
+ * checks the file, the rest is done by lev_loadmission_finish(). When
+ * no thread can be started the file is read right away */
+static struct {
+    bool pending; // started and not yet finished or dropped
+    SDL_Thread *thread;
+    SDL_mutex *lock;
+    bool done; // the thread has finished
+    Uint16 num;
+    Uint8 *data;
+    Uint32 size;
+    bool valid, blocksok;
+    Uint16 towers;
+    Uint32 index;
+} bgload;
+
+static void bg_read(void) {
+    bool demo;
+
+    bgload.data = read_missionfile(bgload.num, bgload.size);
+    bgload.valid = bgload.data
+            && scan_mission(bgload.data, bgload.size, bgload.towers, bgload.index, demo,
+                    &bgload.blocksok);
+}
+
+static int bg_loader(void *) {
+    bg_read();
+
+    SDL_LockMutex(bgload.lock);
+    bgload.done = true;
+    SDL_UnlockMutex(bgload.lock);
+    return 0;
+}
+
+/* waits for the thread, the loaded mission stays in bgload */
+static void wait_bgload(void) {
+    if (bgload.thread) {
+        SDL_WaitThread(bgload.thread, NULL);
+        SDL_DestroyMutex(bgload.lock);
+        bgload.thread = NULL;
+        bgload.lock = NULL;
+    }
+    bgload.pending = false;
+}
+
+/* forgets the mission of the background load */
+static void drop_bgload(void) {
+    if (!bgload.pending)
+        return;
+
+    wait_bgload();
+    delete[] bgload.data;
+    bgload.data = NULL;
+}
+
+void lev_loadmission_start(Uint16 num) {
+    drop_bgload();
+
+    bgload.num = num;
+    bgload.done = false;
+    bgload.data = NULL;
+    bgload.pending = true;
+    bgload.lock = SDL_CreateMutex();
+    bgload.thread = bgload.lock ? SDL_CreateThread(bg_loader, NULL) : NULL;
+
+    if (!bgload.thread) {
+        if (bgload.lock)
+            SDL_DestroyMutex(bgload.lock);
+        bgload.lock = NULL;
+        bg_read();
+        bgload.done = true;
+    }
+}
+
+bool lev_loadmission_ready(void) {
+    if (!bgload.thread)
+        return true;
+
+    SDL_LockMutex(bgload.lock);
+    bool done = bgload.done;
+    SDL_UnlockMutex(bgload.lock);
+    return done;
+}
+
+bool lev_loadmission_finish(void) {
+    if (!bgload.pending)
+        return false;
+
+    wait_bgload();
+
+    if (!bgload.data)
+        return false;
+
+    set_mission(bgload.data, bgload.size, bgload.valid, bgload.towers, bgload.index);
+    bgload.data = NULL;
+
+    return bgload.valid && bgload.blocksok;
+}
+
+#ifndef CREATOR
+
+/* the mission index file, a list of the scanned directories and a
+ * list of all the mission files found in them with the information
+ * about the mission */
+#define MISSIONINDEX_NAME "missions.idx"
+#define MISSIONINDEX_VERSION 4
+
+typedef struct {
+    char path[MAX_PATH];
+    Uint32 mtime;
+} mission_dir;
+
+/* the contents of the index file from the last start */
+static mission_dir *idx_dirs;
+static int idx_dircount;
+static mission_file *idx_files;
+static int idx_filecount;
+static demo_list idx_demos;
+
+/* the directories of this scan */
+static mission_dir scan_dirs[3];
+static int scan_dircount;
+
+/* true, if the index file must be written again */
+static bool idx_changed;
+
+static const char *idx_fname(int i) {
+    return idx_files[i].fname;
+}
+
+static const char *mission_name(int i) {
+    return mfiles[i].name;
+}
+
+static strtable idx_table;
+
+static int getidxbyte(FILE *f) {
+    int c = fgetc(f);
+    return (c == EOF) ? -1 : c;
+}
+
+static Uint32 getidxlong(FILE *f) {
+    Uint8 b[4];
+    if (fread(b, 4, 1, f) != 1)
+        return 0;
+    return getlong(b);
+}
+
+/* strings have a 16 bit length, so that paths aren't limited by it */
+static bool getidxstring(FILE *f, char *s, int maxlen) {
+    int lo = getidxbyte(f);
+    int hi = getidxbyte(f);
+    int len = lo + (hi << 8);
+    if ((lo < 0) || (hi < 0) || (len >= maxlen) || (len && (fread(s, len, 1, f) != 1)))
+        return false;
+    s[len] = 0;
+    return true;
+}
+
+static void putidxlong(Uint8 *&p, Uint32 v) {
+    *p++ = v;
+    *p++ = v >> 8;
+    *p++ = v >> 16;
+    *p++ = v >> 24;
+}
+
+static void putidxstring(Uint8 *&p, const char *s) {
+    Uint16 len = strlen(s);
+    *p++ = len;
+    *p++ = len >> 8;
+    memcpy(p, s, len);
+    p += len;
+}
+
+static void free_index(void) {
+    delete[] idx_dirs;
+    delete[] idx_files;
+    idx_dirs = NULL;
+    idx_files = NULL;
+    idx_dircount = idx_filecount = 0;
+    free_demolist(idx_demos);
+    if (idx_table.slot)
+        st_done(idx_table);
+}
+
+/* reads the index file, if it is damaged or from another version it
+ * is ignored and all missions are read again */
+static void load_index(void) {
+    char magic[4];
+    bool ok = false;
+
+    free_index();
+
+    FILE *f = open_local_data_file(MISSIONINDEX_NAME);
     if (!f)
         return;
 
-    unsigned char mnamelength;
-    fread(&mnamelength, 1, 1, f);
+    if ((fread(magic, 4, 1, f) == 1) && !strncmp(magic, "TTMI", 4)
+            && (getidxbyte(f) == MISSIONINDEX_VERSION)) {
 
-    if (mnamelength > 29)
-        mnamelength = 29;
+        idx_dircount = getidxbyte(f);
 
-    fread(mname, mnamelength, 1, f);
-    mname[mnamelength] = 0;
-    fread(&prio, 1, 1, f);
+        if (idx_dircount > 0) {
+            idx_dirs = new mission_dir[idx_dircount];
 
-    mission_node * m = missions;
-    mission_node * l = NULL;
+            ok = true;
+            for (int i = 0; ok && (i < idx_dircount); i++) {
+                ok = getidxstring(f, idx_dirs[i].path, MAX_PATH);
+                idx_dirs[i].mtime = getidxlong(f);
+            }
 
-    /* first check if the mission is already there */
-    while (m) {
-        int erg = strcmp(m->name, mname);
-        /* no two missions with the same name */
-        if (erg == 0) {
-            fclose(f);
-            return;
+            idx_filecount = getidxlong(f);
+            if (idx_filecount > 0xffff)
+                ok = false;
+
+            if (ok && idx_filecount) {
+                idx_files = new mission_file[idx_filecount];
+
+                for (int i = 0; ok && (i < idx_filecount); i++) {
+                    mission_file &m = idx_files[i];
+
+                    m.dir = getidxbyte(f);
+                    ok = getidxstring(f, m.fname, MAX_PATH) && getidxstring(f, m.name, 30)
+                            && (m.dir < idx_dircount);
+                    m.prio = getidxbyte(f);
+                    m.mtime = getidxlong(f);
+                    m.size = getidxlong(f);
+                    m.towers = getidxlong(f);
+                    m.demo = getidxbyte(f) == 1;
+
+                    /* the towers with demos */
+                    Uint32 n = getidxlong(f);
+                    ok = ok && (n <= m.towers);
+                    m.demofirst = idx_demos.count;
+                    m.demos = ok ? n : 0;
+                    for (Uint32 d = 0; ok && (d < n); d++) {
+                        Uint32 tower = getidxlong(f);
+                        Uint32 length = getidxlong(f);
+                        ok = tower < m.towers;
+                        add_demotower(idx_demos, tower, length);
+                    }
+                }
+            }
+
+            if (ok)
+                ok = !feof(f) && (getidxbyte(f) == 0xff);
         }
-        l = m;
-        m = m->next;
     }
 
-    m = missions;
-    l = NULL;
+    fclose(f);
+
+    if (!ok) {
+        debugprintf(2, "mission index damaged, reading all missions\n");
+        free_index();
+        return;
+    }
 
-    while (m) {
+    st_init(idx_table, idx_filecount);
+    for (int i = 0; i < idx_filecount; i++)
+        st_insert(idx_table, idx_files[i].fname, i, idx_fname);
+}
 
-        /* we have passed our target, the current mission must
-         * be inserted before this mission
-         */
-        if (m->prio > prio) {
-            mission_node * n = new mission_node;
-            strcpy(n->name, mname);
-            strcpy(n->fname, fname);
-            n->prio = prio;
-            n->next = m;
+/* the index is put together in memory and then replaces the old one,
+ so that a game that is ended while writing doesn't leave half an index */
+static void save_index(void) {
+    Uint32 size = 4 + 1 + 1 + 4 + 1;
 
-            if (l)
-                l->next = n;
-            else
-                missions = n;
+    for (int i = 0; i < scan_dircount; i++)
+        size += 2 + strlen(scan_dirs[i].path) + 4;
+    for (int i = 0; i < mfilecount; i++)
+        size += 1 + 2 + strlen(mfiles[i].fname) + 2 + strlen(mfiles[i].name)
+                + 1 + 3 * 4 + 1 + 4 + mfiles[i].demos * 8;
 
-            fclose(f);
-            return;
+    Uint8 *buf = new Uint8[size];
+    Uint8 *p = buf;
+
+    memcpy(p, "TTMI", 4);
+    p += 4;
+    *p++ = MISSIONINDEX_VERSION;
+
+    *p++ = scan_dircount;
+    for (int i = 0; i < scan_dircount; i++) {
+        putidxstring(p, scan_dirs[i].path);
+        putidxlong(p, scan_dirs[i].mtime);
+    }
+
+    putidxlong(p, mfilecount);
+    for (int i = 0; i < mfilecount; i++) {
+        mission_file &m = mfiles[i];
+
+        *p++ = m.dir;
+        putidxstring(p, m.fname);
+        putidxstring(p, m.name);
+        *p++ = m.prio;
+        putidxlong(p, m.mtime);
+        putidxlong(p, m.size);
+        putidxlong(p, m.towers);
+        *p++ = m.demo ? 1 : 0;
+
+        putidxlong(p, m.demos);
+        for (int d = 0; d < m.demos; d++) {
+            putidxlong(p, mdemos.tower[m.demofirst + d].tower);
+            putidxlong(p, mdemos.tower[m.demofirst + d].length);
         }
-        l = m;
-        m = m->next;
     }
 
-    /* insert at the end */
-    m = new mission_node;
-    strcpy(m->name, mname);
-    strcpy(m->fname, fname);
-    m->prio = prio;
-    m->next = NULL;
+    /* end marker, to find truncated files */
+    *p++ = 0xff;
+
+    assert_msg((Uint32) (p - buf) == size, "Mission index size is wrong.");
+
+    write_local_data_file(MISSIONINDEX_NAME, buf, size);
 
-    if (l)
-        l->next = m;
-    else
-        missions = m;
+    delete[] buf;
+}
+
+/* reads the information about a mission from the file itself */
+static bool read_mission_info(mission_file &m) {
+
+    FILE * f = fopen(m.fname, OPEN_FOR_READING);
+    if (!f)
+        return false;
+
+    Uint8 *data = new Uint8[m.size ? m.size : 1];
+    Uint32 index;
+
+    m.demofirst = mdemos.count;
+    bool ok = (m.size > 0) && (fread(data, m.size, 1, f) == 1)
+            && scan_mission(data, m.size, m.towers, index, m.demo, NULL, &mdemos);
 
     fclose(f);
+
+    /* a damaged mission leaves no towers in the demo list */
+    if (!ok)
+        mdemos.count = m.demofirst;
+    m.demos = mdemos.count - m.demofirst;
+
+    if (ok) {
+        bool v2 = is_mission2(data, m.size);
+        Uint8 mnamelength = v2 ? data[11] : data[0];
+
+        if (mnamelength > 29)
+            mnamelength = 29;
+
+        memcpy(m.name, data + (v2 ? 12 : 1), mnamelength);
+        m.name[mnamelength] = 0;
+        m.prio = v2 ? data[10] : data[data[0] + 1];
+    }
+
+    delete[] data;
+
+    return ok;
 }
 
-#ifndef CREATOR
+/* adds one mission file, the index entry is used, when the file didn't
+ * change since then, otherwise the file is read */
+static void add_mission(char const *fname) {
+    struct stat st;
 
-void lev_findmissions() {
+    if (stat(fname, &st) || !S_ISREG(st.st_mode)) {
+        idx_changed = true;
+        return;
+    }
 
-    char pathname[MAX_PATH];
+    if (mfilecount == mfilesize) {
+        mission_file *n = new mission_file[mfilesize + 50];
+        if (mfilecount)
+            memcpy(n, mfiles, mfilecount * sizeof(mission_file));
+        delete[] mfiles;
+        mfiles = n;
+        mfilesize += 50;
+    }
+
+    mission_file &m = mfiles[mfilecount];
+    int i = st_find(idx_table, fname, idx_fname);
+
+    if ((i >= 0) && (idx_files[i].mtime == (Uint32) st.st_mtime)
+            && (idx_files[i].size == (Uint32) st.st_size)) {
+        m = idx_files[i];
+        m.demofirst = mdemos.count;
+        for (int d = 0; d < m.demos; d++)
+            add_demotower(mdemos, idx_demos.tower[idx_files[i].demofirst + d].tower,
+                    idx_demos.tower[idx_files[i].demofirst + d].length);
+    } else {
+        snprintf(m.fname, sizeof(m.fname), "%s", fname);
+        m.mtime = st.st_mtime;
+        m.size = st.st_size;
+        idx_changed = true;
+
+        if (!read_mission_info(m))
+            return;
+    }
+
+    m.dir = scan_dircount - 1;
+    mfilecount++;
+}
 
+/* adds all missions of one directory. When the directory didn't change
+ * since the last start, the file list from the index is used, so that
+ * the directory doesn't need to be read and sorted */
+static void add_missiondir(const char *pathname) {
+    struct stat st;
     struct dirent **eps = NULL;
 
+    if (stat(pathname, &st) || (scan_dircount >= SIZE(scan_dirs))
+            || (strlen(pathname) >= MAX_PATH))
+        return;
+
+    mission_dir &d = scan_dirs[scan_dircount++];
+    snprintf(d.path, sizeof(d.path), "%s", pathname);
+    d.mtime = st.st_mtime;
+
+    for (int i = 0; i < idx_dircount; i++)
+        if (!strcmp(idx_dirs[i].path, pathname)) {
+            if (idx_dirs[i].mtime != d.mtime)
+                break;
+
+            for (int j = 0; j < idx_filecount; j++)
+                if (idx_files[j].dir == i)
+                    add_mission(idx_files[j].fname);
+            return;
+        }
+
+    idx_changed = true;
+
+    int n = alpha_scandir(pathname, &eps, missionfiles);
+    if (n >= 0) {
+        for (int i = 0; i < n; i++) {
+            char fname[MAX_PATH];
+
+            /* a cut off name would be another file */
+            if ((size_t) snprintf(fname, sizeof(fname), "%s%s", pathname, eps[i]->d_name)
+                    < sizeof(fname))
+                add_mission(fname);
+            free(eps[i]);
+        }
+    }
+    free(eps);
+}
+
+static int sort_by_prio(const void *a, const void *b) {
+    const Uint16 ia = *(const Uint16 *) a;
+    const Uint16 ib = *(const Uint16 *) b;
+
+    /* missions with the same prio stay in the order they were found */
+    if (mfiles[ia].prio != mfiles[ib].prio)
+        return (int) mfiles[ia].prio - (int) mfiles[ib].prio;
+    return (int) ia - (int) ib;
+}
+
+static void free_missions(void) {
+    drop_bgload();
+    delete[] mfiles;
+    delete[] missions;
+    delete[] demoindex;
+    mfiles = NULL;
     missions = NULL;
+    demoindex = NULL;
+    mfilecount = mfilesize = missioncount = 0;
+    demoindexcount = 0;
+    free_demolist(mdemos);
+}
+
+void lev_findmissions() {
+
+    char pathname[MAX_PATH];
 
     /* check if already called, if so free the old list */
-    while (missions) {
-        mission_node *n = missions;
-        missions = missions->next;
-        delete n;
-    }
+    free_missions();
+
+    load_index();
+    scan_dircount = 0;
+    idx_changed = false;
 
 #ifdef WIN32
     {
@@ -247,144 +1513,281 @@ void lev_findmissions() {
     sprintf(pathname, "%s", "./");
 #endif
 #endif
-    int n = alpha_scandir(pathname, &eps, missionfiles);
-    if (n >= 0) {
-        for (int i = 0; i < n; i++) {
-            char fname[MAX_PATH];
-            sprintf(fname, "%s%s", pathname, eps[i]->d_name);
-            add_mission(fname);
-            free(eps[i]);
-        }
-    }
-    free(eps);
-    eps = NULL;
+    add_missiondir(pathname);
 #ifdef __BLACKBERRY__
 #else
 #ifndef WIN32
     snprintf(pathname, sizeof(pathname), "%s/.toppler/", getenv("HOME"));
-    n = alpha_scandir(pathname, &eps, missionfiles);
+    add_missiondir(pathname);
 
-    if (n >= 0) {
+    snprintf(pathname, sizeof(pathname), "%s/", TOP_DATADIR);
+    add_missiondir(pathname);
+#endif
+#endif
 
-        for (int i = 0; i < n; i++) {
+    if (idx_changed || (scan_dircount != idx_dircount))
+        save_index();
 
-            char fname[MAX_PATH];
-            snprintf(fname, sizeof(fname), "%s%s", pathname, eps[i]->d_name);
+    free_index();
 
-            add_mission(fname);
-        }
-    }
-    free(eps);
-    eps = NULL;
+    /* no two missions with the same name, the first one found is used */
+    strtable names;
+    st_init(names, mfilecount);
 
-    snprintf(pathname, sizeof(pathname), "%s/", TOP_DATADIR);
-    n = alpha_scandir(pathname, &eps, missionfiles);
+    missions = new Uint16[mfilecount + 1];
+    for (int i = 0; i < mfilecount; i++)
+        if (st_insert(names, mfiles[i].name, i, mission_name) < 0)
+            missions[missioncount++] = i;
 
-    if (n >= 0) {
+    st_done(names);
 
-        for (int i = 0; i < n; i++) {
+    qsort(missions, missioncount, sizeof(Uint16), sort_by_prio);
 
-            char fname[MAX_PATH];
-            snprintf(fname, sizeof(fname), "%s%s", pathname, eps[i]->d_name);
+    /* the demo index, in the order of the missions */
+    for (int i = 0; i < missioncount; i++)
+        demoindexcount += mfiles[missions[i]].demos;
+
+    demoindex = new lev_demoinfo[demoindexcount + 1];
+    demoindexcount = 0;
+    for (int i = 0; i < missioncount; i++) {
+        mission_file &m = mfiles[missions[i]];
 
-            add_mission(fname);
+        for (int d = 0; d < m.demos; d++) {
+            lev_demoinfo &e = demoindex[demoindexcount++];
+
+            e.mission = i;
+            e.tower = mdemos.tower[m.demofirst + d].tower;
+            e.length = mdemos.tower[m.demofirst + d].length;
         }
     }
-    free(eps);
-    eps = NULL;
-
-#endif
-#endif
 }
 
 #endif
 
-void lev_done() {
+void lev_donethread() {
     if (mission) {
         delete[] mission;
         mission = NULL;
     }
 
-    mission_node * m = missions;
+    free_towercache();
+    free_passwords();
+    free_chunks();
+    dem_freepool();
 
-    while (m) {
-        m = m->next;
-        delete missions;
-        missions = m;
-    }
+    if (changedrows)
+        delete[] changedrows;
+    changedrows = NULL;
+    changedcount = changedsize = 0;
 
-    if (towerdemo)
-        delete[] towerdemo;
+#ifdef __BLACKBERRY__
+#else
+    free_check();
+
+    if (dirtyrows)
+        delete[] dirtyrows;
+    dirtyrows = NULL;
+    dirtycount = dirtysize = 0;
+#endif
+
+    lev_set_towerdemo(0, NULL);
 }
 
-Uint16 lev_missionnumber() {
-    int num = 0;
-    mission_node * m = missions;
+void lev_done() {
+    lev_donethread();
 
-    while (m) {
-        num++;
-        m = m->next;
-    }
+#ifndef CREATOR
+    free_missions();
+#endif
+}
 
-    return num;
+Uint16 lev_missionnumber() {
+    return missioncount;
 }
 
 const char * lev_missionname(Uint16 num) {
-    mission_node * m = missions;
+    return mfiles[missions[num]].name;
+}
 
-    while (num) {
-        m = m->next;
-        num--;
-    }
+Uint16 lev_missiontowers(Uint16 num) {
+    return mfiles[missions[num]].towers;
+}
+
+bool lev_missiondemo(Uint16 num) {
+    return mfiles[missions[num]].demo;
+}
 
-    return m->name;
+Uint32 lev_democount(void) {
+    return demoindexcount;
+}
+
+const lev_demoinfo &lev_demo(Uint32 num) {
+    return demoindex[num];
 }
 
 bool lev_loadmission(Uint16 num) {
 
-    mission_node *m = missions;
-    while (num) {
-        num--;
-        m = m->next;
-    }
+    /* a mission loaded in the background is no longer wanted */
+    drop_bgload();
 
-    FILE * in = fopen(m->fname, OPEN_FOR_READING);
-    if(!in)
+    Uint32 size;
+    Uint8 *data = read_missionfile(num, size);
+    if (!data)
         return false;
 
-    if (mission)
-        delete[] mission;
+    bool demo, blocksok;
+    Uint16 towers;
+    Uint32 index;
+    bool valid = scan_mission(data, size, towers, index, demo, &blocksok);
 
-    /* find out file size */
-    fseek(in, 0, SEEK_END);
-    int fsize = ftell(in);
+    set_mission(data, size, valid, towers, index);
 
-    /* get enough memory and load the whole file into memory */
-    mission = new unsigned char[fsize];
-    fseek(in, 0, SEEK_SET);
-    fread(mission, fsize, 1, in);
+    return valid && blocksok;
+}
 
-    fclose(in);
+Uint16 lev_towercount(void) {
+    return missiontowers;
+}
 
-    for (int t = 0; t < lev_towercount(); t++) {
-        lev_selecttower(t);
-        for (int r = 0; r < towerheight; r++)
-            for (int c = 0; c < TOWERWID; c++)
-                if (tower[r][c] >= NUM_TBLOCKS)
-                    return false;
+/* decodes the block data of a tower from the section starting at pos
+ * in the mission, returns the blocks, 16 for each row, and the height */
+static Uint8 *decode_blocks(Uint32 pos, Uint16 &height) {
+    height = mission[pos];
+
+    Uint32 bitstart = pos + 1;
+    Uint32 bytestart = bitstart + 2 * height;
+    Uint32 wpos = 0;
+    Uint32 bpos = 0;
+    Uint8 *buf = new Uint8[(height ? height : 1) * TOWERWID];
+
+    memset(buf, TB_EMPTY, height * TOWERWID);
+
+    for (Uint32 i = 0; i < (Uint32) height * TOWERWID; i++) {
+        if ((mission[bitstart + (bpos >> 3)] << (bpos & 7)) & 0x80)
+            buf[i] = mission[bytestart + wpos++];
+        bpos++;
     }
 
-    return true;
+    return buf;
 }
 
-Uint8 lev_towercount(void) {
-    return mission[mission[0] + 2];
+/* makes the packed demo the demo of the tower, the tower takes over
+ * the data */
+static void set_packeddemo(Uint8 *data, Uint32 size, Uint32 seed) {
+    if (towerdemo)
+        delete[] towerdemo;
+    towerdemo = data;
+    towerdemo_size = data ? size : 0;
+    towerdemo_len = dem_length(data, towerdemo_size);
+    towerdemo_seed = seed;
+}
+
+/* returns the position of the first section of a tower in the mission */
+static Uint32 tower_start(Uint16 number) {
+    return getlong(mission + missionindex + 4 * number);
+}
+
+/* returns the entry of a tower in the table of a version 2 mission */
+static const Uint8 *tower_entry(Uint16 number) {
+    return mission + missionindex + number * MIS_ENTRYSIZE;
 }
 
-void lev_selecttower(Uint8 number) {
+/* decode_tower() for missions of version 2, the blocks are used as
+ * they are and only the demo needs to be unpacked */
+static void decode_tower2(Uint16 number) {
+    const Uint8 *e = tower_entry(number);
+    const Uint8 *data = mission + getlong(e);
+    Uint32 len = getlong(e + 4);
+    Uint32 keys = getlong(e + 20);
+
+    towernumber = number;
+    towerheight = getword(e + 12);
+    towertime = getword(e + 14);
+    towerrobot = e[16];
+#ifndef CREATOR
+    /* the simulation runs without graphics and robot sprites */
+    if (scr_numrobots())
+        towerrobot %= scr_numrobots();
+#endif
+    towercolor_red = e[17];
+    towercolor_green = e[18];
+    towercolor_blue = e[19];
+    memcpy(towername, e + 40, TOWERNAMELEN);
+    towername[TOWERNAMELEN] = 0;
+
+    put_rows(data, towerheight);
+
+    lev_set_towerdemo(0, NULL);
+
+    Uint32 blocksize = (Uint32) towerheight * TOWERWID;
+    const Uint8 *demo = data + blocksize;
+    Uint32 demosize = len - blocksize;
+
+    if (!keys)
+        return;
+
+    /* each run of the packed form is at least one tick long, so it
+     * never needs more bytes than the demo has ticks, and it must
+     * contain exactly the number of ticks of the table. Demos with
+     * unknown codecs are ignored */
+    switch (e[28]) {
+    case MIS_DEMO_DEFLATED: {
+        /* deflate doesn't pack the 16 bit keys better than about
+         * 1000:1, so longer demos are broken */
+        if (keys / 512 > demosize)
+            break;
+
+        uLongf rawsize = keys * 2;
+        Uint8 *raw = new Uint8[rawsize];
+
+        if ((uncompress(raw, &rawsize, demo, demosize) == Z_OK) && (rawsize == keys * 2)) {
+            dem_packer p;
+            int len;
+
+            dem_pack_start(p);
+            for (Uint32 i = 0; i < keys; i++)
+                dem_pack(p, getword(raw + 2 * i));
+
+            Uint8 *packed = dem_pack_finish(p, demosize, len);
+            set_packeddemo(packed, demosize, getlong(e + 24));
+        }
+        delete[] raw;
+        break;
+    }
+    case MIS_DEMO_PACKED:
+        if ((demosize <= keys) && ((Uint32) dem_length(demo, demosize) == keys)) {
+            Uint8 *packed = new Uint8[demosize];
+
+            memcpy(packed, demo, demosize);
+            set_packeddemo(packed, demosize, getlong(e + 24));
+        }
+        break;
+    case MIS_DEMO_PACKED_DEFLATED: {
+        uLongf packedsize = keys;
+        Uint8 *packed = new Uint8[packedsize];
+
+        if ((uncompress(packed, &packedsize, demo, demosize) == Z_OK)
+                && ((Uint32) dem_length(packed, packedsize) == keys))
+            set_packeddemo(packed, packedsize, getlong(e + 24));
+        else
+            delete[] packed;
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+/* decodes the tower from the mission into the tower variables */
+static void decode_tower(Uint16 number) {
 
     Uint32 towerstart;
 
+    if (mission2) {
+        decode_tower2(number);
+        return;
+    }
+
     towernumber = number;
     towerrobot = number;
     Uint8 section;
@@ -393,19 +1796,7 @@ void lev_selecttower(Uint8 number) {
     lev_set_towerdemo(0, NULL);
 
     // find start of towerdata in mission
-    {
-        Uint32 idxpos = 0;
-
-        idxpos += mission[mission[0] + 3];
-        idxpos += long(mission[mission[0] + 4]) << 8;
-        idxpos += long(mission[mission[0] + 5]) << 16;
-        idxpos += long(mission[mission[0] + 6]) << 24;
-
-        towerstart = mission[idxpos + 4 * number];
-        towerstart += long(mission[idxpos + 4 * number + 1]) << 8;
-        towerstart += long(mission[idxpos + 4 * number + 2]) << 16;
-        towerstart += long(mission[idxpos + 4 * number + 3]) << 24;
-    }
+    towerstart = tower_start(number);
 
     do {
         section = mission[towerstart++];
@@ -427,55 +1818,46 @@ void lev_selecttower(Uint8 number) {
             towercolor_blue = mission[towerstart + 2];
             break;
         case TSS_TOWERDATA: {
-            towerheight = mission[towerstart];
-
-            Uint32 bitstart = towerstart + 1;
-            Uint32 bytestart = bitstart + 2 * towerheight;
-            Uint16 wpos = 0;
-            Uint16 bpos = 0;
-
-            lev_clear_tower();
-
-            for (Uint8 row = 0; row < towerheight; row++) {
-                for (Uint8 col = 0; col < TOWERWID; col++) {
-                    if ((mission[bitstart + (bpos >> 3)] << (bpos & 7)) & 0x80)
-                        tower[row][col] = mission[bytestart + wpos++];
-                    else
-                        tower[row][col] = 0;
-                    bpos++;
-                }
-            }
+            Uint8 *blocks = decode_blocks(towerstart, towerheight);
+            put_rows(blocks, towerheight);
+            delete[] blocks;
             break;
         }
         case TSS_DEMO: {
-            // get tower demo
-            Uint16 *tmpbuf = NULL;
-            Uint16 tmpbuf_len = mission[towerstart];
-            tmpbuf_len += Uint16(mission[towerstart + 1]) << 8;
-            Uint16 ofs = 2;
-
-            if (tmpbuf_len) {
-                tmpbuf = new Uint16[tmpbuf_len];
-                Uint16 idx = 0;
-                while (idx < tmpbuf_len) {
-                    Uint8 run = mission[towerstart + ofs++];
-                    Uint16 data = mission[towerstart + ofs++];
-                    data += Uint16(mission[towerstart + ofs++]) << 8;
-
-                    while (run) {
-                        tmpbuf[idx++] = data;
-                        run--;
-                    }
-                }
+            // get tower demo, the runs go directly into the packed form
+            dem_packer p;
+            Uint16 demo_len = mission[towerstart];
+            demo_len += Uint16(mission[towerstart + 1]) << 8;
+            Uint32 ofs = 2;
+            Uint32 seed = 0;
+
+            dem_pack_start(p);
+            while ((p.len < demo_len) && (ofs + 3 <= section_len)) {
+                Uint8 run = mission[towerstart + ofs++];
+                Uint16 data = mission[towerstart + ofs++];
+                data += Uint16(mission[towerstart + ofs++]) << 8;
+
+                dem_pack(p, data, run);
             }
 
-            lev_set_towerdemo(tmpbuf_len, tmpbuf);
+            /* newer demos have the seed of the game after the keys */
+            if (ofs + 4 <= section_len)
+                seed = mission[towerstart + ofs] + (Uint32(mission[towerstart + ofs + 1]) << 8)
+                        + (Uint32(mission[towerstart + ofs + 2]) << 16)
+                        + (Uint32(mission[towerstart + ofs + 3]) << 24);
+
+            Uint32 size;
+            int len;
+            Uint8 *packed = dem_pack_finish(p, size, len);
+            set_packeddemo(packed, size, seed);
             break;
         }
         case TSS_ROBOT:
             towerrobot = mission[towerstart];
 #ifndef CREATOR
-            towerrobot %= scr_numrobots();
+            /* the simulation runs without graphics and robot sprites */
+            if (scr_numrobots())
+                towerrobot %= scr_numrobots();
 #endif
             break;
         case TSS_END:
@@ -486,9 +1868,78 @@ void lev_selecttower(Uint8 number) {
     } while ((towersection) section != TSS_END);
 }
 
+
+void lev_selecttower(Uint16 number) {
+    int t, oldest = 0;
+
+    towercache_clock++;
+    towerfrommission = true;
+
+    for (t = 0; t < TOWERCACHE_SIZE; t++) {
+        if ((towercache[t].generation == missiongeneration) && (towercache[t].number == number))
+            break;
+        if (towercache[t].lastuse < towercache[oldest].lastuse)
+            oldest = t;
+    }
+
+    if (t < TOWERCACHE_SIZE) {
+        Uint8 *demo = NULL;
+
+        towernumber = number;
+        towerheight = towercache[t].height;
+        towerrobot = towercache[t].robot;
+        towercolor_red = towercache[t].red;
+        towercolor_green = towercache[t].green;
+        towercolor_blue = towercache[t].blue;
+        towertime = towercache[t].time;
+        memcpy(towername, towercache[t].name, sizeof(towername));
+
+        /* the rows above the tower must be empty, as in a decoded tower */
+        put_rows(towercache[t].data, towerheight);
+
+        if (towercache[t].demo_size) {
+            demo = new Uint8[towercache[t].demo_size];
+            memcpy(demo, towercache[t].demo, towercache[t].demo_size);
+        }
+        set_packeddemo(demo, towercache[t].demo_size, towercache[t].demo_seed);
+
+        towercache[t].lastuse = towercache_clock;
+        return;
+    }
+
+    decode_tower(number);
+
+    t = oldest;
+    if (towercache[t].demo)
+        delete[] towercache[t].demo;
+    if (towercache[t].data)
+        delete[] towercache[t].data;
+
+    towercache[t].generation = missiongeneration;
+    towercache[t].lastuse = towercache_clock;
+    towercache[t].number = number;
+    towercache[t].height = towerheight;
+    towercache[t].robot = towerrobot;
+    towercache[t].red = towercolor_red;
+    towercache[t].green = towercolor_green;
+    towercache[t].blue = towercolor_blue;
+    towercache[t].time = towertime;
+    memcpy(towercache[t].name, towername, sizeof(towername));
+    towercache[t].data = new Uint8[(towerheight ? towerheight : 1) * TOWERWID];
+    get_rows(towercache[t].data, 0, towerheight);
+    towercache[t].demo = NULL;
+    towercache[t].demo_size = towerdemo_size;
+    towercache[t].demo_len = towerdemo_len;
+    towercache[t].demo_seed = towerdemo_seed;
+    if (towerdemo_size) {
+        towercache[t].demo = new Uint8[towerdemo_size];
+        memcpy(towercache[t].demo, towerdemo, towerdemo_size);
+    }
+}
+
 static char *
 gen_passwd(int pwlen, char const *allowed, int buflen, char *buf) {
-    static char passwd[PASSWORD_LEN + 1];
+    static GAME_STATE char passwd[PASSWORD_LEN + 1];
     int len = buflen;
     int alen;
     int i;
@@ -520,8 +1971,85 @@ gen_passwd(int pwlen, char const *allowed, int buflen, char *buf) {
     return passwd;
 }
 
+/* the password for the blocks of a tower. The rows up to 256 are always
+ * used, so that the towers up to this height keep their passwords */
+static const char *blocks_passwd(const Uint8 *blocks, int height) {
+    int rows = (height > 256) ? height : 256;
+    Uint8 *buf = new Uint8[rows * TOWERWID];
+
+    memset(buf, TB_EMPTY, rows * TOWERWID);
+    if (height)
+        memcpy(buf, blocks, height * TOWERWID);
+
+    const char *passwd = gen_passwd(PASSWORD_LEN, PASSWORD_CHARS, rows * TOWERWID, (char *) buf);
+    delete[] buf;
+
+    return passwd;
+}
+
+static void build_passwords(void) {
+    if (passwdgeneration == missiongeneration)
+        return;
+
+    free_passwords();
+    passwdgeneration = missiongeneration;
+
+    if (!missionvalid)
+        return;
+
+    /* only the blocks of the towers are needed, so the towers are not
+     * selected, this would also decode names, demos and so on */
+    st_init(passwdtable, lev_towercount());
+    towerpasswd = new char[lev_towercount() ? lev_towercount() : 1][PASSWORD_LEN + 1];
+
+    for (int t = 0; t < lev_towercount(); t++) {
+        if (mission2) {
+            /* version 2 missions contain the passwords */
+            memcpy(towerpasswd[t], tower_entry(t) + 32, PASSWORD_LEN);
+            towerpasswd[t][PASSWORD_LEN] = 0;
+            st_insert(passwdtable, towerpasswd[t], t, tower_passwd);
+            continue;
+        }
+
+        Uint32 pos = tower_start(t);
+        Uint8 section;
+        Uint8 *blocks = NULL;
+        Uint16 height = 0;
+
+        do {
+            section = mission[pos];
+            if (section == TSS_TOWERDATA) {
+                if (blocks)
+                    delete[] blocks;
+                blocks = decode_blocks(pos + 5, height);
+            }
+            pos += 5 + getlong(mission + pos + 1);
+        } while (section != TSS_END);
+
+        strcpy(towerpasswd[t], blocks_passwd(blocks, height));
+        if (blocks)
+            delete[] blocks;
+
+        /* when two towers have the same password, the first one is used */
+        st_insert(passwdtable, towerpasswd[t], t, tower_passwd);
+    }
+}
+
 const char *lev_get_passwd(void) {
-    return gen_passwd(PASSWORD_LEN, PASSWORD_CHARS, 256 * TOWERWID, (char *) tower);
+    if (towerfrommission) {
+        build_passwords();
+        if (passwdtable.slot)
+            return towerpasswd[towernumber];
+    }
+
+    int rows = (towerheight > 256) ? towerheight : 256;
+    Uint8 *blocks = new Uint8[rows * TOWERWID];
+
+    get_rows(blocks, 0, rows);
+    const char *passwd = blocks_passwd(blocks, rows);
+    delete[] blocks;
+
+    return passwd;
 }
 
 bool lev_show_passwd(int levnum) {
@@ -529,19 +2057,17 @@ bool lev_show_passwd(int levnum) {
 }
 
 int lev_tower_passwd_entry(const char *passwd) {
-    int i;
     if (!passwd)
         return 0;
-    for (i = 0; i < lev_towercount(); i++) {
-        lev_selecttower(i);
-        if (!strcmp(passwd, lev_get_passwd()))
-            return i;
-    }
-    return 0;
+
+    build_passwords();
+
+    int i = st_find(passwdtable, passwd, tower_passwd);
+    return (i >= 0) ? i : 0;
 }
 
 void lev_clear_tower(void) {
-    memset(&tower, TB_EMPTY, 256 * TOWERWID);
+    put_rows(NULL, 0);
 }
 
 void lev_set_towercol(Uint8 r, Uint8 g, Uint8 b) {
@@ -563,16 +2089,16 @@ Uint8 lev_towercol_blue() {
 }
 
 Uint8 lev_tower(Uint16 row, Uint8 column) {
-    return tower[row][column];
+    return block_at(row, column);
 }
 
 Uint8 lev_set_tower(Uint16 row, Uint8 column, Uint8 block) {
-    Uint8 tmp = tower[row][column];
-    tower[row][column] = block;
+    Uint8 tmp = block_at(row, column);
+    set_block(row, column, block);
     return tmp;
 }
 
-Uint8 lev_towerrows(void) {
+Uint16 lev_towerrows(void) {
     return towerheight;
 }
 
@@ -580,24 +2106,45 @@ char * lev_towername(void) {
     return towername;
 }
 
-void lev_set_towerdemo(int demolen, Uint16 *demobuf) {
-    if (towerdemo)
-        delete[] towerdemo;
-    towerdemo = demobuf;
-    towerdemo_len = demolen;
+void lev_set_towerdemo(int demolen, Uint16 *demobuf, Uint32 seed) {
+    dem_packer p;
+    Uint32 size;
+    int len;
+
+    dem_pack_start(p);
+    if (demobuf) {
+        for (int i = 0; i < demolen; i++)
+            dem_pack(p, demobuf[i]);
+        delete[] demobuf;
+    }
+
+    Uint8 *packed = dem_pack_finish(p, size, len);
+    set_packeddemo(packed, size, seed);
 }
 
-void lev_get_towerdemo(int &demolen, Uint16 *&demobuf) {
-    demobuf = towerdemo;
+void lev_set_towerdemo(dem_packer &demo, Uint32 seed) {
+    Uint32 size;
+    int len;
+
+    Uint8 *packed = dem_pack_finish(demo, size, len);
+    set_packeddemo(packed, size, seed);
+}
+
+void lev_get_towerdemo(int &demolen, dem_stream &demo) {
+    dem_start(demo, towerdemo, towerdemo_size);
     demolen = towerdemo_len;
 }
 
+Uint32 lev_towerdemoseed(void) {
+    return towerdemo_seed;
+}
+
 void lev_set_towername(const char *str) {
     (void) strncpy(towername, str, TOWERNAMELEN);
     towername[TOWERNAMELEN] = '\0';
 }
 
-Uint8 lev_towernr(void) {
+Uint16 lev_towernr(void) {
     return towernumber;
 }
 
@@ -621,10 +2168,10 @@ void lev_set_towertime(Uint16 time) {
     towertime = time;
 }
 
-void lev_removelayer(Uint8 layer) {
+void lev_removelayer(int layer) {
     while (layer < towerheight) {
         for (Uint8 c = 0; c < TOWERWID; c++)
-            tower[layer][c] = tower[layer + 1][c];
+            set_block(layer, c, block_at(layer + 1, c));
         layer++;
     }
 
@@ -633,13 +2180,13 @@ void lev_removelayer(Uint8 layer) {
 
 /* empties a cell in the tower */
 void lev_clear(int row, int col) {
-    tower[row][col] = TB_EMPTY;
+    set_block(row, col, TB_EMPTY);
 }
 
 /* if the given position contains a vanishing step, remove it */
 void lev_removevanishstep(int row, int col) {
-    if (tower[row][col] == TB_STEP_VANISHER)
-        tower[row][col] = TB_EMPTY;
+    if (block_at(row, col) == TB_STEP_VANISHER)
+        set_block(row, col, TB_EMPTY);
 }
 
 /********** everything for doors ********/
@@ -652,127 +2199,130 @@ bool lev_is_door_upperend(int row, int col) {
 
 /* returns true if the given position contains a door */
 bool lev_is_door(int row, int col) {
-    return (tower[row][col] == TB_DOOR || tower[row][col] == TB_DOOR_TARGET
-            || tower[row][col] == TB_STICK_DOOR);
+    return ((towerblockdata[block_at(row, col)].tf & TBF_DOOR) != 0);
 }
 
 /* returns true, if the given fiels contains a target door */
 bool lev_is_targetdoor(int row, int col) {
-    return tower[row][col] == TB_DOOR_TARGET;
+    return block_at(row, col) == TB_DOOR_TARGET;
 }
 
 /**************** everything for elevators ******************/
 
 bool lev_is_station(int row, int col) {
-    return ((towerblockdata[tower[row][col]].tf & TBF_STATION) != 0);
+    return ((towerblockdata[block_at(row, col)].tf & TBF_STATION) != 0);
 }
 bool lev_is_up_station(int row, int col) {
-    return ((tower[row][col] == TB_ELEV_BOTTOM) || (tower[row][col] == TB_ELEV_MIDDLE));
+    return ((block_at(row, col) == TB_ELEV_BOTTOM) || (block_at(row, col) == TB_ELEV_MIDDLE));
 }
 bool lev_is_down_station(int row, int col) {
-    return ((tower[row][col] == TB_ELEV_TOP) || (tower[row][col] == TB_ELEV_MIDDLE));
+    return ((block_at(row, col) == TB_ELEV_TOP) || (block_at(row, col) == TB_ELEV_MIDDLE));
 }
 bool lev_is_bottom_station(int row, int col) {
-    return (tower[row][col] == TB_ELEV_BOTTOM);
+    return (block_at(row, col) == TB_ELEV_BOTTOM);
 }
 
 bool lev_is_platform(int row, int col) {
-    return ((towerblockdata[tower[row][col]].tf & TBF_PLATFORM) != 0);
+    return ((towerblockdata[block_at(row, col)].tf & TBF_PLATFORM) != 0);
 }
 bool lev_is_stick(int row, int col) {
-    return ((tower[row][col] == TB_STICK) || (tower[row][col] == TB_STICK_TOP)
-            || (tower[row][col] == TB_STICK_MIDDLE) || (tower[row][col] == TB_STICK_BOTTOM)
-            || (tower[row][col] == TB_STICK_DOOR) || (tower[row][col] == TB_STICK_DOOR_TARGET));
+    return ((towerblockdata[block_at(row, col)].tf & TBF_STICK) != 0);
 }
 
 bool lev_is_elevator(int row, int col) {
-    return ((tower[row][col] == TB_STICK_BOTTOM) || (tower[row][col] == TB_STICK_MIDDLE)
-            || (tower[row][col] == TB_STICK_TOP) || (tower[row][col] == TB_ELEV_BOTTOM)
-            || (tower[row][col] == TB_ELEV_MIDDLE) || (tower[row][col] == TB_ELEV_TOP));
+    return ((towerblockdata[block_at(row, col)].tf & TBF_ELEVATOR) != 0);
 }
 
 void lev_platform2stick(int row, int col) {
-    if (tower[row][col] == TB_ELEV_TOP)
-        tower[row][col] = TB_STICK_TOP;
-    else if (tower[row][col] == TB_ELEV_MIDDLE)
-        tower[row][col] = TB_STICK_MIDDLE;
-    else if (tower[row][col] == TB_ELEV_BOTTOM)
-        tower[row][col] = TB_STICK_BOTTOM;
-    else if (tower[row][col] == TB_STEP)
-        tower[row][col] = TB_STICK;
+    if (block_at(row, col) == TB_ELEV_TOP)
+        set_block(row, col, TB_STICK_TOP);
+    else if (block_at(row, col) == TB_ELEV_MIDDLE)
+        set_block(row, col, TB_STICK_MIDDLE);
+    else if (block_at(row, col) == TB_ELEV_BOTTOM)
+        set_block(row, col, TB_STICK_BOTTOM);
+    else if (block_at(row, col) == TB_STEP)
+        set_block(row, col, TB_STICK);
 }
 void lev_stick2platform(int row, int col) {
-    if (tower[row][col] == TB_STICK_TOP)
-        tower[row][col] = TB_ELEV_TOP;
-    else if (tower[row][col] == TB_STICK_MIDDLE)
-        tower[row][col] = TB_ELEV_MIDDLE;
-    else if (tower[row][col] == TB_STICK_BOTTOM)
-        tower[row][col] = TB_ELEV_BOTTOM;
-    else if (tower[row][col] == TB_STICK_DOOR)
-        tower[row][col] = TB_ELEV_DOOR;
-    else if (tower[row][col] == TB_STICK_DOOR_TARGET)
-        tower[row][col] = TB_ELEV_DOOR_TARGET;
-    else if (tower[row][col] == TB_STICK)
-        tower[row][col] = TB_STEP;
+    if (block_at(row, col) == TB_STICK_TOP)
+        set_block(row, col, TB_ELEV_TOP);
+    else if (block_at(row, col) == TB_STICK_MIDDLE)
+        set_block(row, col, TB_ELEV_MIDDLE);
+    else if (block_at(row, col) == TB_STICK_BOTTOM)
+        set_block(row, col, TB_ELEV_BOTTOM);
+    else if (block_at(row, col) == TB_STICK_DOOR)
+        set_block(row, col, TB_ELEV_DOOR);
+    else if (block_at(row, col) == TB_STICK_DOOR_TARGET)
+        set_block(row, col, TB_ELEV_DOOR_TARGET);
+    else if (block_at(row, col) == TB_STICK)
+        set_block(row, col, TB_STEP);
 }
 void lev_stick2empty(int row, int col) {
-    if (tower[row][col] == TB_STICK_TOP)
-        tower[row][col] = TB_STATION_TOP;
-    else if (tower[row][col] == TB_STICK_MIDDLE)
-        tower[row][col] = TB_STATION_MIDDLE;
-    else if (tower[row][col] == TB_STICK_BOTTOM)
-        tower[row][col] = TB_STATION_BOTTOM;
-    else if (tower[row][col] == TB_STICK_DOOR_TARGET)
-        tower[row][col] = TB_DOOR_TARGET;
-    else if (tower[row][col] == TB_STICK_DOOR)
-        tower[row][col] = TB_DOOR;
-    else if (tower[row][col] == TB_STICK)
-        tower[row][col] = TB_EMPTY;
+    if (block_at(row, col) == TB_STICK_TOP)
+        set_block(row, col, TB_STATION_TOP);
+    else if (block_at(row, col) == TB_STICK_MIDDLE)
+        set_block(row, col, TB_STATION_MIDDLE);
+    else if (block_at(row, col) == TB_STICK_BOTTOM)
+        set_block(row, col, TB_STATION_BOTTOM);
+    else if (block_at(row, col) == TB_STICK_DOOR_TARGET)
+        set_block(row, col, TB_DOOR_TARGET);
+    else if (block_at(row, col) == TB_STICK_DOOR)
+        set_block(row, col, TB_DOOR);
+    else if (block_at(row, col) == TB_STICK)
+        set_block(row, col, TB_EMPTY);
 }
 void lev_empty2stick(int row, int col) {
-    if (tower[row][col] == TB_STATION_TOP)
-        tower[row][col] = TB_STICK_TOP;
-    else if (tower[row][col] == TB_STATION_MIDDLE)
-        tower[row][col] = TB_STICK_MIDDLE;
-    else if (tower[row][col] == TB_STATION_BOTTOM)
-        tower[row][col] = TB_STICK_BOTTOM;
-    else if (tower[row][col] == TB_DOOR)
-        tower[row][col] = TB_STICK_DOOR;
-    else if (tower[row][col] == TB_DOOR_TARGET)
-        tower[row][col] = TB_STICK_DOOR_TARGET;
-    else if (tower[row][col] == TB_EMPTY)
-        tower[row][col] = TB_STICK;
+    if (block_at(row, col) == TB_STATION_TOP)
+        set_block(row, col, TB_STICK_TOP);
+    else if (block_at(row, col) == TB_STATION_MIDDLE)
+        set_block(row, col, TB_STICK_MIDDLE);
+    else if (block_at(row, col) == TB_STATION_BOTTOM)
+        set_block(row, col, TB_STICK_BOTTOM);
+    else if (block_at(row, col) == TB_DOOR)
+        set_block(row, col, TB_STICK_DOOR);
+    else if (block_at(row, col) == TB_DOOR_TARGET)
+        set_block(row, col, TB_STICK_DOOR_TARGET);
+    else if (block_at(row, col) == TB_EMPTY)
+        set_block(row, col, TB_STICK);
 }
 void lev_platform2empty(int row, int col) {
-    if (tower[row][col] == TB_ELEV_TOP)
-        tower[row][col] = TB_STATION_TOP;
-    else if (tower[row][col] == TB_ELEV_MIDDLE)
-        tower[row][col] = TB_STATION_MIDDLE;
-    else if (tower[row][col] == TB_ELEV_BOTTOM)
-        tower[row][col] = TB_STATION_BOTTOM;
-    else if (tower[row][col] == TB_ELEV_DOOR_TARGET)
-        tower[row][col] = TB_DOOR_TARGET;
-    else if (tower[row][col] == TB_ELEV_DOOR)
-        tower[row][col] = TB_DOOR;
-    else if (tower[row][col] == TB_STEP)
-        tower[row][col] = TB_EMPTY;
+    if (block_at(row, col) == TB_ELEV_TOP)
+        set_block(row, col, TB_STATION_TOP);
+    else if (block_at(row, col) == TB_ELEV_MIDDLE)
+        set_block(row, col, TB_STATION_MIDDLE);
+    else if (block_at(row, col) == TB_ELEV_BOTTOM)
+        set_block(row, col, TB_STATION_BOTTOM);
+    else if (block_at(row, col) == TB_ELEV_DOOR_TARGET)
+        set_block(row, col, TB_DOOR_TARGET);
+    else if (block_at(row, col) == TB_ELEV_DOOR)
+        set_block(row, col, TB_DOOR);
+    else if (block_at(row, col) == TB_STEP)
+        set_block(row, col, TB_EMPTY);
 }
 
 /* misc questions */
 bool lev_is_empty(int row, int col) {
-    return ((towerblockdata[tower[row][col]].tf & TBF_EMPTY));
+    return ((towerblockdata[block_at(row, col)].tf & TBF_EMPTY));
 }
 
 bool lev_is_box(int row, int col) {
-    return tower[row][col] == TB_BOX;
+    return block_at(row, col) == TB_BOX;
 }
 
 int lev_is_sliding(int row, int col) {
-    return ((tower[row][col] == TB_STEP_LSLIDER) ? 1 : (tower[row][col] == TB_STEP_RSLIDER) ? -1 : 0);
+    return ((block_at(row, col) == TB_STEP_LSLIDER) ? 1 : (block_at(row, col) == TB_STEP_RSLIDER) ? -1 : 0);
 }
 
 bool lev_is_robot(int row, int col) {
-    return ((towerblockdata[tower[row][col]].tf & TBF_ROBOT) != 0);
+    return ((towerblockdata[block_at(row, col)].tf & TBF_ROBOT) != 0);
+}
+
+Uint16 lev_rowmask(lev_mask kind, int row) {
+    tower_chunk *c = chunk_of(row);
+
+    if (!c)
+        return (kind == TMASK_EMPTY) ? 0xffff : 0;
+    return c->mask[row % CHUNK_ROWS][kind];
 }
 
 static bool inside_cyclic_intervall(int x, int start, int end, int cycle) {
@@ -791,7 +2341,7 @@ static bool inside_cyclic_intervall(int x, int start, int end, int cycle) {
  without colliding with fixed objects of the tower */
 bool lev_testfigure(long angle, long vert, long back, long fore, long typ, long height,
         long width) {
-    long hinten, vorn, y, x = 0, k, t;
+    long hinten, vorn, y, x = 0, k, c;
 
     hinten = ((angle + back) >> 3) & 0xf;
     vorn = (((angle + fore) >> 3) + 1) & 0xf;
@@ -814,46 +2364,69 @@ bool lev_testfigure(long angle, long vert, long back, long fore, long typ, long
         break;
     }
 
-    do {
-        k = x;
-        do {
-            if (lev_is_platform(k + y, hinten)) {
-                return false;
-            } else if (lev_is_stick(k + y, hinten)) {
-                t = hinten * 8 + height;
-                if (inside_cyclic_intervall(angle, t, t + width, 0x80))
-                    return false;
-            } else if (lev_is_box(k + y, hinten)) {
-                t = hinten * 8 + height;
-                if (inside_cyclic_intervall(angle, t, t + width, 0x80)) {
-                    if (typ == 2) {
-                        // the snowball removes the box
-                        lev_clear(k + y, hinten);
-                        pts_add(50);
-                    }
-                    return false;
+    /* the columns from hinten up to vorn, all of them when both are the same */
+    Uint16 span = (vorn == hinten) ? 0xffff : (1 << ((vorn - hinten) & 0xf)) - 1;
+    span = (span << hinten) | (span >> (TOWERWID - hinten));
+
+    Uint16 platforms = 0, sticks = 0, boxes = 0;
+
+    for (k = 0; k <= x; k++) {
+        platforms |= lev_rowmask(TMASK_PLATFORM, y + k);
+        sticks |= lev_rowmask(TMASK_STICK, y + k);
+        boxes |= lev_rowmask(TMASK_BOX, y + k);
+    }
+
+    /* sticks and boxes are thinner than the column, they are only hit when
+     the angle is inside of the part they occupy */
+    Uint16 inside = 0;
+
+    for (c = 0; c < TOWERWID; c++)
+        if (((sticks | boxes) & span) & (1 << c)) {
+            long t = c * 8 + height;
+            if (inside_cyclic_intervall(angle, t, t + width, 0x80))
+                inside |= 1 << c;
+        }
+
+    Uint16 hit = span & (platforms | ((sticks | boxes) & inside));
+
+    if (!hit)
+        return true;
+
+    if ((typ == 2) && (hit & boxes & inside)) {
+        /* the snowball removes the box, when it is the first block hit
+         going through the columns from hinten on and in each column from
+         top to bottom */
+        for (c = hinten; !(hit & (1 << c)); c = (c + 1) & 0xf)
+            ;
+
+        for (k = x; k >= 0; k--) {
+            if (lev_rowmask(TMASK_PLATFORM, y + k) & (1 << c))
+                break;
+            if ((lev_rowmask(TMASK_STICK, y + k) | lev_rowmask(TMASK_BOX, y + k)) & inside & (1 << c)) {
+                if (lev_rowmask(TMASK_BOX, y + k) & (1 << c)) {
+                    lev_clear(y + k, c);
+                    pts_add(50);
                 }
+                break;
             }
-            k--;
-        } while (k != -1);
-        hinten = (hinten + 1) & 0xf;
-    } while (hinten != vorn);
+        }
+    }
 
-    return true;
+    return false;
 }
 
 #endif
 
 unsigned char lev_putplatform(int row, int col) {
-    unsigned char erg = tower[row][col];
+    unsigned char erg = block_at(row, col);
 
-    tower[row][col] = TB_ELEV_BOTTOM;
+    set_block(row, col, TB_ELEV_BOTTOM);
 
     return erg;
 }
 
 void lev_restore(int row, int col, unsigned char bg) {
-    tower[row][col] = bg;
+    set_block(row, col, bg);
 }
 
 /* load and save a tower */
@@ -864,6 +2437,7 @@ bool lev_loadtower(const char *fname) {
     if (in == NULL)
         return false;
 
+    towerfrommission = false;
     lev_clear_tower();
     lev_set_towerdemo(0, NULL);
     towertime = 0;
@@ -903,28 +2477,63 @@ bool lev_loadtower(const char *fname) {
         } else if (strncmp(&line[1], tss_string_data, strlen(tss_string_data)) == 0) {
 
             fgets(line, 200, in);
-            sscanf(line, "%hhu\n", &towerheight);
+            sscanf(line, "%hu\n", &towerheight);
+            if (towerheight > LEV_MAXROWS)
+                towerheight = LEV_MAXROWS;
 
             for (int row = towerheight - 1; row >= 0; row--) {
 
                 fgets(line, 200, in);
 
                 for (int col = 0; col < TOWERWID; col++)
-                    tower[row][col] = conv_char2towercode(line[col]);
+                    set_block(row, col, conv_char2towercode(line[col]));
             }
         } else if (strncmp(&line[1], tss_string_demo, strlen(tss_string_demo)) == 0) {
+            /* older files with one line for each tick */
             if (fgets(line, 200, in)) {
-                sscanf(line, "%i\n", &towerdemo_len);
+                dem_packer p;
+                int len = 0;
+                Uint32 seed = 0, size;
 
-                if (towerdemo_len > 0) {
-                    towerdemo = new Uint16[towerdemo_len];
+                /* the seed is missing in older files */
+                sscanf(line, "%i %u\n", &len, &seed);
 
-                    for (int idx = 0; idx < towerdemo_len; idx++) {
-                        fgets(line, 200, in);
-                        sscanf(line, "%hu\n", &towerdemo[idx]);
+                dem_pack_start(p);
+                for (int idx = 0; idx < len; idx++) {
+                    Uint16 keys = 0;
+
+                    fgets(line, 200, in);
+                    sscanf(line, "%hu\n", &keys);
+                    dem_pack(p, keys);
+                }
+
+                Uint8 *packed = dem_pack_finish(p, size, len);
+                set_packeddemo(packed, size, seed);
+            }
+        } else if (strncmp(&line[1], tss_string_keys, strlen(tss_string_keys)) == 0) {
+            if (fgets(line, 200, in)) {
+                dem_packer p;
+                int len = 0;
+                Uint32 seed = 0, size;
+
+                sscanf(line, "%i %u\n", &len, &seed);
+
+                /* the runs, until the demo is complete or something
+                 * else follows */
+                dem_pack_start(p);
+                while (p.len < len) {
+                    long pos = ftell(in);
+
+                    if (!fgets(line, 200, in))
+                        break;
+                    if (!dem_parse(p, line)) {
+                        fseek(in, pos, SEEK_SET);
+                        break;
                     }
-                } else
-                    towerdemo = NULL;
+                }
+
+                Uint8 *packed = dem_pack_finish(p, size, len);
+                set_packeddemo(packed, size, seed);
             }
         } else if (strncmp(&line[1], tss_string_robot, strlen(tss_string_robot)) == 0) {
             fgets(line, 200, in);
@@ -941,6 +2550,7 @@ bool lev_loadtower(const char *fname) {
     }
 
     fclose(in);
+    reset_changes();
     return true;
 }
 
@@ -965,25 +2575,22 @@ bool lev_savetower(const char *fname) {
     fprintf(out, "%hhu\n", towerrobot);
 
     fprintf(out, "[%s]\n", tss_string_data);
-    fprintf(out, "%hhu\n", towerheight);
+    fprintf(out, "%hu\n", towerheight);
     for (int row = towerheight - 1; row >= 0; row--) {
         char line[TOWERWID + 2];
 
         for (int col = 0; col < TOWERWID; col++)
-            line[col] = conv_towercode2char(tower[row][col]);
+            line[col] = conv_towercode2char(block_at(row, col));
 
         line[TOWERWID] = '|';
         line[TOWERWID + 1] = 0;
         fprintf(out, "%s\n", line);
     }
 
-    fprintf(out, "[%s]\n", tss_string_demo);
-    fprintf(out, "%i\n", towerdemo_len);
-    if (towerdemo && (towerdemo_len > 0)) {
-        for (int idx = 0; idx < towerdemo_len; idx++) {
-            fprintf(out, "%hu\n", towerdemo[idx]);
-        }
-    }
+    /* the demo in the text form of demo.h */
+    fprintf(out, "[%s]\n", tss_string_keys);
+    fprintf(out, "%i %u\n", towerdemo_len, towerdemo_seed);
+    dem_text(out, towerdemo, towerdemo_size, 70);
 
     fclose(out);
 
@@ -995,53 +2602,54 @@ bool lev_savetower(const char *fname) {
 /* rotate row clock and counter clockwise */
 void lev_rotaterow(int row, bool clockwise) {
     if (clockwise) {
-        int k = tower[row][0];
+        int k = block_at(row, 0);
         for (int i = 1; i < TOWERWID; i++)
-            tower[row][i - 1] = tower[row][i];
-        tower[row][TOWERWID - 1] = k;
+            set_block(row, i - 1, block_at(row, i));
+        set_block(row, TOWERWID - 1, k);
     } else {
-        int k = tower[row][TOWERWID - 1];
-        for (int i = TOWERWID - 1; i >= 0; i++)
-            tower[row][i] = tower[row][i - 1];
-        tower[row][0] = k;
+        int k = block_at(row, TOWERWID - 1);
+        for (int i = TOWERWID - 1; i > 0; i--)
+            set_block(row, i, block_at(row, i - 1));
+        set_block(row, 0, k);
     }
 }
 
 /* insert and delete one row */
 void lev_insertrow(int position) {
-    if ((towerheight < 255) && (position < towerheight)) {
-        int k = towerheight - 1;
-        while (k >= position) {
-            for (int i = 0; i < TOWERWID; i++)
-                tower[k + 1][i] = tower[k][i];
-            k--;
-        }
-        for (int i = 0; i < TOWERWID; i++)
-            tower[position][i] = 0;
-        towerheight++;
+    if ((towerheight < LEV_MAXROWS) && (position >= 0) && (position < towerheight)) {
+#ifdef __BLACKBERRY__
+#else
+        jrn_add(JRN_INSROW, position);
+#endif
+        insert_row(position);
         return;
     }
     if (towerheight == 0) {
-        for (int i = 0; i < TOWERWID; i++)
-            tower[0][i] = 0;
-        towerheight = 1;
+#ifdef __BLACKBERRY__
+#else
+        jrn_add(JRN_INSROW, 0);
+#endif
+        insert_row(0);
     }
 }
 
 void lev_deleterow(int position) {
     if ((position < towerheight) && (position >= 0)) {
-        int k = position + 1;
-        while (k < towerheight) {
-            for (int i = 0; i < TOWERWID; i++)
-                tower[k - 1][i] = tower[k][i];
-            k++;
-        }
-        towerheight--;
+        /* the journal only needs the contents of the row, the other
+         * rows just move */
+        for (int i = 0; i < TOWERWID; i++)
+            set_block(position, i, TB_EMPTY);
+#ifdef __BLACKBERRY__
+#else
+        jrn_add(JRN_DELROW, position);
+#endif
+        remove_row(position);
     }
 }
 
-void lev_new(Uint8 hei) {
-    towerheight = hei;
+void lev_new(Uint16 hei) {
+    towerfrommission = false;
+    towerheight = (hei < LEV_MAXROWS) ? hei : LEV_MAXROWS;
     lev_clear_tower();
 }
 
@@ -1051,510 +2659,687 @@ void lev_putspace(int row, int col) {
     if (lev_is_door(row, col)) {
         int r = row - 1;
         while (lev_is_door(r, col)) {
-            tower[r][col] = TB_EMPTY;
+            set_block(r, col, TB_EMPTY);
             r--;
         }
         r = row + 1;
         while (lev_is_door(r, col)) {
-            tower[r][col] = TB_EMPTY;
+            set_block(r, col, TB_EMPTY);
             r++;
         }
     }
-    tower[row][col] = TB_EMPTY;
+    set_block(row, col, TB_EMPTY);
 }
 void lev_putrobot1(int row, int col) {
-    tower[row][col] = TB_ROBOT1;
+    set_block(row, col, TB_ROBOT1);
 }
 void lev_putrobot2(int row, int col) {
-    tower[row][col] = TB_ROBOT2;
+    set_block(row, col, TB_ROBOT2);
 }
 void lev_putrobot3(int row, int col) {
-    tower[row][col] = TB_ROBOT3;
+    set_block(row, col, TB_ROBOT3);
 }
 void lev_putrobot4(int row, int col) {
-    tower[row][col] = TB_ROBOT4;
+    set_block(row, col, TB_ROBOT4);
 }
 void lev_putrobot5(int row, int col) {
-    tower[row][col] = TB_ROBOT5;
+    set_block(row, col, TB_ROBOT5);
 }
 void lev_putrobot6(int row, int col) {
-    tower[row][col] = TB_ROBOT6;
+    set_block(row, col, TB_ROBOT6);
 }
 void lev_putrobot7(int row, int col) {
-    tower[row][col] = TB_ROBOT7;
+    set_block(row, col, TB_ROBOT7);
 }
 void lev_putstep(int row, int col) {
-    tower[row][col] = TB_STEP;
+    set_block(row, col, TB_STEP);
 }
 void lev_putvanishingstep(int row, int col) {
-    tower[row][col] = TB_STEP_VANISHER;
+    set_block(row, col, TB_STEP_VANISHER);
 }
 void lev_putslidingstep_left(int row, int col) {
-    tower[row][col] = TB_STEP_LSLIDER;
+    set_block(row, col, TB_STEP_LSLIDER);
 }
 void lev_putslidingstep_right(int row, int col) {
-    tower[row][col] = TB_STEP_RSLIDER;
+    set_block(row, col, TB_STEP_RSLIDER);
 }
 
 void lev_putdoor(int row, int col) {
 
     if (row + 2 < towerheight) {
 
-        tower[row][col] = TB_DOOR;
-        tower[row + 1][col] = TB_DOOR;
-        tower[row + 2][col] = TB_DOOR;
+        set_block(row, col, TB_DOOR);
+        set_block(row + 1, col, TB_DOOR);
+        set_block(row + 2, col, TB_DOOR);
 
-        if ((tower[row][(col + (TOWERWID / 2)) % TOWERWID] == 0)
-                && (tower[row + 1][(col + (TOWERWID / 2)) % TOWERWID] == 0)
-                && (tower[row + 2][(col + (TOWERWID / 2)) % TOWERWID] == 0)) {
-            tower[row][(col + (TOWERWID / 2)) % TOWERWID] = TB_DOOR;
-            tower[row + 1][(col + (TOWERWID / 2)) % TOWERWID] = TB_DOOR;
-            tower[row + 2][(col + (TOWERWID / 2)) % TOWERWID] = TB_DOOR;
+        if ((block_at(row, (col + (TOWERWID / 2)) % TOWERWID) == 0)
+                && (block_at(row + 1, (col + (TOWERWID / 2)) % TOWERWID) == 0)
+                && (block_at(row + 2, (col + (TOWERWID / 2)) % TOWERWID) == 0)) {
+            set_block(row, (col + (TOWERWID / 2)) % TOWERWID, TB_DOOR);
+            set_block(row + 1, (col + (TOWERWID / 2)) % TOWERWID, TB_DOOR);
+            set_block(row + 2, (col + (TOWERWID / 2)) % TOWERWID, TB_DOOR);
         }
     }
 }
 
 void lev_puttarget(int row, int col) {
     if (row + 2 < towerheight) {
-        tower[row][col] = TB_DOOR_TARGET;
-        tower[row + 1][col] = TB_DOOR_TARGET;
-        tower[row + 2][col] = TB_DOOR_TARGET;
+        set_block(row, col, TB_DOOR_TARGET);
+        set_block(row + 1, col, TB_DOOR_TARGET);
+        set_block(row + 2, col, TB_DOOR_TARGET);
     }
 }
 
 void lev_putstick(int row, int col) {
-    tower[row][col] = TB_STICK;
+    set_block(row, col, TB_STICK);
 }
 void lev_putbox(int row, int col) {
-    tower[row][col] = TB_BOX;
+    set_block(row, col, TB_BOX);
 }
 void lev_putelevator(int row, int col) {
-    tower[row][col] = TB_ELEV_BOTTOM;
+    set_block(row, col, TB_ELEV_BOTTOM);
 }
 void lev_putmiddlestation(int row, int col) {
-    tower[row][col] = TB_STATION_MIDDLE;
+    set_block(row, col, TB_STATION_MIDDLE);
 }
 void lev_puttopstation(int row, int col) {
-    tower[row][col] = TB_STATION_TOP;
+    set_block(row, col, TB_STATION_TOP);
 }
 
 void lev_save(unsigned char *&data) {
-    data = new unsigned char[256 * TOWERWID + 1];
+    data = new unsigned char[sizeof(towerheight) + towerheight * TOWERWID];
 
-    data[0] = towerheight;
-    memmove(&data[1], tower, 256 * TOWERWID);
+    memcpy(data, &towerheight, sizeof(towerheight));
+    get_rows(data + sizeof(towerheight), 0, towerheight);
 }
 
 void lev_restore(unsigned char *&data) {
-    memmove(tower, &data[1], 256 * TOWERWID);
-    towerheight = data[0];
+    towerfrommission = false;
+    memcpy(&towerheight, data, sizeof(towerheight));
+    put_rows(data + sizeof(towerheight), towerheight);
 
     delete[] data;
 }
 
-#ifdef __BLACKBERRY__
-#else
-lev_problem lev_is_consistent(int &row, int &col) {
+/* the snapshot contains the height and the rows that differ from the
+ * tower as it was selected, in the order of changedrows */
+void lev_savestate(unsigned char *&p) {
+    Uint16 rows = 0;
+    unsigned char *count;
 
-    int y;
-    bool has_exit = false;
-    // check first, if the starting point is correctly organized
-    // so that there is no obstacle and we can survive there
-    if ((tower[1][0] != TB_STICK) && (tower[1][0] != TB_STEP) && (tower[1][0] != TB_STEP_LSLIDER)
-            && (tower[1][0] != TB_STEP_RSLIDER) && (tower[1][0] != TB_BOX)
-            && (tower[1][0] != TB_ELEV_BOTTOM) && (tower[0][0] != TB_STICK)
-            && (tower[0][0] != TB_STEP) && (tower[0][0] != TB_STEP_LSLIDER)
-            && (tower[0][0] != TB_STEP_RSLIDER) && (tower[0][0] != TB_BOX)
-            && (tower[0][0] != TB_ELEV_BOTTOM)) {
-        row = 1;
-        col = 0;
-        return TPROB_NOSTARTSTEP;
-    }
-    for (y = 2; y < 5; y++)
-        if ((towerblockdata[tower[y][0]].tf & TBF_DEADLY)
-                || !(towerblockdata[tower[y][0]].tf & TBF_EMPTY)) {
-            row = y;
-            col = 0;
-            return TPROB_STARTBLOCKED;
+    SNP_PUT(p, towerheight);
+    count = p;
+    p += sizeof(rows);
+
+    for (int i = 0; i < changedcount; i++) {
+        const Uint8 *b = row_blocks(changedrows[i].row);
+
+        if (memcmp(b, changedrows[i].orig, TOWERWID)) {
+            SNP_PUT(p, changedrows[i].row);
+            SNP_PUTN(p, b, TOWERWID);
+            rows++;
         }
+    }
 
-    if (towerheight < 4)
-        return TPROB_SHORTTOWER;
+    memcpy(count, &rows, sizeof(rows));
+}
 
-    for (int r = 0; r < towerheight; r++)
-        for (int c = 0; c < TOWERWID; c++) {
-            // check for undefined symbols
-            if (tower[r][c] >= NUM_TBLOCKS) {
-                row = r;
-                col = c;
-                return TPROB_UNDEFBLOCK;
-            }
+void lev_loadstate(const unsigned char *&p) {
+    Uint16 rows, row;
+    const unsigned char *start;
 
-            // check if elevators always have an opposing end without unremovable
-            // obstacles
-            if (tower[r][c] == TB_ELEV_BOTTOM) {
-                int d = r + 1;
-                while ((tower[d][c] != TB_STATION_TOP) && (d < towerheight)) {
-                    if ((tower[d][c] != TB_EMPTY) && (tower[d][c] != TB_ROBOT1)
-                            && (tower[d][c] != TB_ROBOT2) && (tower[d][c] != TB_ROBOT3)
-                            && (tower[d][c] != TB_ROBOT4) && (tower[d][c] != TB_ROBOT5)
-                            && (tower[d][c] != TB_ROBOT6) && (tower[d][c] != TB_ROBOT7)
-                            && (tower[d][c] != TB_BOX) && (tower[d][c] != TB_STATION_MIDDLE)
-                            && (tower[d][c] != TB_STEP_VANISHER) && (tower[d][c] != TB_DOOR)
-                            && (tower[d][c] != TB_DOOR_TARGET)) {
-                        row = r;
-                        col = c;
-                        return TPROB_ELEVATORBLOCKED;
-                    }
-                    d++;
-                }
-                if (d >= towerheight) {
-                    row = r;
-                    col = c;
-                    return TPROB_NOELEVATORSTOP;
-                }
-            }
+    SNP_GET(p, towerheight);
+    SNP_GET(p, rows);
+    start = p;
 
-            if (tower[r][c] == TB_STATION_MIDDLE) {
-                int d = r + 1;
-                while ((tower[d][c] != TB_STATION_TOP) && (d < towerheight)) {
-                    if ((tower[d][c] != TB_EMPTY) && (tower[d][c] != TB_ROBOT1)
-                            && (tower[d][c] != TB_ROBOT2) && (tower[d][c] != TB_ROBOT3)
-                            && (tower[d][c] != TB_ROBOT4) && (tower[d][c] != TB_ROBOT5)
-                            && (tower[d][c] != TB_ROBOT6) && (tower[d][c] != TB_ROBOT7)
-                            && (tower[d][c] != TB_BOX) && (tower[d][c] != TB_STATION_MIDDLE)
-                            && (tower[d][c] != TB_DOOR) && (tower[d][c] != TB_DOOR_TARGET)
-                            && (tower[d][c] != TB_STEP_VANISHER)) {
-                        row = r;
-                        col = c;
-                        return TPROB_ELEVATORBLOCKED;
-                    }
-                    d++;
-                }
-                if (d >= towerheight) {
-                    row = r;
-                    col = c;
-                    return TPROB_NOELEVATORSTOP;
-                }
-                d = r - 1;
-                while ((tower[d][c] != TB_ELEV_BOTTOM) && (d >= 0)) {
-                    if ((tower[d][c] != TB_EMPTY) && (tower[d][c] != TB_ROBOT1)
-                            && (tower[d][c] != TB_ROBOT2) && (tower[d][c] != TB_ROBOT3)
-                            && (tower[d][c] != TB_ROBOT4) && (tower[d][c] != TB_ROBOT5)
-                            && (tower[d][c] != TB_ROBOT6) && (tower[d][c] != TB_ROBOT7)
-                            && (tower[d][c] != TB_BOX) && (tower[d][c] != TB_STATION_MIDDLE)
-                            && (tower[d][c] != TB_DOOR) && (tower[d][c] != TB_DOOR_TARGET)
-                            && (tower[d][c] != TB_STEP_VANISHER)) {
-                        row = r;
-                        col = c;
-                        return TPROB_ELEVATORBLOCKED;
-                    }
-                    d--;
-                }
-                if (d < 0) {
-                    row = r;
-                    col = c;
-                    return TPROB_NOELEVATORSTOP;
-                }
-            }
+    /* the rows of the snapshot that didn't change here yet become
+     * changed rows, so that all of them are in changedrows */
+    for (int j = 0; j < rows; j++) {
+        SNP_GET(p, row);
+        if (!chunk_for(row)->changed[row % CHUNK_ROWS])
+            add_change(row);
+        p += TOWERWID;
+    }
 
-            if (tower[r][c] == TB_STATION_TOP) {
-                int d = r - 1;
-                while ((tower[d][c] != TB_ELEV_BOTTOM) && (d >= 0)) {
-                    if ((tower[d][c] != TB_EMPTY) && (tower[d][c] != TB_ROBOT1)
-                            && (tower[d][c] != TB_ROBOT2) && (tower[d][c] != TB_ROBOT3)
-                            && (tower[d][c] != TB_ROBOT4) && (tower[d][c] != TB_ROBOT5)
-                            && (tower[d][c] != TB_ROBOT6) && (tower[d][c] != TB_ROBOT7)
-                            && (tower[d][c] != TB_BOX) && (tower[d][c] != TB_STATION_MIDDLE)
-                            && (tower[d][c] != TB_DOOR) && (tower[d][c] != TB_DOOR_TARGET)
-                            && (tower[d][c] != TB_STEP_VANISHER)) {
-                        row = r;
-                        col = c;
-                        return TPROB_ELEVATORBLOCKED;
-                    }
-                    d--;
-                }
-                if (d < 0) {
-                    row = r;
-                    col = c;
-                    return TPROB_NOELEVATORSTOP;
-                }
+    /* all the other changed rows get their original blocks back. Both
+     * lists are sorted, usually only a few rows differ and only those
+     * need new masks */
+    p = start;
+    for (int i = 0, j = 0; i < changedcount; i++) {
+        const Uint8 *src = changedrows[i].orig;
+        Uint8 *dst = chunk_of(changedrows[i].row)->block[changedrows[i].row % CHUNK_ROWS];
+
+        if (j < rows) {
+            memcpy(&row, p, sizeof(row));
+            if (row == changedrows[i].row) {
+                src = p + sizeof(row);
+                p += sizeof(row) + TOWERWID;
+                j++;
             }
+        }
 
-            /* check for exit, and that it's reachable */
-            if (tower[r][c] == TB_DOOR_TARGET) {
-                int d = r - 1;
+        if (memcmp(dst, src, TOWERWID)) {
+            memcpy(dst, src, TOWERWID);
+            update_masks(changedrows[i].row, changedrows[i].row + 1);
+        }
+    }
+}
 
-                if (d < 0) {
-                    row = 0;
-                    col = c;
-                    return TPROB_UNREACHABLEEXIT;
-                }
+#ifdef __BLACKBERRY__
+#else
+/* the results of walking along an elevator to its other end */
+enum {
+    WALK_STOP, // found the station
+    WALK_BLOCKED, // something is in the way
+    WALK_NOSTOP // reached the end of the tower without finding a station
+};
 
-                while ((d >= 0) && (tower[d][c] == TB_DOOR_TARGET))
-                    d--;
-                if (d >= 0) {
-                    if ((tower[d][c] != TB_STICK) && (tower[d][c] != TB_STEP)
-                            && (tower[d][c] != TB_BOX) && (tower[d][c] != TB_ELEV_BOTTOM)
-                            && (tower[d][c] != TB_STICK)) {
-                        row = r;
-                        col = c;
-                        return TPROB_UNREACHABLEEXIT;
-                    }
-                }
-                has_exit = true;
-            }
+/* the consistency check is kept for the whole tower and after a change
+ * only the rows that might be affected are checked again. For each cell
+ * there is the result of the walk up to the next TB_STATION_TOP and down
+ * to the next TB_ELEV_BOTTOM, each of them depends only on the next cell
+ * in that direction. For each row there is the first problem in it and
+ * if it contains a part of the target door */
+typedef struct {
+    Uint8 walkup[LEV_MAXROWS][TOWERWID];
+    Uint8 walkdown[LEV_MAXROWS][TOWERWID];
+    Uint8 rowproblem[LEV_MAXROWS];
+    Uint8 rowproblemcol[LEV_MAXROWS];
+    bool rowexit[LEV_MAXROWS];
+    /* the number of rows with a problem and with a part of the exit */
+    int problemrows, exitrows;
+    /* the rows to check again in update_check(), as flags and as list */
+    bool recheck[LEV_MAXROWS];
+    Uint16 rechecklist[LEV_MAXROWS];
+    int recheckcount;
+} check_state;
+
+/* only allocated when the editor checks a tower */
+static GAME_STATE check_state *check = NULL;
+static GAME_STATE int checkedheight = -1;
+
+static void free_check(void) {
+    if (check)
+        delete check;
+    check = NULL;
+    checkedheight = -1;
+}
+
+/* takes the changed cells of a row, see tower_chunk */
+static Uint16 take_changed_cells(int r) {
+    tower_chunk *c = chunk_of(r);
+    Uint16 cells = 0;
+
+    if (c) {
+        cells = c->changedcells[r % CHUNK_ROWS];
+        c->changedcells[r % CHUNK_ROWS] = 0;
+    }
+    return cells;
+}
 
-            // check doors
-            if ((tower[r][c] == TB_DOOR) && !lev_is_door(r, (c + (TOWERWID / 2)) % TOWERWID)) {
-                row = r;
-                col = c;
-                return TPROB_NOOTHERDOOR;
-            }
-            if (lev_is_door(r, c)) {
-                bool A = (r > 0) && (tower[r - 1][c] == tower[r][c]);
-                bool B = (r > 1) && (tower[r - 2][c] == tower[r][c]);
-                bool D = (r + 1 < towerheight) && (tower[r + 1][c] == tower[r][c]);
-                bool E = (r + 2 < towerheight) && (tower[r + 2][c] == tower[r][c]);
-
-                if (!(A && B || A && D || D && E)) {
-                    row = r;
-                    col = c;
-                    return TPROB_BROKENDOOR;
-                }
-            }
-        }
+static void clear_changed_cells(void) {
+    for (int i = 0; i < NUM_CHUNKS; i++)
+        if (towerchunk[i])
+            memset(towerchunk[i]->changedcells, 0, sizeof(towerchunk[i]->changedcells));
+    dirtycount = 0;
+}
 
-    if (!has_exit)
-        return TPROB_NOEXIT;
+static void mark_recheck(int r) {
+    if ((r >= 0) && (r < towerheight) && !check->recheck[r]) {
+        check->recheck[r] = true;
+        check->rechecklist[check->recheckcount++] = r;
+    }
+}
 
-    /* other, non-tower related problems */
-    if (lev_towertime() < 5)
-        return TPROB_SHORTTIME;
-    if (!strlen(lev_towername()))
-        return TPROB_NONAME;
+/* the blocks an elevator can move through */
+static bool elevator_passes(Uint8 block) {
+    switch (block) {
+    case TB_EMPTY:
+    case TB_ROBOT1:
+    case TB_ROBOT2:
+    case TB_ROBOT3:
+    case TB_ROBOT4:
+    case TB_ROBOT5:
+    case TB_ROBOT6:
+    case TB_ROBOT7:
+    case TB_BOX:
+    case TB_STATION_MIDDLE:
+    case TB_STEP_VANISHER:
+    case TB_DOOR:
+    case TB_DOOR_TARGET:
+        return true;
+    default:
+        return false;
+    }
+}
 
-    return TPROB_NONE;
+static Uint8 walk_up(int r, int c) {
+    int d = r + 1;
+
+    if (d >= towerheight)
+        return WALK_NOSTOP;
+    if (block_at(d, c) == TB_STATION_TOP)
+        return WALK_STOP;
+    if (!elevator_passes(block_at(d, c)))
+        return WALK_BLOCKED;
+    return check->walkup[d][c];
 }
 
-/* the functions for mission creation */
-static FILE * fmission = NULL;
-static Uint8 nmission = 0;
-static Uint32 missionidx[256];
+static Uint8 walk_down(int r, int c) {
+    int d = r - 1;
 
-bool lev_mission_new(char * name, Uint8 prio) {
-    assert_msg(!fmission, "called mission_finish twice");
+    if (d < 0)
+        return WALK_NOSTOP;
+    if (block_at(d, c) == TB_ELEV_BOTTOM)
+        return WALK_STOP;
+    if (!elevator_passes(block_at(d, c)))
+        return WALK_BLOCKED;
+    return check->walkdown[d][c];
+}
 
-    char fname[200];
-    snprintf(fname, 200, "%s.ttm", name);
+static lev_problem walk_problem(Uint8 walk) {
+    switch (walk) {
+    case WALK_BLOCKED:
+        return TPROB_ELEVATORBLOCKED;
+    case WALK_NOSTOP:
+        return TPROB_NOELEVATORSTOP;
+    default:
+        return TPROB_NONE;
+    }
+}
 
-    fmission = create_local_data_file(fname);
+/* the problem of one cell, the walks must be up to date */
+static lev_problem check_cell(int r, int c) {
+    Uint8 b = block_at(r, c);
+    lev_problem p;
+
+    // check for undefined symbols
+    if (b >= NUM_TBLOCKS)
+        return TPROB_UNDEFBLOCK;
+
+    // check if elevators always have an opposing end without unremovable
+    // obstacles
+    if ((b == TB_ELEV_BOTTOM) || (b == TB_STATION_MIDDLE))
+        if ((p = walk_problem(check->walkup[r][c])) != TPROB_NONE)
+            return p;
+    if ((b == TB_STATION_MIDDLE) || (b == TB_STATION_TOP))
+        if ((p = walk_problem(check->walkdown[r][c])) != TPROB_NONE)
+            return p;
+
+    /* check for exit, and that it's reachable */
+    if (b == TB_DOOR_TARGET) {
+        int d = r - 1;
+
+        if (d < 0)
+            return TPROB_UNREACHABLEEXIT;
+
+        while ((d >= 0) && (block_at(d, c) == TB_DOOR_TARGET))
+            d--;
+        if ((d >= 0) && (block_at(d, c) != TB_STICK) && (block_at(d, c) != TB_STEP)
+                && (block_at(d, c) != TB_BOX) && (block_at(d, c) != TB_ELEV_BOTTOM))
+            return TPROB_UNREACHABLEEXIT;
+    }
 
-    if (!fmission)
-        return false;
+    // check doors
+    if ((b == TB_DOOR) && !lev_is_door(r, (c + (TOWERWID / 2)) % TOWERWID))
+        return TPROB_NOOTHERDOOR;
+    if (lev_is_door(r, c)) {
+        bool A = (r > 0) && (block_at(r - 1, c) == b);
+        bool B = (r > 1) && (block_at(r - 2, c) == b);
+        bool D = (r + 1 < towerheight) && (block_at(r + 1, c) == b);
+        bool E = (r + 2 < towerheight) && (block_at(r + 2, c) == b);
+
+        if (!(A && B || A && D || D && E))
+            return TPROB_BROKENDOOR;
+    }
 
-    unsigned char tmp = strlen(name);
+    return TPROB_NONE;
+}
 
-    /* write out name */
-    fwrite(&tmp, 1, 1, fmission);
-    fwrite(name, 1, tmp, fmission);
+/* checks one row again, the counts must contain the old result */
+static void check_row(unsigned int r) {
+    if (r >= LEV_MAXROWS)
+        return;
 
-    fwrite(&prio, 1, 1, fmission);
+    lev_problem problem = TPROB_NONE;
+    int problemcol = 0;
+    bool exit = false;
 
-    /* placeholders for towernumber and indexstart */
-    fwrite(&tmp, 1, 1, fmission);
-    fwrite(&tmp, 1, 4, fmission);
+    for (int c = 0; c < TOWERWID; c++) {
+        if (block_at(r, c) == TB_DOOR_TARGET)
+            exit = true;
+        if (problem == TPROB_NONE) {
+            problem = check_cell(r, c);
+            problemcol = c;
+        }
+    }
 
-    nmission = 0;
+    check->problemrows += (problem != TPROB_NONE) - (check->rowproblem[r] != TPROB_NONE);
+    check->exitrows += exit - check->rowexit[r];
 
-    return true;
+    check->rowproblem[r] = problem;
+    check->rowproblemcol[r] = problemcol;
+    check->rowexit[r] = exit;
 }
 
-void write_fmission_section(Uint8 section, Uint32 section_len) {
-    Uint8 tmp;
-    fwrite(&section, 1, 1, fmission);
+/* brings the check up to date with the changes in changedcells */
+static void update_check(void) {
+    int low[TOWERWID], high[TOWERWID];
 
-    tmp = section_len & 0xff;
-    fwrite(&tmp, 1, 1, fmission);
-    tmp = (section_len >> 8) & 0xff;
-    fwrite(&tmp, 1, 1, fmission);
-    tmp = (section_len >> 16) & 0xff;
-    fwrite(&tmp, 1, 1, fmission);
-    tmp = (section_len >> 24) & 0xff;
-    fwrite(&tmp, 1, 1, fmission);
-}
+    if (!check) {
+        check = new check_state;
+        checkedheight = -1;
+    }
 
-void lev_mission_addtower(char * name) {
-    assert_msg(fmission, "called mission_addtower without mission_new");
+    if (changedall || (towerheight != checkedheight)) {
+        for (int c = 0; c < TOWERWID; c++) {
+            for (int r = towerheight - 1; r >= 0; r--)
+                check->walkup[r][c] = walk_up(r, c);
+            for (int r = 0; r < towerheight; r++)
+                check->walkdown[r][c] = walk_down(r, c);
+        }
+        memset(check->rowproblem, TPROB_NONE, sizeof(check->rowproblem));
+        memset(check->rowexit, 0, sizeof(check->rowexit));
+        memset(check->recheck, 0, sizeof(check->recheck));
+        check->problemrows = check->exitrows = check->recheckcount = 0;
 
-    Uint8 rows, col;
-    Sint16 row;
-    Uint8 namelen, tmp;
-    Uint32 section_len;
-    int idx;
+        for (int r = 0; r < towerheight; r++)
+            check_row(r);
 
-    if (!tower)
+        clear_changed_cells();
+        changedall = false;
+        checkedheight = towerheight;
         return;
+    }
 
-    missionidx[nmission] = ftell(fmission);
-    nmission++;
+    for (int c = 0; c < TOWERWID; c++) {
+        low[c] = towerheight;
+        high[c] = -1;
+    }
 
-    if (!lev_loadtower(name))
-        return;
+    for (int i = 0; i < dirtycount; i++) {
+        int r = dirtyrows[i];
+        Uint16 cells = take_changed_cells(r);
 
-    namelen = strlen(towername);
-    write_fmission_section(TSS_TOWERNAME, namelen);
-    fwrite(towername, 1, namelen, fmission);
+        if (!cells || (r >= towerheight))
+            continue;
 
-    write_fmission_section(TSS_ROBOT, 1);
-    fwrite(&towerrobot, 1, 1, fmission);
+        /* the doors look 2 rows up and down */
+        for (int d = r - 2; d <= r + 2; d++)
+            mark_recheck(d);
 
-    write_fmission_section(TSS_TOWERTIME, 2);
-    tmp = towertime & 0xff;
-    fwrite(&tmp, 1, 1, fmission);
-    tmp = (towertime >> 8) & 0xff;
-    fwrite(&tmp, 1, 1, fmission);
+        for (int c = 0; c < TOWERWID; c++)
+            if (cells & (1 << c)) {
+                if (r < low[c])
+                    low[c] = r;
+                if (r > high[c])
+                    high[c] = r;
 
-    write_fmission_section(TSS_TOWERCOLOR, 3);
-    fwrite(&towercolor_red, 1, 1, fmission);
-    fwrite(&towercolor_green, 1, 1, fmission);
-    fwrite(&towercolor_blue, 1, 1, fmission);
+                /* the target door above looks down to what it stands on */
+                for (int d = r + 1; (d < towerheight) && (block_at(d, c) == TB_DOOR_TARGET); d++)
+                    mark_recheck(d);
+            }
+    }
 
-    rows = towerheight;
+    dirtycount = 0;
 
-    /* calculate tower data section length */
-    section_len = 2 * towerheight;
-    for (row = 0; row < rows; row++)
-        for (col = 0; col < TOWERWID; col++)
-            if (tower[row][col])
-                section_len++;
-    write_fmission_section(TSS_TOWERDATA, section_len + 1);
+    /* the walks below and above the changes, as far as they change */
+    for (int c = 0; c < TOWERWID; c++) {
+        if (high[c] < 0)
+            continue;
 
-    fwrite(&towerheight, 1, 1, fmission);
+        for (int r = high[c] - 1; r >= 0; r--) {
+            Uint8 w = walk_up(r, c);
+            if (w == check->walkup[r][c]) {
+                if (r < low[c])
+                    break;
+                continue;
+            }
+            check->walkup[r][c] = w;
+            mark_recheck(r);
+        }
 
-    /* output bitmap */
-    for (row = 0; row < rows; row++) {
+        for (int r = low[c] + 1; r < towerheight; r++) {
+            Uint8 w = walk_down(r, c);
+            if (w == check->walkdown[r][c]) {
+                if (r > high[c])
+                    break;
+                continue;
+            }
+            check->walkdown[r][c] = w;
+            mark_recheck(r);
+        }
+    }
 
-        Uint8 c = 0;
-        for (col = 0; col < 8; col++)
-            if (tower[row][col])
-                c |= (0x80 >> col);
+    for (int i = 0; i < check->recheckcount; i++) {
+        int r = check->rechecklist[i];
 
-        fwrite(&c, 1, 1, fmission);
+        check->recheck[r] = false;
+        check_row(r);
+    }
+    check->recheckcount = 0;
+}
 
-        c = 0;
-        for (col = 0; col < 8; col++)
-            if (tower[row][col + 8])
-                c |= (0x80 >> col);
+lev_problem lev_is_consistent(int &row, int &col) {
 
-        fwrite(&c, 1, 1, fmission);
+    int y;
+    // check first, if the starting point is correctly organized
+    // so that there is no obstacle and we can survive there
+    if ((block_at(1, 0) != TB_STICK) && (block_at(1, 0) != TB_STEP) && (block_at(1, 0) != TB_STEP_LSLIDER)
+            && (block_at(1, 0) != TB_STEP_RSLIDER) && (block_at(1, 0) != TB_BOX)
+            && (block_at(1, 0) != TB_ELEV_BOTTOM) && (block_at(0, 0) != TB_STICK)
+            && (block_at(0, 0) != TB_STEP) && (block_at(0, 0) != TB_STEP_LSLIDER)
+            && (block_at(0, 0) != TB_STEP_RSLIDER) && (block_at(0, 0) != TB_BOX)
+            && (block_at(0, 0) != TB_ELEV_BOTTOM)) {
+        row = 1;
+        col = 0;
+        return TPROB_NOSTARTSTEP;
     }
+    for (y = 2; y < 5; y++)
+        if ((towerblockdata[block_at(y, 0)].tf & TBF_DEADLY)
+                || !(towerblockdata[block_at(y, 0)].tf & TBF_EMPTY)) {
+            row = y;
+            col = 0;
+            return TPROB_STARTBLOCKED;
+        }
+
+    if (towerheight < 4)
+        return TPROB_SHORTTOWER;
+
+    update_check();
 
-    /* output bytemap */
-    for (row = 0; row < rows; row++)
-        for (col = 0; col < TOWERWID; col++)
-            if (tower[row][col])
-                fwrite(&tower[row][col], 1, 1, fmission);
+    /* the lowest problem is reported, the rows are only searched when
+     * there is one */
+    if (check->problemrows)
+        for (int r = 0; r < towerheight; r++)
+            if (check->rowproblem[r] != TPROB_NONE) {
+                row = r;
+                col = check->rowproblemcol[r];
+                return (lev_problem) check->rowproblem[r];
+            }
 
-    /* output towerdemo */
+    if (!check->exitrows)
+        return TPROB_NOEXIT;
 
-    if (towerdemo && (towerdemo_len > 0)) {
-        Uint8 run;
-        Uint16 data;
+    /* other, non-tower related problems */
+    if (lev_towertime() < 5)
+        return TPROB_SHORTTIME;
+    if (!strlen(lev_towername()))
+        return TPROB_NONAME;
 
-        /* calc data length */
-        run = 1;
-        data = towerdemo[0];
-        section_len = 2;
+    return TPROB_NONE;
+}
 
-        for (idx = 1; idx < towerdemo_len; idx++) {
-            if ((data != towerdemo[idx]) || (run == 0xff)) {
-                section_len += 3;
+/* the functions for mission creation, the mission is collected
+ * in memory and written when it is complete */
+static bool mis_open = false;
+static char mis_name[MIS_NAMELEN + 1];
+static Uint8 mis_prio;
+static Uint16 mis_towers;
+static Uint8 *mis_table = NULL;
+static Uint32 mis_tablesize;
+static Uint8 *mis_data = NULL;
+static Uint32 mis_datalen, mis_datasize;
 
-                data = towerdemo[idx];
-                run = 1;
-            } else
-                run++;
-        }
-        if (run)
-            section_len += 3;
-
-        write_fmission_section(TSS_DEMO, section_len);
-
-        /* output length */
-        tmp = towerdemo_len & 0xff;
-        fwrite(&tmp, 1, 1, fmission);
-        tmp = (towerdemo_len >> 8) & 0xff;
-        fwrite(&tmp, 1, 1, fmission);
-
-        /* output data using a simple runlength encoder */
-        run = 1;
-        data = towerdemo[0];
-
-        for (idx = 1; idx < towerdemo_len; idx++) {
-            if ((data != towerdemo[idx]) || (run == 0xff)) {
-                fwrite(&run, 1, 1, fmission);
-                tmp = data & 0xff;
-                fwrite(&tmp, 1, 1, fmission);
-                tmp = (data >> 8) & 0xff;
-                fwrite(&tmp, 1, 1, fmission);
-
-                data = towerdemo[idx];
-                run = 1;
-            } else
-                run++;
-        }
+static void putlong(Uint8 *p, Uint32 v) {
+    p[0] = v;
+    p[1] = v >> 8;
+    p[2] = v >> 16;
+    p[3] = v >> 24;
+}
 
-        if (run) {
-            fwrite(&run, 1, 1, fmission);
-            tmp = data & 0xff;
-            fwrite(&tmp, 1, 1, fmission);
-            tmp = (data >> 8) & 0xff;
-            fwrite(&tmp, 1, 1, fmission);
-        }
+static void putword(Uint8 *p, Uint16 v) {
+    p[0] = v;
+    p[1] = v >> 8;
+}
+
+/* makes sure that need more bytes fit behind the used ones */
+static void mis_reserve(Uint8 *&buf, Uint32 used, Uint32 &size, Uint32 need) {
+    if (used + need <= size)
+        return;
+
+    Uint32 n = size ? 2 * size : 4096;
+    while (n < used + need)
+        n *= 2;
+
+    Uint8 *b = new Uint8[n];
+    if (buf) {
+        memcpy(b, buf, used);
+        delete[] buf;
     }
+    buf = b;
+    size = n;
+}
+
+static void mis_free(void) {
+    if (mis_table)
+        delete[] mis_table;
+    if (mis_data)
+        delete[] mis_data;
+    mis_table = mis_data = NULL;
+    mis_tablesize = mis_datalen = mis_datasize = 0;
+    mis_open = false;
+}
+
+bool lev_mission_new(char * name, Uint8 prio) {
+    assert_msg(!mis_open, "called mission_finish twice");
+
+    strncpy(mis_name, name, MIS_NAMELEN);
+    mis_name[MIS_NAMELEN] = 0;
+    mis_prio = prio;
+    mis_towers = 0;
+    mis_open = true;
 
-    write_fmission_section(TSS_END, 0);
+    return true;
 }
 
-void lev_mission_finish() {
-    assert_msg(fmission, "called mission_finish without mission_new");
+void lev_mission_addtower(char * name) {
+    assert_msg(mis_open, "called mission_addtower without mission_new");
 
-    Uint8 c;
+    if ((mis_towers == 0xffff) || !lev_loadtower(name))
+        return;
 
-    /* save indexstart and write out index */
-    Uint32 idxpos = ftell(fmission);
-    for (Uint8 i = 0; i < nmission; i++) {
+    Uint32 pos = mis_datalen;
+    Uint32 blocksize = (Uint32) towerheight * TOWERWID;
+    Uint32 keys = towerdemo_size ? towerdemo_len : 0;
+    uLongf packedsize = keys ? compressBound(towerdemo_size) : 0;
+    Uint8 codec = MIS_DEMO_NONE;
+    Uint8 maxblock = 0;
+
+    if (packedsize < towerdemo_size)
+        packedsize = towerdemo_size;
+
+    mis_reserve(mis_data, mis_datalen, mis_datasize, blocksize + packedsize + MIS_ALIGN);
+
+    /* the blocks as they are */
+    get_rows(mis_data + pos, 0, towerheight);
+    for (Uint32 i = 0; i < blocksize; i++)
+        if (mis_data[pos + i] > maxblock)
+            maxblock = mis_data[pos + i];
+
+    /* followed by the packed demo, deflated when that makes it smaller */
+    if (keys) {
+        Uint8 *demo = mis_data + pos + blocksize;
+
+        if ((compress2(demo, &packedsize, towerdemo, towerdemo_size, Z_BEST_COMPRESSION) == Z_OK)
+                && (packedsize < towerdemo_size))
+            codec = MIS_DEMO_PACKED_DEFLATED;
+        else {
+            memcpy(demo, towerdemo, towerdemo_size);
+            packedsize = towerdemo_size;
+            codec = MIS_DEMO_PACKED;
+        }
+    }
 
-        c = missionidx[i] & 0xff;
-        fwrite(&c, 1, 1, fmission);
-        c = (missionidx[i] >> 8) & 0xff;
-        fwrite(&c, 1, 1, fmission);
-        c = (missionidx[i] >> 16) & 0xff;
-        fwrite(&c, 1, 1, fmission);
-        c = (missionidx[i] >> 24) & 0xff;
-        fwrite(&c, 1, 1, fmission);
+    Uint32 len = blocksize + packedsize;
+
+    mis_datalen = pos + len;
+    while (mis_datalen % MIS_ALIGN)
+        mis_data[mis_datalen++] = 0;
+
+    mis_reserve(mis_table, mis_towers * MIS_ENTRYSIZE, mis_tablesize, MIS_ENTRYSIZE);
+
+    Uint8 *e = mis_table + mis_towers * MIS_ENTRYSIZE;
+
+    memset(e, 0, MIS_ENTRYSIZE);
+    /* the position is relative to the start of the tower data until
+     * the size of the table is known */
+    putlong(e, pos);
+    putlong(e + 4, len);
+    putlong(e + 8, checksum(mis_data + pos, len));
+    putword(e + 12, towerheight);
+    putword(e + 14, towertime);
+    e[16] = towerrobot;
+    e[17] = towercolor_red;
+    e[18] = towercolor_green;
+    e[19] = towercolor_blue;
+    putlong(e + 20, keys);
+    putlong(e + 24, keys ? towerdemo_seed : 0);
+    e[28] = codec;
+    e[29] = maxblock;
+    memcpy(e + 32, blocks_passwd(mis_data + pos, towerheight), PASSWORD_LEN);
+    memcpy(e + 40, towername, strlen(towername));
+
+    mis_towers++;
+}
+
+bool lev_mission_finish() {
+    assert_msg(mis_open, "called mission_finish without mission_new");
+
+    Uint32 tablelen = mis_towers * MIS_ENTRYSIZE;
+    Uint32 datapos = MIS_HEADERSIZE + tablelen;
+    Uint32 size = datapos + mis_datalen;
+    Uint8 *buf = new Uint8[size];
+    Uint8 *head = buf;
+
+    for (int t = 0; t < mis_towers; t++) {
+        Uint8 *e = mis_table + t * MIS_ENTRYSIZE;
+        putlong(e, getlong(e) + datapos);
     }
 
-    /* write out the number of towers in this mission */
-    fseek(fmission, 0, SEEK_SET);
-    fread(&c, 1, 1, fmission);
+    memset(head, 0, MIS_HEADERSIZE);
+    memcpy(head, MIS_MAGIC, 8);
+    putword(head + 8, MIS_VERSION);
+    head[10] = mis_prio;
+    head[11] = strlen(mis_name);
+    memcpy(head + 12, mis_name, strlen(mis_name));
+    putlong(head + 44, mis_towers);
+    putlong(head + 48, checksum(mis_table, tablelen));
+    putlong(head + 60, checksum(head, 60));
+
+    if (tablelen)
+        memcpy(buf + MIS_HEADERSIZE, mis_table, tablelen);
+    if (mis_datalen)
+        memcpy(buf + datapos, mis_data, mis_datalen);
 
-    fseek(fmission, c + 2, SEEK_SET);
-    fwrite(&nmission, 1, 1, fmission);
+    char fname[200];
+    snprintf(fname, 200, "%s.ttm", mis_name);
 
-    /* write out index position */
-    c = idxpos & 0xff;
-    fwrite(&c, 1, 1, fmission);
-    c = (idxpos >> 8) & 0xff;
-    fwrite(&c, 1, 1, fmission);
-    c = (idxpos >> 16) & 0xff;
-    fwrite(&c, 1, 1, fmission);
-    c = (idxpos >> 24) & 0xff;
-    fwrite(&c, 1, 1, fmission);
+    bool ok = write_local_data_file(fname, buf, size);
 
-    fclose(fmission);
+    delete[] buf;
+    mis_free();
 
-    fmission = NULL;
+    return ok;
 }
 #endif
@@ -21,9 +21,19 @@
 
 #include <SDL_types.h>
 
+#include "demo.h"
+
 /* handles one mission with towers and the necessary manipulations
  on the towerlayout when the game is going on */
 
+/* the maximal height of a tower. The vertical positions of the
+ figures are 4 units per row and have to fit into 16 bits */
+#define LEV_MAXROWS 16000
+
+/* the most bytes lev_savestate() writes: the height and the number of
+ rows and then the row number and the 16 blocks of each changed row */
+#define LEV_MAXSTATE (2 + 2 + LEV_MAXROWS * (2 + 16))
+
 /* tower blocks.
  if you change these, also change towerblockdata[] in level.cc */
 typedef enum {
@@ -79,6 +89,20 @@ typedef enum {
     NUM_TPROBLEMS,
 } lev_problem;
 
+/* the properties of the blocks that lev_rowmask() returns a mask for */
+typedef enum {
+    TMASK_EMPTY, // not solid
+    TMASK_PLATFORM,
+    TMASK_STATION,
+    TMASK_DEADLY,
+    TMASK_ROBOT,
+    TMASK_STICK,
+    TMASK_BOX,
+    TMASK_DOOR,
+    TMASK_ELEVATOR,
+    NUM_TMASKS
+} lev_mask;
+
 /* tries to find all missions installed on this system
  * returns the number of missions found
  */
@@ -88,11 +112,29 @@ Uint16 lev_missionnumber();
 /* returns the name of the Nth mission */
 const char * lev_missionname(Uint16 num);
 
+/* returns the number of towers of the Nth mission and if it
+ * contains at least one tower with a demo, without loading it */
+Uint16 lev_missiontowers(Uint16 num);
+bool lev_missiondemo(Uint16 num);
+
+/* the towers with a demo of all missions. The list is built with the
+ * mission list from the mission index, so the demos can be found
+ * without loading the missions */
+typedef struct {
+    Uint16 mission; // number of the mission as for lev_loadmission()
+    Uint16 tower;
+    Uint32 length; // of the demo in ticks
+} lev_demoinfo;
+
+Uint32 lev_democount(void);
+const lev_demoinfo &lev_demo(Uint32 num);
+
 /* Convert a char into towerblock */
 Uint8 conv_char2towercode(wchar_t ch);
 
-/* Get tower password. Note that the password changes when
- the tower changes. */
+/* Get tower password. For towers selected from the mission this
+ is the password of the tower as stored in the mission, for loaded
+ or edited towers it changes when the tower changes. */
 const char *lev_get_passwd(void);
 /* Do we show the tower password to user at the beginning
  of current tower? */
@@ -104,17 +146,31 @@ int lev_tower_passwd_entry(const char *passwd);
 /* loads a mission from the file with the given name */
 bool lev_loadmission(Uint16 num);
 
+/* loads a mission in a background thread. lev_loadmission_ready()
+ * returns true when the thread is done, lev_loadmission_finish() then
+ * makes it the mission of the calling thread and returns what
+ * lev_loadmission() would have returned. Only one mission is loaded in
+ * the background, starting another one or lev_loadmission() drop it.
+ * When no thread can be started, the mission is read right away */
+void lev_loadmission_start(Uint16 num);
+bool lev_loadmission_ready(void);
+bool lev_loadmission_finish(void);
+
 /* free all the memory allocated by the mission and the mission list */
 void lev_done();
 
+/* free the memory of the mission and towers of the calling thread,
+ threads that loaded a mission call this before they end */
+void lev_donethread();
+
 /* clear the tower array */
 void lev_clear_tower(void);
 
 /* returns the number of towers that are in the current mission */
-Uint8 lev_towercount(void);
+Uint16 lev_towercount(void);
 
 /* selects one of the towers in this mission */
-void lev_selecttower(Uint8 number);
+void lev_selecttower(Uint16 number);
 
 /* returns the color for the current tower */
 Uint8 lev_towercol_red(void);
@@ -129,18 +185,26 @@ Uint8 lev_tower(Uint16 row, Uint8 column);
 Uint8 lev_set_tower(Uint16 row, Uint8 column, Uint8 block);
 
 /* returns the height of the tower */
-Uint8 lev_towerrows(void);
+Uint16 lev_towerrows(void);
 
 /* the name of the tower */
 char *lev_towername(void);
 void lev_set_towername(const char *str);
 
-/* tower demo */
-void lev_set_towerdemo(int demolen, Uint16 *demobuf);
-void lev_get_towerdemo(int &demolen, Uint16 *&demobuf);
+/* tower demo, the seed is the one of the game logic random numbers
+ the demo was recorded with. The demo is kept in the packed form of
+ demo.h, lev_set_towerdemo() packs the keys and frees demobuf, or
+ takes the demo that was recorded with the packer, the packer is empty
+ afterwards. lev_get_towerdemo() returns the length and a stream that
+ reads the keys from the start of the demo, it is valid until the
+ demo changes */
+void lev_set_towerdemo(int demolen, Uint16 *demobuf, Uint32 seed = 0);
+void lev_set_towerdemo(dem_packer &demo, Uint32 seed);
+void lev_get_towerdemo(int &demolen, dem_stream &demo);
+Uint32 lev_towerdemoseed(void);
 
 /* the number of the actual tower */
-Uint8 lev_towernr(void);
+Uint16 lev_towernr(void);
 
 /* returns true, if current tower is the last one */
 bool lev_lasttower(void);
@@ -155,7 +219,7 @@ Uint16 lev_towertime(void);
 void lev_set_towertime(Uint16 time);
 
 /* removes one layer of the tower (for destruction) */
-void lev_removelayer(Uint8 layer);
+void lev_removelayer(int layer);
 
 /* if the positions contains a vanishing step, remove it */
 void lev_removevanishstep(int row, int col);
@@ -211,6 +275,10 @@ void lev_stick2empty(int row, int col);
 void lev_empty2stick(int row, int col);
 void lev_platform2empty(int row, int col);
 
+/* returns a mask of the blocks in the row that have the given property,
+ bit n is set for column n. Rows outside of the tower are empty */
+Uint16 lev_rowmask(lev_mask kind, int row);
+
 /* checks the given figure for validity of its position (can
  it be there without colliding ?) */
 bool lev_testfigure(long angle, long vert, long back, long fore, long typ, long height, long width);
@@ -232,8 +300,22 @@ void lev_rotaterow(int row, bool clockwise);
 void lev_insertrow(int position);
 void lev_deleterow(int position);
 
+/* undo and redo for the editor. All changes to the tower are recorded
+ * in a journal, lev_undo_mark() ends one editing step, the steps are
+ * undone and redone as a whole. The journal keeps up to depth steps,
+ * within a fixed amount of memory. lev_undo_init() forgets all steps,
+ * call it for each new or loaded tower, a depth of 0 frees the journal.
+ * While paused, changes are not recorded, e.g. while the tower is
+ * played, it must be restored before the recording is continued
+ */
+void lev_undo_init(int depth);
+void lev_undo_mark(void);
+void lev_undo_pause(bool pause);
+bool lev_undo(void);
+bool lev_redo(void);
+
 /* creates a simple tower consisting of 'hei' rows */
-void lev_new(Uint8 hei);
+void lev_new(Uint16 hei);
 
 /* functions to change one field on the tower */
 void lev_putspace(int row, int col);
@@ -264,6 +346,13 @@ void lev_puttopstation(int row, int col);
 void lev_save(unsigned char *&data);
 void lev_restore(unsigned char *&data);
 
+/* snapshot support, see snapshot.h. Only the rows of the
+ * tower that differ from the tower as it was selected are
+ * saved, the rest of the tower doesn't change during the game
+ */
+void lev_savestate(unsigned char *&p);
+void lev_loadstate(const unsigned char *&p);
+
 /* check the tower for consistency. This function checks doors
  * and elevators, and if something is found, row and col contain the
  * coordinates, and the return value is one of TPROB_xxx
@@ -272,11 +361,13 @@ lev_problem lev_is_consistent(int &row, int &col);
 
 /* mission creation: first call mission_new(), then
  * for each tower mission_addtower() and finally to complete
- * the mission mission_finish(). never use another calling order
- * or you may create corrupted mission files.
+ * the mission mission_finish(). never use another calling order.
+ * The mission is collected in memory and mission_finish() writes
+ * the file, it returns false if that fails, an old file of the
+ * same name is only replaced by a complete new one
  */
 bool lev_mission_new(char * name, Uint8 prio = 255);
 void lev_mission_addtower(char * name);
-void lev_mission_finish();
+bool lev_mission_finish();
 
 #endif
@@ -30,6 +30,7 @@
 #include "menu.h"
 #include "txtsys.h"
 #include "configuration.h"
+#include "random.h"
 
 #include <stdlib.h>
 #include <string.h>
@@ -86,6 +87,8 @@ typedef enum {
     EDACT_CUTROW,
     EDACT_PASTEROW,
     EDACT_TOGGLEROBOT,
+    EDACT_UNDO,
+    EDACT_REDO,
 
     NUMEDITORACTIONS
 }key_actions;
@@ -112,7 +115,8 @@ const char *_ed_key_actions[NUMEDITORACTIONS] = {N_("Quit"), N_("Move up"), N_("
     N_("Increase time"), N_("Decrease time"), N_("Create mission"), N_("Move page up"),
     N_("Move page down"), N_("Go to start"), N_("Show this help"), N_("Name the tower"),
     N_("Set tower time"), N_("Record demo"), N_("Play demo"), N_("Adjust tower height"),
-    N_("Go to end"), N_("Cut row"), N_("Paste row"), N_("Change robot type")};
+    N_("Go to end"), N_("Cut row"), N_("Paste row"), N_("Change robot type"),
+    N_("Undo"), N_("Redo")};
 
 const struct _ed_key _ed_keys[] = { {EDACT_QUIT, SDLK_ESCAPE}, {EDACT_SHOWKEYHELP, SDLK_F1}, {
         EDACT_SHOWKEYHELP, SDLK_h, 'h'}, {EDACT_MOVEUP, SDLK_UP}, {EDACT_MOVEDOWN, SDLK_DOWN},
@@ -135,7 +139,7 @@ const struct _ed_key _ed_keys[] = { {EDACT_QUIT, SDLK_ESCAPE}, {EDACT_SHOWKEYHEL
         EDACT_SETTIME, SDLK_b, 'b'}, {EDACT_INCTIME, SDLK_n, 'n'}, {EDACT_DECTIME,
         SDLK_n, 'N', KMOD_SHIFT}, {EDACT_CREATEMISSION, SDLK_m, 'm'}, {EDACT_NAMETOWER,
         SDLK_t, 't'}, {EDACT_REC_DEMO, SDLK_F10}, {EDACT_PLAY_DEMO, SDLK_F11}, {
-        EDACT_ADJHEIGHT, SDLK_F8}};
+        EDACT_ADJHEIGHT, SDLK_F8}, {EDACT_UNDO, SDLK_u, 'u'}, {EDACT_REDO, SDLK_r, 'r'}};
 
 static int bg_row;
 static int bg_col;
@@ -316,17 +320,32 @@ static bool edit_towercolor(int row, int col) {
     return (!oldpal && ((curc[0] != oldc[0]) || (curc[1] != oldc[1]) || (curc[2] != oldc[2])));
 }
 
+/* translated where they are shown, gettext isn't set up yet when
+ * this array is initialized */
+static const char *problemstr[NUM_TPROBLEMS] = {N_("No problems found"), N_("No starting step"),
+    N_("Start is blocked"), N_("Unknown block"), N_("No elevator stop"),
+    N_("Elevator is blocked"), N_("No opposing doorway"), N_("Broken doorway"),
+    N_("No exit"), N_("Exit is unreachable"), N_("Not enough time"),
+    N_("Tower is too short"), N_("Tower has no name")};
+
+/* the y position of a row in the bar at the right side of the screen,
+ * the bar has one pixel for each row, unless the tower is too high */
+static int bar_y(int row) {
+    int rows = (lev_towerrows() > SCREEN_HEIGHT) ? lev_towerrows() : SCREEN_HEIGHT;
+    return SCREEN_HEIGHT - (row * SCREEN_HEIGHT) / rows;
+}
+
+/* marks one row in that bar */
+static void bar_mark(int row, Uint8 r, Uint8 g, Uint8 b, Uint8 a) {
+    int y = bar_y(row + 1);
+    scr_putbar(SCREEN_WIDTH - 8, y, 8, (bar_y(row) > y) ? bar_y(row) - y : 1, r, g, b, a);
+}
+
 static void edit_checktower(int &row, int &col) {
     int r, c, pr;
     r = row;
     c = -col;
 
-    static const char *problemstr[NUM_TPROBLEMS] = {_("No problems found"), _("No starting step"),
-        _("Start is blocked"), _("Unknown block"), _("No elevator stop"),
-        _("Elevator is blocked"), _("No opposing doorway"), _("Broken doorway"),
-        _("No exit"), _("Exit is unreachable"), _("Not enough time"),
-        _("Tower is too short"), _("Tower has no name")};
-
     pr = lev_is_consistent(r, c);
     if ((r >= lev_towerrows()) && (lev_towerrows() > 0))
     r = lev_towerrows() - 1;
@@ -335,7 +354,7 @@ static void edit_checktower(int &row, int &col) {
 
     bg_text = _("Tower check:");
     bg_darken = true;
-    men_info(problemstr[pr % NUM_TPROBLEMS], 50, 2);
+    men_info(_(problemstr[pr % NUM_TPROBLEMS]), 50, 2);
     bg_darken = false;
     row = bg_row;
     col = bg_col;
@@ -356,6 +375,22 @@ char *keymod2str(Uint16 kmod) {
     return buf;
 }
 
+static void missionError(void) {
+    scr_drawedit(0, 0, false);
+    scr_writetext_center(30, _("Mission creation"));
+
+    scr_writetext_center(80, _("could not create file"));
+    scr_writetext_center(110, _("aborting"));
+
+    scr_swap();
+
+    int inp;
+
+    do {
+        inp = key_chartyped();
+    }while (!inp);
+}
+
 static void createMission(void) {
 
     scr_drawedit(0, 0, false);
@@ -374,21 +409,7 @@ static void createMission(void) {
     return;
 
     if (!lev_mission_new(missionname)) {
-
-        scr_drawedit(0, 0, false);
-        scr_writetext_center(30, _("Mission creation"));
-
-        scr_writetext_center(80, _("could not create file"));
-        scr_writetext_center(110, _("aborting"));
-
-        scr_swap();
-
-        int inp;
-
-        do {
-            inp = key_chartyped();
-        }while (!inp);
-
+        missionError();
         return;
     }
 
@@ -417,7 +438,8 @@ static void createMission(void) {
         currenttower++;
     }
 
-    lev_mission_finish();
+    if (!lev_mission_finish())
+    missionError();
 
     lev_findmissions();
 }
@@ -518,6 +540,8 @@ void le_edit(void) {
     int blink_r = 70, blink_g = 40, blink_b = 10;
     char status[80];
     int towerstarthei;
+    int prob_r, prob_c;
+    lev_problem prob;
     int pagesize;
 
     if (config.editor_towerstarthei() < 0)
@@ -525,7 +549,7 @@ void le_edit(void) {
     else
     towerstarthei = TOWERSTARTHEI + config.editor_towerstarthei();
 
-    lev_new(towerstarthei % 256);
+    lev_new(towerstarthei % LEV_MAXROWS);
 
     if (config.editor_towerpagesize() < 1) {
         config.editor_towerpagesize(TOWERPAGESIZE);
@@ -543,6 +567,8 @@ void le_edit(void) {
     lev_set_towername("");
     lev_set_towerdemo(0, NULL);
 
+    lev_undo_init(config.editor_undodepth());
+
     while (!ende) {
 
         bg_row = row;
@@ -555,12 +581,21 @@ void le_edit(void) {
         snprintf(status, 80, "%c~t050X%d~t150Y%d~t250%s:%d", changed ? '*' : ' ', -col & 0xf, row,
                 _("cut#"), clipboard_rows);
 
-        scr_putbar(SCREEN_WIDTH - 8, SCREEN_HEIGHT - lev_towerrows(), 8, lev_towerrows(),
+        scr_putbar(SCREEN_WIDTH - 8, bar_y(lev_towerrows()), 8, SCREEN_HEIGHT - bar_y(lev_towerrows()),
                 lev_towercol_red(), lev_towercol_green(), lev_towercol_blue(), 255);
-        scr_putbar(SCREEN_WIDTH - 8, SCREEN_HEIGHT - row - 1, 8, 1, blink_r, blink_g, blink_b, 128);
+        bar_mark(row, blink_r, blink_g, blink_b, 128);
 
         scr_color_ramp(&blink_r, &blink_g, &blink_b);
 
+        /* the check only looks at the parts of the tower changed since
+         * the last frame, so the problems can be shown all the time */
+        prob = lev_is_consistent(prob_r, prob_c);
+        if (prob != TPROB_NONE) {
+            if ((prob_r < lev_towerrows()) && (prob < TPROB_NOEXIT || prob == TPROB_UNREACHABLEEXIT))
+            bar_mark(prob_r, 255, 0, 0, 255);
+            scr_writetext_center(5, _(problemstr[prob % NUM_TPROBLEMS]));
+        }
+
         scr_writeformattext(0, SCREEN_HEIGHT - FONT_HEIGHT, status);
 
         scr_swap();
@@ -746,6 +781,7 @@ void le_edit(void) {
                         && lev_loadtower(config.editor_towername())) {
                     scr_settowercolor(lev_towercol_red(), lev_towercol_green(),
                             lev_towercol_blue());
+                    lev_undo_init(config.editor_undodepth());
                     changed = false;
                 }
                 if (row >= lev_towerrows())
@@ -773,18 +809,21 @@ void le_edit(void) {
                     Uint16 dummy2;
                     unsigned char *p;
                     int demolen = -1;
-                    Uint16 *demobuf = NULL;
+                    dem_packer demo;
                     int speed = dcl_update_speed(config.game_speed());
                     lev_set_towerdemo(0, NULL);
                     lev_save(p);
+                    lev_undo_pause(true);
                     gam_newgame();
                     rob_initialize();
                     snb_init();
+                    dem_pack_start(demo);
                     ttsounds::instance()->startsound(SND_WATER);
-                    gam_towergame(dummy1, dummy2, demolen, &demobuf);
+                    gam_towergame(dummy1, dummy2, demolen, &demo);
                     ttsounds::instance()->stopsound(SND_WATER);
                     lev_restore(p);
-                    lev_set_towerdemo(demolen, demobuf);
+                    lev_undo_pause(false);
+                    lev_set_towerdemo(demo, rnd_getseed(RND_GAME));
                     key_readkey();
                     set_men_bgproc(editor_background_proc);
                     dcl_update_speed(speed);
@@ -792,21 +831,19 @@ void le_edit(void) {
                 break;
                 case EDACT_PLAY_DEMO: {
                     int demolen = 0;
-                    Uint16 *demobuf = NULL;
-                    lev_get_towerdemo(demolen, demobuf);
+                    dem_stream demo;
+                    lev_get_towerdemo(demolen, demo);
                     if (demolen > 0) {
-                        Uint8 dummy1;
-                        Uint16 dummy2;
                         unsigned char *p;
                         int speed = dcl_update_speed(config.game_speed());
                         lev_save(p);
+                        lev_undo_pause(true);
                         gam_newgame();
-                        rob_initialize();
-                        snb_init();
                         ttsounds::instance()->startsound(SND_WATER);
-                        gam_towergame(dummy1, dummy2, demolen, &demobuf);
+                        gam_demoplayer(demolen, demo);
                         ttsounds::instance()->stopsound(SND_WATER);
                         lev_restore(p);
+                        lev_undo_pause(false);
                         key_readkey();
                         set_men_bgproc(editor_background_proc);
                         dcl_update_speed(speed);
@@ -824,6 +861,7 @@ void le_edit(void) {
                     Uint16 *dummybuf = NULL;
                     unsigned char *p;
                     lev_save(p);
+                    lev_undo_pause(true);
                     gam_newgame();
                     rob_initialize();
                     snb_init();
@@ -831,6 +869,7 @@ void le_edit(void) {
                     gam_towergame(dummy1, dummy2, dummy3, &dummybuf);
                     ttsounds::instance()->stopsound(SND_WATER);
                     lev_restore(p);
+                    lev_undo_pause(false);
                     key_readkey();
                     set_men_bgproc(editor_background_proc);
                     dcl_update_speed(speed);
@@ -899,7 +938,7 @@ void le_edit(void) {
                                 row--;
                             }
                         } else {
-                            while ((i < 255) && (i > lev_towerrows())) {
+                            while ((i < LEV_MAXROWS) && (i > lev_towerrows())) {
                                 lev_insertrow(row);
                             }
                         }
@@ -973,10 +1012,23 @@ void le_edit(void) {
                 case EDACT_TOGGLEROBOT:
                 lev_set_robotnr((lev_robotnr() + 1) % scr_numrobots());
                 break;
+                case EDACT_UNDO:
+                case EDACT_REDO:
+                if ((action == EDACT_UNDO) ? lev_undo() : lev_redo()) {
+                    if (row >= lev_towerrows())
+                    row = lev_towerrows() - 1;
+                    changed = true;
+                }
+                break;
                 default:
                 break;
             }
+
+            /* everything changed by one action is undone together */
+            lev_undo_mark();
         }
     }
+
+    lev_undo_init(0);
 }
 #endif
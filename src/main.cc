@@ -18,18 +18,33 @@
 
 #include "game.h"
 #include "archi.h"
+#include "assetpack.h"
 #include "menu.h"
 #include "decl.h"
 #include "sound.h"
 #include "level.h"
 #include "configuration.h"
 #include "highscore.h"
+#include "timing.h"
+#include "random.h"
+#include "toppler.h"
+#include "keyb.h"
+#include "bonus.h"
+#include "points.h"
 
 #include <stdlib.h>
 #include <time.h>
 #include <string.h>
 #include <unistd.h>
 
+#ifdef __BLACKBERRY__
+#else
+#ifndef WIN32
+#include <sys/types.h>
+#include <sys/wait.h>
+#endif
+#endif
+
 #include <stdexcept>
 #if 0
 #include <eula.h>
@@ -43,9 +58,13 @@
 
 #ifdef __BLACKBERRY__
 #else
+/* the mission given with -r and the journal given with -j */
+static const char *replay_mission = NULL;
+static const char *replay_journal = NULL;
+
 static void printhelp(void) {
     printf(
-            _("\n\tOptions:\n\n  -f\tEnable fullscreen mode\n  -s\tSilence, disable all sound\n  -dX\tSet debug level to X  (default: %i)\n"),
+            _("\n\tOptions:\n\n  -f\tEnable fullscreen mode\n  -s\tSilence, disable all sound\n  -dX\tSet debug level to X  (default: %i)\n  -tFILE\tWrite the startup timeline to FILE\n  -bN\tBenchmark: start N times up to the first menu frame\n  -rNAME\tReplay the demos of mission NAME without window and sound\n  -jFILE\tReplay the towers of the game journal FILE the same way\n"),
             config.debug_level());
 }
 
@@ -60,8 +79,17 @@ static bool parse_arguments(int argc, char *argv[]) {
             if (parm >= '0' && parm <= '9') {
                 printf(_("Debug level is now %c.\n"), parm);
                 config.debug_level(parm - '0');
+                tim_report(parm != '0');
             } else
                 printf(_("Illegal debug level value, using default.\n"));
+        } else if (!strncmp(argv[t], "-t", 2) && argv[t][2])
+            tim_reportfile(argv[t] + 2);
+        else if (!strncmp(argv[t], "-r", 2) && argv[t][2])
+            replay_mission = argv[t] + 2;
+        else if (!strncmp(argv[t], "-j", 2) && argv[t][2])
+            replay_journal = argv[t] + 2;
+        else if (!strncmp(argv[t], "-b", 2) && atoi(argv[t] + 2) > 0) {
+            /* handled by benchmark() */
         } else {
             printhelp();
             return false;
@@ -69,13 +97,248 @@ static bool parse_arguments(int argc, char *argv[]) {
     }
     return true;
 }
+
+/* starts the game the given number of times without window and sound
+ * output up to the first frame of the menu and prints how long each
+ * start took. Only the started copies of the game return from here
+ */
+static void benchmark(int argc, char *argv[]) {
+    int runs = 0;
+
+    for (int t = 1; t < argc; t++)
+        if (!strncmp(argv[t], "-b", 2))
+            runs = atoi(argv[t] + 2);
+
+    if (runs <= 0)
+        return;
+
+#ifndef WIN32
+    double sum = 0, best = 0;
+
+    for (int r = 0; r < runs; r++) {
+        int fds[2];
+        double ms = -1;
+
+        fflush(stdout);
+        assert_msg(pipe(fds) == 0, "could not create pipe for benchmark");
+
+        pid_t pid = fork();
+        assert_msg(pid >= 0, "could not start benchmark run");
+
+        if (pid == 0) {
+            close(fds[0]);
+            setenv("SDL_VIDEODRIVER", "dummy", 1);
+            setenv("SDL_AUDIODRIVER", "dummy", 1);
+            if (!freopen("/dev/null", "w", stdout))
+                exit(1);
+            tim_benchmark(fds[1]);
+            return;
+        }
+
+        close(fds[1]);
+        FILE *in = fdopen(fds[0], "r");
+        if (in) {
+            if (fscanf(in, "%lf", &ms) != 1)
+                ms = -1;
+            fclose(in);
+        }
+        waitpid(pid, NULL, 0);
+
+        if (ms < 0) {
+            printf(_("Benchmark run %i failed.\n"), r + 1);
+            exit(1);
+        }
+
+        printf(_("run %i: %.3f ms to the first menu frame\n"), r + 1, ms);
+
+        sum += ms;
+        if ((r == 0) || (ms < best))
+            best = ms;
+    }
+
+    printf(_("average %.3f ms, best %.3f ms\n"), sum / runs, best);
+#else
+    printf(_("Benchmarking is not supported on this system.\n"));
+#endif
+
+    exit(0);
+}
+
+/* loads the mission with the given name */
+static bool load_mission(const char *name) {
+    Uint16 m;
+
+    for (m = 0; m < lev_missionnumber(); m++)
+        if (!strcmp(lev_missionname(m), name))
+            break;
+
+    if ((m == lev_missionnumber()) || !lev_loadmission(m)) {
+        printf(_("Mission %s not found.\n"), name);
+        return false;
+    }
+    return true;
+}
+
+/* plays the demos of all towers of the given mission with the
+ * simulation and prints the outcome of each of them. Returns false
+ * when the mission could not be loaded
+ */
+static bool replay(const char *name) {
+    lev_findmissions();
+
+    if (!load_mission(name)) {
+        lev_done();
+        return false;
+    }
+
+    for (Uint16 t = 0; t < lev_towercount(); t++) {
+        int demolen;
+        dem_stream demo;
+        gam_simresult res;
+
+        lev_selecttower(t);
+        lev_get_towerdemo(demolen, demo);
+
+        if (!demolen) {
+            printf(_("tower %i: no demo\n"), t + 1);
+            continue;
+        }
+
+        gam_newgame();
+        gam_simulate(demo, demolen, lev_towerdemoseed(), res);
+
+        const char *outcome;
+        switch (res.result) {
+        case GAME_FINISHED:
+            outcome = _("finished");
+            break;
+        case GAME_DIED:
+            outcome = res.timeout ? _("time over") : _("died");
+            break;
+        default:
+            outcome = _("demo ended");
+            break;
+        }
+
+        printf(_("tower %i: %s after %i frames, time left %i, points %u, technique %i\n"),
+                t + 1, outcome, res.frames, res.resttime, res.points, res.technic);
+    }
+
+    lev_done();
+    return true;
+}
+
+static void print_session(int tower, int frames, const snp_loop &loop) {
+    const char *outcome;
+
+    if (top_targetreached())
+        outcome = _("finished");
+    else if (top_died())
+        outcome = _("died");
+    else
+        outcome = _("aborted");
+
+    printf(_("tower %i: %s after %i frames, time left %i\n"), tower + 1, outcome, frames,
+            loop.time);
+}
+
+/* plays the towers of a session journal with the simulation, the keys
+ * are taken directly from the journal blocks */
+static bool replay_session(const char *fname) {
+    FILE *in = fopen(fname, "rb");
+    Uint8 magic[8], kind;
+    Uint8 *data = new Uint8[DEM_CHUNKSIZE];
+    Uint32 size;
+    snp_loop loop;
+    bool intower = false, inbonus = false, playing = false, ok = true;
+    int tower = 0, frames = 0;
+    unsigned int points = 0;
+
+    if (!in || (fread(magic, 8, 1, in) != 1) || memcmp(magic, DEM_JNL_MAGIC, 8)) {
+        printf(_("%s is no game journal.\n"), fname);
+        if (in)
+            fclose(in);
+        delete[] data;
+        return false;
+    }
+
+    lev_findmissions();
+
+    while (ok && dem_journal_read(in, kind, data, size)) {
+
+        /* the keys of a tower end with the next marker */
+        if ((kind != DEM_JNL_KEYS) && intower) {
+            print_session(tower, frames, loop);
+            intower = false;
+        }
+        if ((kind != DEM_JNL_KEYS) && inbonus) {
+            printf(_("bonus game before tower %i: %u points\n"), tower + 1, pts_points() - points);
+            inbonus = false;
+        }
+
+        switch (kind) {
+        case DEM_JNL_SESSION:
+            data[size < DEM_CHUNKSIZE ? size : DEM_CHUNKSIZE - 1] = 0;
+            ok = load_mission((char *) data);
+            gam_newgame();
+            break;
+        case DEM_JNL_TOWER:
+            tower = data[0] + (data[1] << 8);
+            lev_selecttower(tower);
+            gam_simstart(data[2] + (data[3] << 8) + (data[4] << 16) + ((Uint32) data[5] << 24),
+                    loop, (size > 6) ? data[6] : DEFAULT_ROBOTS);
+            intower = playing = true;
+            frames = 0;
+            break;
+        case DEM_JNL_BONUS:
+            tower = data[0] + (data[1] << 8);
+            bns_simstart(data[2] + (data[3] << 8) + (data[4] << 16) + ((Uint32) data[5] << 24));
+            points = pts_points();
+            inbonus = playing = true;
+            break;
+        case DEM_JNL_KEYS:
+            if (intower || inbonus) {
+                dem_stream keys;
+
+                dem_start(keys, data, size);
+                while (playing && !dem_ended(keys)) {
+                    if (intower) {
+                        playing = gam_simstep(dem_next(keys), loop);
+                        frames++;
+                    } else
+                        playing = bns_simstep(dem_next(keys));
+                }
+            }
+            break;
+        default:
+            break;
+        }
+    }
+
+    if (intower)
+        print_session(tower, frames, loop);
+    if (inbonus)
+        printf(_("bonus game before tower %i: %u points\n"), tower + 1, pts_points() - points);
+
+    fclose(in);
+    delete[] data;
+    lev_done();
+    return ok;
+}
 #endif
 
 static void startgame(void) {
     lev_findmissions();
+    tim_mark("missions");
     gam_init();
+    tim_mark("graphics");
     men_init();
+    tim_mark("menu");
+    /* all sprites are loaded, keep them for the next start */
+    pak_cache_finish();
+    tim_mark("sprite cache");
     snd_init();
+    tim_mark("sound");
     snd_playTitle();
     men_main();
     snd_stopTitle();
@@ -94,7 +357,15 @@ int main(int argc, char *argv[]) {
         return 1;
     }
 #endif
+#ifdef __BLACKBERRY__
+#else
+    benchmark(argc, argv);
+#endif
+    /* start the clock for the startup timeline */
+    tim_ms();
+
     dataarchive = new archive(open_data_file("toppler.dat"));
+    tim_mark("archive");
 #if ENABLE_NLS == 1
     setlocale(LC_MESSAGES, "");
     setlocale(LC_CTYPE, "");
@@ -112,11 +383,17 @@ int main(int argc, char *argv[]) {
     printf("hsc init\n");
 #endif
     hsc_init();
+    tim_mark("highscores");
 #ifdef __BLACKBERRY__
 #else
     if (parse_arguments(argc, argv)) {
+        if (replay_mission)
+            return replay(replay_mission) ? 0 : 1;
+        if (replay_journal)
+            return replay_session(replay_journal) ? 0 : 1;
 #endif
         SDL_InitSubSystem(SDL_INIT_VIDEO);
+        tim_mark("video");
 #ifdef __BLACKBERRY__
         SDL_ShowCursor(SDL_DISABLE);
 #else
@@ -126,10 +403,13 @@ int main(int argc, char *argv[]) {
         tt_has_focus = true;
         atexit(QuitFunction);
         srand(time(0));
+        rnd_seed(RND_COSMETIC, time(0));
         startgame();
 #ifdef __BLACKBERRY__
 #else
         printf(_("Thanks for playing!\n"));
+        if (config.debug_level())
+            key_printlatency(stdout);
         SDL_ShowCursor(mouse);
 #endif
         SDL_Quit();
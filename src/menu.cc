@@ -23,6 +23,7 @@
 #include "bonus.h"
 #include "sprites.h"
 #include "archi.h"
+#include "assetpack.h"
 #include "screen.h"
 #include "keyb.h"
 #include "decl.h"
@@ -38,8 +39,12 @@
 
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
 #define NUMHISCORES 10
+
+/* number of menu frames without a key until a demo is shown */
+#define DEMO_TIMEOUT 500
 #define HISCORES_PER_PAGE 5
 
 static unsigned short menupicture, titledata;
@@ -54,6 +59,7 @@ static void men_reload_sprites(Uint8 what) {
         file fi(dataarchive, menudat);
 
         scr_read_palette(&fi, pal);
+        pak_beginsection(PAK_SEC_MENU, false);
         menupicture = scr_loadsprites(&restsprites, &fi, 1, 640, 480, false, pal, 0);
         if(menupicture) {
             SDL_Surface * s = SDL_ConvertSurface(restsprites.data(menupicture), display->format, 0);
@@ -67,6 +73,7 @@ static void men_reload_sprites(Uint8 what) {
         file fi(dataarchive, titledat);
 
         scr_read_palette(&fi, pal);
+        pak_beginsection(PAK_SEC_TITLE, config.use_alpha_font());
         titledata = scr_loadsprites(&fontsprites, &fi, 1, SPR_TITLEWID, SPR_TITLEHEI, true, pal,
                 config.use_alpha_font());
     }
@@ -254,6 +261,20 @@ game_options_bonus(_menusystem *ms) {
     return txt;
 }
 
+static const char *
+game_options_journal(_menusystem *ms) {
+    static char txt[30];
+    if (ms) {
+        config.journal(!config.journal());
+    }
+    if (config.journal())
+        sprintf(txt, "%s %c", _("Record Games"), 4);
+    else
+        sprintf(txt, "%s %c", _("Record Games"), 3);
+
+    return txt;
+}
+
 static const char *men_game_options_menu(_menusystem *prevmenu) {
     static const char * s = _("Game Options");
     if (prevmenu) {
@@ -266,6 +287,7 @@ static const char *men_game_options_menu(_menusystem *prevmenu) {
         ms = add_menu_option(ms, NULL, game_options_menu_speed, SDLK_UNKNOWN,
                 (menuoptflags) ((int) MOF_PASSKEYS | (int) MOF_LEFT));
         ms = add_menu_option(ms, NULL, game_options_bonus);
+        ms = add_menu_option(ms, NULL, game_options_journal);
 
         ms = add_menu_option(ms, NULL, NULL);
         ms = add_menu_option(ms, _("Back"), NULL);
@@ -837,7 +859,7 @@ static void men_highscore(unsigned long pt, int twr) {
 }
 
 static void main_game_loop() {
-    unsigned char tower;
+    Uint16 tower;
     Uint8 anglepos = 0;
     Uint16 resttime = 0;
     int demo = 0;
@@ -855,6 +877,17 @@ static void main_game_loop() {
 
     tower = lev_tower_passwd_entry(config.curr_password());
 
+    if (config.journal()) {
+        char fname[40];
+        time_t now = time(NULL);
+
+        strftime(fname, sizeof(fname), "journal-%Y%m%d-%H%M%S.ttj", localtime(&now));
+        if (dem_journal_start(fname)) {
+            const char *name = lev_missionname(currentmission);
+            dem_journal_mark(DEM_JNL_SESSION, (const Uint8 *) name, strlen(name));
+        }
+    }
+
     gam_newgame();
     bns_restart();
 
@@ -888,6 +921,8 @@ static void main_game_loop() {
         }
     } while (pts_lifesleft() && (tower < lev_towercount()) && (gameresult != GAME_ABORTED));
 
+    dem_journal_stop();
+
     if (gameresult != GAME_ABORTED)
         men_highscore(pts_points(), (tower >= lev_towercount()) ? tower : -1);
 }
@@ -956,40 +991,49 @@ men_main_leveleditor_proc(_menusystem *ms) {
 }
 #endif
 
+/* the first time the timer runs out, a tower is chosen from the demo
+ * index and its mission is loaded in the background. Until it is
+ * there, the timer is checked in each frame, so the menu keeps moving */
 static const char *
 men_main_timer_proc(_menusystem *ms) {
     if (ms) {
-        Uint8 num_demos = 0;
-        Uint8 demos[256];
-        Uint16 miss = rand() % lev_missionnumber();
-        Uint8 num_towers;
+        static bool loading = false;
+        static Uint16 demo;
 
         int demolen;
-        Uint16 *demobuf;
+        dem_stream demobuf;
         Uint8 anglepos;
         Uint16 resttime;
 
-        for (int tmpm = 0; (tmpm < lev_missionnumber()) && (num_demos == 0); tmpm++) {
-            Uint16 tmiss = (miss + tmpm) % lev_missionnumber();
+        if (!loading) {
+            if (!lev_democount())
+                return NULL;
 
-            if (lev_loadmission(tmiss)) {
-                num_towers = lev_towercount();
+            /* each of the towers with a demo is taken with the same chance */
+            const lev_demoinfo &d = lev_demo(rand() % lev_democount());
 
-                for (Uint8 idx = 0; (idx < num_towers) && (num_demos < 256); idx++) {
-                    lev_selecttower(idx);
-                    lev_get_towerdemo(demolen, demobuf);
-                    if (demolen)
-                        demos[num_demos++] = idx;
-                }
-            }
+            demo = d.tower;
+            lev_loadmission_start(d.mission);
+            loading = true;
+            ms->mtime = 0;
+            return NULL;
         }
 
-        if (num_demos < 1)
+        if (!lev_loadmission_ready())
             return NULL;
 
-        lev_selecttower(demos[rand() % num_demos]);
+        loading = false;
+        ms->mtime = DEMO_TIMEOUT;
+
+        if (!lev_loadmission_finish() || (demo >= lev_towercount()))
+            return NULL;
+
+        lev_selecttower(demo);
         lev_get_towerdemo(demolen, demobuf);
 
+        if (!demolen)
+            return NULL;
+
         dcl_update_speed(config.game_speed());
         gam_newgame();
         ttsounds::instance()->startsound(SND_WATER);
@@ -1044,7 +1088,7 @@ void men_main() {
     _menusystem *ms;
 
     ms = new_menu_system(NULL, men_main_background_proc, 0, fontsprites.data(titledata)->h + 60);
-    ms = set_menu_system_timeproc(ms, 500, men_main_timer_proc);
+    ms = set_menu_system_timeproc(ms, DEMO_TIMEOUT, men_main_timer_proc);
 
     ms = add_menu_option(ms, NULL, men_main_startgame_proc, SDLK_s, MOF_PASSKEYS);
     ms = add_menu_option(ms, NULL, NULL);
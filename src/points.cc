@@ -19,10 +19,11 @@
 #include "points.h"
 #include "decl.h"
 #include "configuration.h"
+#include "snapshot.h"
 
-static unsigned int points;
-static unsigned long nextlife;
-static int lifes;
+static GAME_STATE unsigned int points;
+static GAME_STATE unsigned long nextlife;
+static GAME_STATE int lifes;
 
 #define LIFE_INCREMENT 5000
 
@@ -63,3 +64,14 @@ bool pts_lifesleft(void) {
     return lifes != 0;
 }
 
+void pts_savestate(unsigned char *&p) {
+    SNP_PUT(p, points);
+    SNP_PUT(p, nextlife);
+    SNP_PUT(p, lifes);
+}
+
+void pts_loadstate(const unsigned char *&p) {
+    SNP_GET(p, points);
+    SNP_GET(p, nextlife);
+    SNP_GET(p, lifes);
+}
@@ -40,4 +40,8 @@ void pts_died(void);
 /* returns true, if lives != 0 */
 bool pts_lifesleft(void);
 
+/* snapshot support, see snapshot.h */
+void pts_savestate(unsigned char *&p);
+void pts_loadstate(const unsigned char *&p);
+
 #endif
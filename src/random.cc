@@ -0,0 +1,64 @@
+/* Tower Toppler - Nebulus
+ * Copyright (C) 2000-2006  Andreas Rver
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+#include "random.h"
+#include "decl.h"
+#include "snapshot.h"
+
+/* used for the seed 0, xorshift would only produce zeros */
+#define ZERO_SEED 0x9e3779b9
+
+static GAME_STATE struct {
+    Uint32 state;
+    Uint32 seed;
+} streams[NUM_RNDSTREAMS] = {
+    { ZERO_SEED, 0 },
+    { ZERO_SEED, 0 }
+};
+
+void rnd_seed(rnd_stream s, Uint32 seed) {
+    streams[s].seed = seed;
+    streams[s].state = seed ? seed : ZERO_SEED;
+}
+
+Uint32 rnd_getseed(rnd_stream s) {
+    return streams[s].seed;
+}
+
+Uint32 rnd_next(rnd_stream s) {
+    Uint32 x = streams[s].state;
+
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+
+    streams[s].state = x;
+    return x;
+}
+
+int rnd_range(rnd_stream s, int range) {
+    return (int) (((Uint64) rnd_next(s) * (Uint32) range) >> 32);
+}
+
+void rnd_savestate(unsigned char *&p) {
+    SNP_PUT(p, streams[RND_GAME]);
+}
+
+void rnd_loadstate(const unsigned char *&p) {
+    SNP_GET(p, streams[RND_GAME]);
+}
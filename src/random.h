@@ -0,0 +1,54 @@
+/* Tower Toppler - Nebulus
+ * Copyright (C) 2000-2006  Andreas Rver
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+#ifndef RANDOM_H
+#define RANDOM_H
+
+#include <SDL_types.h>
+
+/* a small and fast random number generator (xorshift) with separate
+ * streams. The game logic uses its own stream, that is seeded at the start
+ * of each tower, so a game can be reproduced from the seed and the keys.
+ * Everything that only changes what is shown on the screen uses the
+ * cosmetic stream and so never changes the game
+ */
+
+typedef enum {
+    RND_GAME, // everything that changes the game, robots, bonus game
+    RND_COSMETIC, // stars and other eye candy
+    NUM_RNDSTREAMS
+} rnd_stream;
+
+/* restart the stream with the given seed, every seed is valid */
+void rnd_seed(rnd_stream s, Uint32 seed);
+
+/* the seed the stream was last started with */
+Uint32 rnd_getseed(rnd_stream s);
+
+/* the next 32 bit random number of the stream */
+Uint32 rnd_next(rnd_stream s);
+
+/* a random number from 0 to range-1 */
+int rnd_range(rnd_stream s, int range);
+
+/* snapshot support, see snapshot.h. Only the game logic stream
+ is part of the game state */
+void rnd_savestate(unsigned char *&p);
+void rnd_loadstate(const unsigned char *&p);
+
+#endif
@@ -20,41 +20,122 @@
 
 #include "decl.h"
 #include "level.h"
-#include "screen.h"
 #include "toppler.h"
 #include "sound.h"
+#include "events.h"
+#include "random.h"
+#include "snapshot.h"
 
 #include <stdlib.h>
 
-#define MAX_OBJECTS 4
+/* the robots, stored as one array for each field. Only the first
+ capacity entries are used, the number is set when a towergame starts */
+static GAME_STATE int capacity = DEFAULT_ROBOTS;
+
+/* the position of the robot */
+static GAME_STATE int obj_anglepos[MAX_ROBOTS];
+static GAME_STATE long obj_verticalpos[MAX_ROBOTS];
+
+/* what kind of robot it is, an under classification
+ and what kind it will be after the appearing animation */
+static GAME_STATE rob_kinds obj_kind[MAX_ROBOTS];
+static GAME_STATE long obj_subKind[MAX_ROBOTS];
+static GAME_STATE rob_kinds obj_futureKind[MAX_ROBOTS];
+
+/* a timer for the animations of the robots */
+static GAME_STATE long obj_time[MAX_ROBOTS];
+
+/* to find the robots near a position without checking all of them the
+ robots are sorted into bins by their position. Two figures can only
+ collide when they are less than 4 angle units and less than 8 vertical
+ units apart, so with bins of this size only the bin of a position and
+ its 8 neighbours need to be checked. The bins repeat every 8 bins in
+ both directions, robots farther away that land in the same bin are
+ sorted out by the real distance check */
+#define BIN_ANGLE_SHIFT 2
+#define BIN_VERTICAL_SHIFT 3
+#define BINS_PER_AXIS 8
+
+static GAME_STATE Sint8 bin_first[BINS_PER_AXIS * BINS_PER_AXIS];
+static GAME_STATE Sint8 obj_bin[MAX_ROBOTS];
+static GAME_STATE Sint8 obj_binnext[MAX_ROBOTS];
+static GAME_STATE Sint8 obj_binprev[MAX_ROBOTS];
+
+/* the object that is the cross, if there is one */
+static GAME_STATE int cross_nr;
+
+/* the position up to where the robots are worked out, the next robot
+ to appear is the first one in the row robots_ready from the column
+ robots_angle on */
+static GAME_STATE int robots_ready;
+static GAME_STATE int robots_angle;
 
-/* this field contains the robots */
-static struct {
+/* the data for the next cross that will appear */
+static GAME_STATE int next_cross_timer;
+static GAME_STATE int cross_direction;
+static GAME_STATE int nextcrosscolor;
 
-    /* the position of the robot */
-    int anglepos;
-    long verticalpos;
+/******** PRIVATE FUNCTIONS ********/
 
-    /* what kind of robot it is, an under classification
-     and what kind it will be after the appearing animation */
-    rob_kinds kind;
-    long subKind;
-    rob_kinds futureKind;
+static int binof(int angle, long vertical) {
+    return (((angle >> BIN_ANGLE_SHIFT) & (BINS_PER_AXIS - 1)) * BINS_PER_AXIS)
+            + ((vertical >> BIN_VERTICAL_SHIFT) & (BINS_PER_AXIS - 1));
+}
 
-    /* a timer for the animations of the robots */
-    long time;
-} object[MAX_OBJECTS];
+/* moves the robot into the bin for its current position, call this
+ after each change of the position */
+static void rebin(int nr) {
+    int b = binof(obj_anglepos[nr], obj_verticalpos[nr]);
 
-/* the position up to where the robots are worked out */
-static int robots_ready;
-static int robots_angle;
+    if (b == obj_bin[nr])
+        return;
 
-/* the data for the next cross that will appear */
-static int next_cross_timer;
-static int cross_direction;
-static int nextcrosscolor;
+    if (obj_bin[nr] != -1) {
+        if (obj_binprev[nr] != -1)
+            obj_binnext[obj_binprev[nr]] = obj_binnext[nr];
+        else
+            bin_first[obj_bin[nr]] = obj_binnext[nr];
+        if (obj_binnext[nr] != -1)
+            obj_binprev[obj_binnext[nr]] = obj_binprev[nr];
+    }
 
-/******** PRIVATE FUNCTIONS ********/
+    obj_bin[nr] = b;
+    obj_binprev[nr] = -1;
+    obj_binnext[nr] = bin_first[b];
+    if (bin_first[b] != -1)
+        obj_binprev[bin_first[b]] = nr;
+    bin_first[b] = nr;
+}
+
+/* returns true for the robots that other figures can collide with */
+static bool solid(int nr) {
+    return obj_kind[nr] != OBJ_KIND_CROSS && obj_kind[nr] != OBJ_KIND_NOTHING
+            && obj_kind[nr] != OBJ_KIND_DISAPPEAR && obj_kind[nr] != OBJ_KIND_APPEAR;
+}
+
+/* returns the robot with the lowest index, except nr, that is close
+ enough to the given position to collide with a figure there, or -1 */
+static int nearrobot(int angle, long vertical, int nr) {
+    int found = -1;
+
+    for (int da = -1; da <= 1; da++)
+        for (int dv = -1; dv <= 1; dv++) {
+            int t = bin_first[binof(angle + da * (1 << BIN_ANGLE_SHIFT),
+                    vertical + dv * (1 << BIN_VERTICAL_SHIFT))];
+
+            for (; t != -1; t = obj_binnext[t]) {
+                if ((t == nr) || ((found != -1) && (t > found)) || !solid(t))
+                    continue;
+
+                long i = angle - obj_anglepos[t];
+                long j = obj_verticalpos[t] - vertical;
+                if ((-4 < i) && (i < 4) && (-8 < j) && (j < 8))
+                    found = t;
+            }
+        }
+
+    return found;
+}
 
 /* returns the index of the figure the given figure (nr) collides
  with or -1 if there is no such object */
@@ -64,36 +145,30 @@ static int figurecollision(int nr) {
     static unsigned char collision[16] = { 0x1c, 0x3e, 0x3e, 0x7f, 0x7f, 0x7f, 0x7f, 0x7f, 0x7f,
             0x7f, 0x7f, 0x7f, 0x3e, 0x3e, 0x1c, 0x00 };
 
-    int t;
-    long i, j;
-
-    for (t = 0; t < MAX_OBJECTS; t++) {
-        if (t != nr && object[t].kind != OBJ_KIND_CROSS && object[t].kind != OBJ_KIND_NOTHING
-                && object[t].kind != OBJ_KIND_DISAPPEAR && object[t].kind != OBJ_KIND_APPEAR) {
-            i = object[nr].anglepos - object[t].anglepos;
-            j = object[t].verticalpos - object[nr].verticalpos;
-            if ((-4 < i) && (i < 4) && (-8 < j) && (j < 8)) {
-                if ((collision[j + 7] >> (i + 3)) & 1)
-                    return t;
-                else
-                    return -1;
-            }
-        }
-    }
-    return -1;
+    /* only the first robot close enough counts */
+    int t = nearrobot(obj_anglepos[nr], obj_verticalpos[nr], nr);
+
+    if (t == -1)
+        return -1;
+
+    long i = obj_anglepos[nr] - obj_anglepos[t];
+    long j = obj_verticalpos[t] - obj_verticalpos[nr];
+
+    return ((collision[j + 7] >> (i + 3)) & 1) ? t : -1;
 }
 
 /* returns true, if the robot cannot be at the given position without colliding
  with an element from the tower */
 static bool testroboter(int nr) {
-    return (!lev_testfigure((long) object[nr].anglepos, object[nr].verticalpos, -2L, 1L, 1L, 1L, 7L));
+    return (!lev_testfigure((long) obj_anglepos[nr], obj_verticalpos[nr], -2L, 1L, 1L, 1L, 7L));
 }
 
 /* makes the robot disappear when it falls into water */
 static void drown_robot(int nr) {
-    object[nr].verticalpos = 0;
-    object[nr].time = 0;
-    object[nr].kind = OBJ_KIND_DISAPPEAR;
+    obj_verticalpos[nr] = 0;
+    rebin(nr);
+    obj_time[nr] = 0;
+    obj_kind[nr] = OBJ_KIND_DISAPPEAR;
 }
 
 /* tests the underground of the given object (only used for freeze ball) returns
@@ -104,35 +179,34 @@ static void drown_robot(int nr) {
 static int test_robot_undergr(int nr) {
 
     int row, col;
-    row = object[nr].verticalpos / 4 - 1;
-    col = (object[nr].anglepos / 8) & 0xf;
+    row = obj_verticalpos[nr] / 4 - 1;
+    col = (obj_anglepos[nr] / 8) & 0xf;
 
-    if (lev_is_box(row, col))
+    if (lev_rowmask(TMASK_BOX, row) & (1 << col))
         return 0;
-    if (lev_is_platform(row, col) || lev_is_stick(row, col)) {
-        if (lev_is_elevator(row, col))
+    if ((lev_rowmask(TMASK_PLATFORM, row) | lev_rowmask(TMASK_STICK, row)) & (1 << col)) {
+        if (lev_rowmask(TMASK_ELEVATOR, row) & (1 << col))
             return 2;
         else
             return 0;
     }
 
-    if ((object[nr].anglepos & 7) < 2) {
-        if (lev_is_empty(row, (col - 1) & 0xf))
-            return 1;
-        if (lev_is_door(row, (col - 1) & 0xf))
+    /* the blocks of the row the robot falls through */
+    Uint16 open = lev_rowmask(TMASK_EMPTY, row) | lev_rowmask(TMASK_DOOR, row);
+
+    if ((obj_anglepos[nr] & 7) < 2) {
+        if (open & (1 << ((col - 1) & 0xf)))
             return 1;
-        if ((object[nr].subKind & 0x80) == 0)
+        if ((obj_subKind[nr] & 0x80) == 0)
             return 2;
         else
             return 0;
     }
 
-    if ((object[nr].anglepos & 7) > 6) {
-        if (lev_is_empty(row, (col + 1) & 0xf))
-            return 1;
-        if (lev_is_door(row, (col + 1) & 0xf))
+    if ((obj_anglepos[nr] & 7) > 6) {
+        if (open & (1 << ((col + 1) & 0xf)))
             return 1;
-        if ((object[nr].subKind & 0x80) == 0)
+        if ((obj_subKind[nr] & 0x80) == 0)
             return 0;
         else
             return 2;
@@ -144,18 +218,19 @@ static int test_robot_undergr(int nr) {
 /* update the position for the cross */
 static void updatecross(int t) {
 
-    object[t].anglepos += object[t].subKind;
-    object[t].time -= object[t].subKind;
+    obj_anglepos[t] += obj_subKind[t];
+    obj_time[t] -= obj_subKind[t];
+    rebin(t);
 
     /* after the cross reached the middle speed it up */
-    if (object[t].anglepos == 60)
-        object[t].subKind *= 2;
+    if (obj_anglepos[t] == 60)
+        obj_subKind[t] *= 2;
 
     /* if cross reached screenedge, remove it an reinitialize
      counter for next one */
-    if (((object[t].subKind > 0) && (object[t].anglepos >= 120))
-            || ((object[t].subKind < 0) && (object[t].anglepos <= 0))) {
-        object[t].kind = OBJ_KIND_NOTHING;
+    if (((obj_subKind[t] > 0) && (obj_anglepos[t] >= 120))
+            || ((obj_subKind[t] < 0) && (obj_anglepos[t] <= 0))) {
+        obj_kind[t] = OBJ_KIND_NOTHING;
         next_cross_timer = 125;
     }
 }
@@ -163,9 +238,9 @@ static void updatecross(int t) {
 /* remove objects that drop below the screen */
 static bool checkverticalposition(int verticalpos, int t) {
 
-    if (object[t].verticalpos + 48 < verticalpos) {
-        object[t].kind = OBJ_KIND_DISAPPEAR;
-        object[t].time = 0;
+    if (obj_verticalpos[t] + 48 < verticalpos) {
+        obj_kind[t] = OBJ_KIND_DISAPPEAR;
+        obj_time[t] = 0;
         return true;
     } else
         return false;
@@ -177,8 +252,8 @@ static bool checkverticalposition(int verticalpos, int t) {
 static bool checkvalidposition(int t) {
 
     if (testroboter(t)) {
-        object[t].kind = OBJ_KIND_DISAPPEAR;
-        object[t].time = 0;
+        obj_kind[t] = OBJ_KIND_DISAPPEAR;
+        obj_time[t] = 0;
         return true;
     } else
         return false;
@@ -189,12 +264,14 @@ static bool checkvalidposition(int t) {
  at an impossible position, reverse its direction and don't move it */
 static void moverobothorizontal(int t) {
 
-    object[t].anglepos += object[t].subKind;
-    object[t].anglepos &= 0x7f;
+    obj_anglepos[t] += obj_subKind[t];
+    obj_anglepos[t] &= 0x7f;
+    rebin(t);
     if (testroboter(t) || (figurecollision(t) != -1)) {
-        object[t].subKind = -object[t].subKind;
-        object[t].anglepos += object[t].subKind;
-        object[t].anglepos &= 0x7f;
+        obj_subKind[t] = -obj_subKind[t];
+        obj_anglepos[t] += obj_subKind[t];
+        obj_anglepos[t] &= 0x7f;
+        rebin(t);
     }
 
 }
@@ -202,52 +279,64 @@ static void moverobothorizontal(int t) {
 /******* PUBLIC FUNCTIONS *********/
 
 rob_kinds rob_kind(int nr) {
-    return object[nr].kind;
+    return obj_kind[nr];
 }
 int rob_time(int nr) {
-    return object[nr].time;
+    return obj_time[nr];
 }
 int rob_angle(int nr) {
-    return object[nr].anglepos;
+    return obj_anglepos[nr];
 }
 int rob_vertical(int nr) {
-    return object[nr].verticalpos;
+    return obj_verticalpos[nr];
 }
+int rob_count(void) {
+    return capacity;
+}
+
+void rob_initialize(int robots) {
 
-void rob_initialize(void) {
+    if (robots < 1)
+        robots = 1;
+    else if (robots > MAX_ROBOTS)
+        robots = MAX_ROBOTS;
+    capacity = robots;
 
-    for (int b = 0; b < MAX_OBJECTS; b++) {
-        object[b].kind = OBJ_KIND_NOTHING;
-        object[b].time = -1;
+    for (int b = 0; b < BINS_PER_AXIS * BINS_PER_AXIS; b++)
+        bin_first[b] = -1;
+
+    for (int b = 0; b < capacity; b++) {
+        obj_kind[b] = OBJ_KIND_NOTHING;
+        obj_time[b] = -1;
+        obj_anglepos[b] = 0;
+        obj_verticalpos[b] = 0;
+        obj_bin[b] = -1;
+        rebin(b);
     }
 
+    cross_nr = -1;
+
     next_cross_timer = 125;
-    nextcrosscolor = rand() / (RAND_MAX / 8);
+    /* chosen when the first cross comes, the game logic random
+     numbers are only seeded when the game starts */
+    nextcrosscolor = -1;
     cross_direction = 1;
 
     robots_ready = 0;
     robots_angle = 0;
-
 }
 
 int rob_topplercollision(int angle, int vertical) {
-    long i, j;
-
-    for (int t = 0; t < MAX_OBJECTS; t++) {
-        if (object[t].kind != OBJ_KIND_CROSS && object[t].kind != OBJ_KIND_NOTHING
-                && object[t].kind != OBJ_KIND_DISAPPEAR && object[t].kind != OBJ_KIND_APPEAR) {
-            i = angle - object[t].anglepos;
-            j = object[t].verticalpos - vertical;
-            if ((-4 < i) && (i < 4) && (-8 < j) && (j < 8))
-                return t;
-        } else if (object[t].kind == OBJ_KIND_CROSS) {
-            if (object[t].anglepos >= 53 && object[t].anglepos <= 67
-                    && object[t].verticalpos + 7 >= vertical
-                    && vertical + 9 >= object[t].verticalpos)
-                return t;
-        }
-    }
-    return -1;
+    int t = nearrobot(angle, vertical, -1);
+
+    /* the cross hits the toppler when it passes the middle of the screen */
+    if ((cross_nr != -1) && ((t == -1) || (cross_nr < t)) && (obj_kind[cross_nr] == OBJ_KIND_CROSS)
+            && obj_anglepos[cross_nr] >= 53 && obj_anglepos[cross_nr] <= 67
+            && obj_verticalpos[cross_nr] + 7 >= vertical
+            && vertical + 9 >= obj_verticalpos[cross_nr])
+        return cross_nr;
+
+    return t;
 }
 
 int rob_snowballcollision(int angle, int vertical) {
@@ -256,21 +345,16 @@ int rob_snowballcollision(int angle, int vertical) {
     static unsigned char collision[16] = { 0x00, 0x1c, 0x1c, 0x3e, 0x3e, 0x3e, 0x3e, 0x3e, 0x3e,
             0x3e, 0x1c, 0x1c, 0x00, 0x00, 0x00, 0x10 };
 
-    long i, j;
-    for (int t = 0; t < MAX_OBJECTS; t++) {
-        if (object[t].kind != OBJ_KIND_CROSS && object[t].kind != OBJ_KIND_NOTHING
-                && object[t].kind != OBJ_KIND_DISAPPEAR && object[t].kind != OBJ_KIND_APPEAR) {
-            i = angle - object[t].anglepos;
-            j = object[t].verticalpos - vertical;
-            if ((-4 < i) && (i < 4) && (-8 < j) && (j < 8)) {
-                if ((collision[j + 7] >> (i + 3)) & 1)
-                    return t;
-                else
-                    return -1;
-            }
-        }
-    }
-    return -1;
+    /* only the first robot close enough counts */
+    int t = nearrobot(angle, vertical, -1);
+
+    if (t == -1)
+        return -1;
+
+    long i = angle - obj_anglepos[t];
+    long j = obj_verticalpos[t] - vertical;
+
+    return ((collision[j + 7] >> (i + 3)) & 1) ? t : -1;
 }
 
 void rob_new(int verticalpos) {
@@ -285,8 +369,8 @@ void rob_new(int verticalpos) {
 
     int h = verticalpos / 4 + 9;
 
-    for (int t = 0; t < MAX_OBJECTS; t++) {
-        if (object[t].kind == OBJ_KIND_NOTHING) {
+    for (int t = 0; t < capacity; t++) {
+        if (obj_kind[t] == OBJ_KIND_NOTHING) {
 
             /* if there is currently no chance for a new robot check for a cross */
             if ((robots_ready == lev_towerrows() * 8) || (h <= robots_ready)) {
@@ -299,84 +383,95 @@ void rob_new(int verticalpos) {
                     return;
 
                 /* set colors for the cross */
-                scr_setcrosscolor(crosscols[nextcrosscolor].r, crosscols[nextcrosscolor].g,
+                if (nextcrosscolor < 0)
+                    nextcrosscolor = rnd_range(RND_GAME, 8);
+                evt_crosscolor(crosscols[nextcrosscolor].r, crosscols[nextcrosscolor].g,
                         crosscols[nextcrosscolor].b);
                 nextcrosscolor = (nextcrosscolor + 1) & 7;
 
                 /* fill in the data for the robot */
-                object[t].kind = OBJ_KIND_CROSS;
-                object[t].time = 0;
+                obj_kind[t] = OBJ_KIND_CROSS;
+                obj_time[t] = 0;
                 cross_direction *= -1;
-                object[t].subKind = cross_direction;
+                obj_subKind[t] = cross_direction;
                 if (cross_direction > 0)
-                    object[t].anglepos = 0;
+                    obj_anglepos[t] = 0;
                 else
-                    object[t].anglepos = 120;
-                object[t].verticalpos = verticalpos;
+                    obj_anglepos[t] = 120;
+                obj_verticalpos[t] = verticalpos;
+                rebin(t);
+                cross_nr = t;
 
-                ttsounds::instance()->startsound(SND_CROSS);
+                evt_sound(SND_CROSS);
 
             } else {
-                bool is_robo = false;
 
-                /* find next robot */
-                do {
-                    b = lev_tower(robots_ready, robots_angle);
-                    is_robo = lev_is_robot(robots_ready, robots_angle);
-                    a = robots_angle;
-                    h = robots_ready;
-                    robots_angle = (robots_angle + 1) & 0xf;
-                } while ((!is_robo) && robots_angle != 0);
-
-                if (robots_angle == 0)
-                    robots_ready++;
+                /* find the next robot in the rest of the current row, the
+                 row mask only contains the robots that are still in the tower.
+                 Only one row is worked out each time, so that the robots
+                 appear in the same rhythm as before, and only that row is
+                 looked at, however high the tower is */
+                Uint16 m = lev_rowmask(TMASK_ROBOT, robots_ready) & (0xffff << robots_angle);
 
                 /* no robot found */
-                if (!is_robo)
+                if (!m) {
+                    robots_ready++;
+                    robots_angle = 0;
                     return;
+                }
+
+                for (a = 0; !(m & (1 << a)); a++)
+                    ;
+                b = lev_tower(robots_ready, a);
+                h = robots_ready;
+
+                robots_angle = (a + 1) & 0xf;
+                if (robots_angle == 0)
+                    robots_ready++;
 
                 /* fill in data for robot */
                 switch (b) {
 
                 case TB_ROBOT1:
-                    object[t].subKind = 1;
-                    object[t].futureKind = OBJ_KIND_FREEZEBALL;
+                    obj_subKind[t] = 1;
+                    obj_futureKind[t] = OBJ_KIND_FREEZEBALL;
                     break;
 
                 case TB_ROBOT2:
-                    object[t].subKind = 1;
-                    object[t].futureKind = OBJ_KIND_JUMPBALL;
+                    obj_subKind[t] = 1;
+                    obj_futureKind[t] = OBJ_KIND_JUMPBALL;
                     break;
 
                 case TB_ROBOT3:
-                    object[t].subKind = 0;
-                    object[t].futureKind = OBJ_KIND_JUMPBALL;
+                    obj_subKind[t] = 0;
+                    obj_futureKind[t] = OBJ_KIND_JUMPBALL;
                     break;
 
                 case TB_ROBOT4:
-                    object[t].subKind = 1;
-                    object[t].futureKind = OBJ_KIND_ROBOT_VERT;
+                    obj_subKind[t] = 1;
+                    obj_futureKind[t] = OBJ_KIND_ROBOT_VERT;
                     break;
 
                 case TB_ROBOT5:
-                    object[t].subKind = 2;
-                    object[t].futureKind = OBJ_KIND_ROBOT_VERT;
+                    obj_subKind[t] = 2;
+                    obj_futureKind[t] = OBJ_KIND_ROBOT_VERT;
                     break;
 
                 case TB_ROBOT6:
-                    object[t].subKind = 1;
-                    object[t].futureKind = OBJ_KIND_ROBOT_HORIZ;
+                    obj_subKind[t] = 1;
+                    obj_futureKind[t] = OBJ_KIND_ROBOT_HORIZ;
                     break;
 
                 case TB_ROBOT7:
-                    object[t].subKind = 2;
-                    object[t].futureKind = OBJ_KIND_ROBOT_HORIZ;
+                    obj_subKind[t] = 2;
+                    obj_futureKind[t] = OBJ_KIND_ROBOT_HORIZ;
                     break;
                 }
-                object[t].anglepos = (a * 8) + 4;
-                object[t].verticalpos = h * 4;
-                object[t].kind = OBJ_KIND_APPEAR;
-                object[t].time = 0;
+                obj_anglepos[t] = (a * 8) + 4;
+                obj_verticalpos[t] = h * 4;
+                rebin(t);
+                obj_kind[t] = OBJ_KIND_APPEAR;
+                obj_time[t] = 0;
 
                 /* empty the field in the level datastructure */
                 lev_clear(h, a);
@@ -394,8 +489,8 @@ void rob_update(void) {
 
     int h;
 
-    for (int t = 0; t < MAX_OBJECTS; t++) {
-        switch (object[t].kind) {
+    for (int t = 0; t < capacity; t++) {
+        switch (obj_kind[t]) {
         case OBJ_KIND_NOTHING:
             break;
 
@@ -404,25 +499,25 @@ void rob_update(void) {
             break;
 
         case OBJ_KIND_DISAPPEAR:
-            if (object[t].time == 6)
-                object[t].kind = OBJ_KIND_NOTHING;
+            if (obj_time[t] == 6)
+                obj_kind[t] = OBJ_KIND_NOTHING;
             else
-                object[t].time++;
+                obj_time[t]++;
             break;
 
         case OBJ_KIND_APPEAR:
-            if (object[t].time == 6) {
-                object[t].kind = object[t].futureKind;
-                object[t].time = 0;
+            if (obj_time[t] == 6) {
+                obj_kind[t] = obj_futureKind[t];
+                obj_time[t] = 0;
             } else
-                object[t].time++;
+                obj_time[t]++;
             break;
 
         case OBJ_KIND_FREEZEBALL_FROZEN:
-            object[t].time--;
-            if (object[t].time > 0)
+            obj_time[t]--;
+            if (obj_time[t] > 0)
                 break;
-            object[t].kind = OBJ_KIND_FREEZEBALL;
+            obj_kind[t] = OBJ_KIND_FREEZEBALL;
 
         case OBJ_KIND_FREEZEBALL:
 
@@ -431,11 +526,11 @@ void rob_update(void) {
 
             switch (test_robot_undergr(t)) {
             case 1:
-                object[t].kind = OBJ_KIND_FREEZEBALL_FALLING;
-                object[t].time = 10;
+                obj_kind[t] = OBJ_KIND_FREEZEBALL_FALLING;
+                obj_time[t] = 10;
                 break;
             case 2:
-                object[t].subKind = -object[t].subKind;
+                obj_subKind[t] = -obj_subKind[t];
                 break;
             }
             moverobothorizontal(t);
@@ -448,19 +543,21 @@ void rob_update(void) {
 
             moverobothorizontal(t);
 
-            if (object[t].verticalpos + jumping_ball[object[t].time] < 0) {
+            if (obj_verticalpos[t] + jumping_ball[obj_time[t]] < 0) {
                 drown_robot(t);
                 break;
             }
 
-            h = jumping_ball[object[t].time];
+            h = jumping_ball[obj_time[t]];
 
             while (h != 0) {
 
-                object[t].verticalpos += h;
+                obj_verticalpos[t] += h;
+                rebin(t);
                 if (!testroboter(t) || (figurecollision(t) != -1))
                     break;
-                object[t].verticalpos -= h;
+                obj_verticalpos[t] -= h;
+                rebin(t);
 
                 if (h > 0)
                     h--;
@@ -468,9 +565,9 @@ void rob_update(void) {
                     h++;
             }
 
-            if ((h == 0) && (jumping_ball[object[t].time] < 0)) {
-                object[t].kind = OBJ_KIND_FREEZEBALL;
-                object[t].time = 0;
+            if ((h == 0) && (jumping_ball[obj_time[t]] < 0)) {
+                obj_kind[t] = OBJ_KIND_FREEZEBALL;
+                obj_time[t] = 0;
             }
             break;
 
@@ -479,33 +576,35 @@ void rob_update(void) {
             if (checkverticalposition(top_verticalpos(), t) || checkvalidposition(t))
                 break;
 
-            h = object[t].subKind;
+            h = obj_subKind[t];
             moverobothorizontal(t);
 
-            if (h * object[t].subKind < 0) {
-                unsigned char w = (object[t].anglepos - top_anglepos()) & 0x7f;
+            if (h * obj_subKind[t] < 0) {
+                unsigned char w = (obj_anglepos[t] - top_anglepos()) & 0x7f;
                 if (w >= 0x40)
                     w |= 0x80;
                 if (w >= 0x80)
                     w = 0xff & (~w + 1);
 
-                ttsounds::instance()->setsoundvol(SND_BOINK, MIX_MAX_VOLUME - w);
-                ttsounds::instance()->startsound(SND_BOINK);
+                evt_soundvol(SND_BOINK, MIX_MAX_VOLUME - w);
+                evt_sound(SND_BOINK);
             }
 
-            if (object[t].verticalpos + jumping_ball[object[t].time] < 0) {
+            if (obj_verticalpos[t] + jumping_ball[obj_time[t]] < 0) {
                 drown_robot(t);
                 break;
             }
 
-            h = jumping_ball[object[t].time];
+            h = jumping_ball[obj_time[t]];
 
             while (h != 0) {
 
-                object[t].verticalpos += h;
+                obj_verticalpos[t] += h;
+                rebin(t);
                 if (!testroboter(t) || (figurecollision(t) != -1))
                     break;
-                object[t].verticalpos -= h;
+                obj_verticalpos[t] -= h;
+                rebin(t);
 
                 if (h > 0)
                     h--;
@@ -514,26 +613,26 @@ void rob_update(void) {
             }
 
             /* ball is bouncing */
-            if ((h == 0) && (jumping_ball[object[t].time] < 0)) {
+            if ((h == 0) && (jumping_ball[obj_time[t]] < 0)) {
 
-                unsigned char w = (object[t].anglepos - top_anglepos()) & 0x7f;
+                unsigned char w = (obj_anglepos[t] - top_anglepos()) & 0x7f;
                 if (w >= 0x40)
                     w |= 0x80;
                 if (w >= 0x80)
                     w = 0xff & (~w + 1);
 
-                ttsounds::instance()->setsoundvol(SND_BOINK, MIX_MAX_VOLUME - 2 * w);
-                ttsounds::instance()->startsound(SND_BOINK);
+                evt_soundvol(SND_BOINK, MIX_MAX_VOLUME - 2 * w);
+                evt_sound(SND_BOINK);
 
                 /* restart bounce cyclus */
-                object[t].time = 0;
+                obj_time[t] = 0;
 
                 /* start the bounding ball moving sideways in direction of the animal */
-                if (object[t].subKind == 0 && top_visible() && top_walking()
-                        && object[t].verticalpos == top_verticalpos()) {
+                if (obj_subKind[t] == 0 && top_visible() && top_walking()
+                        && obj_verticalpos[t] == top_verticalpos()) {
 
                     /* check if the animal is near enough to the ball */
-                    unsigned char w = (object[t].anglepos - top_anglepos()) & 0x7f;
+                    unsigned char w = (obj_anglepos[t] - top_anglepos()) & 0x7f;
                     h = -1;
                     if (w >= 0x40)
                         w |= 0x80;
@@ -543,14 +642,14 @@ void rob_update(void) {
                     }
 
                     if (w < 0x20)
-                        object[t].subKind = h;
+                        obj_subKind[t] = h;
                 }
                 break;
             }
 
-            object[t].time++;
-            if (object[t].time > 10)
-                object[t].time = 10;
+            obj_time[t]++;
+            if (obj_time[t] > 10)
+                obj_time[t] = 10;
 
             break;
 
@@ -561,7 +660,7 @@ void rob_update(void) {
 
             moverobothorizontal(t);
 
-            object[t].time = (object[t].time + 1) & 0x1f;
+            obj_time[t] = (obj_time[t] + 1) & 0x1f;
             break;
 
         case OBJ_KIND_ROBOT_VERT:
@@ -569,18 +668,20 @@ void rob_update(void) {
             if (checkverticalposition(top_verticalpos(), t) || checkvalidposition(t))
                 break;
 
-            if ((object[t].verticalpos + object[t].subKind) < 0)
+            if ((obj_verticalpos[t] + obj_subKind[t]) < 0)
                 drown_robot(t);
             else {
-                object[t].verticalpos += object[t].subKind;
+                obj_verticalpos[t] += obj_subKind[t];
+                rebin(t);
 
                 if (testroboter(t) || (figurecollision(t) != -1)) {
-                    object[t].subKind *= -1;
-                    object[t].verticalpos += object[t].subKind;
+                    obj_subKind[t] *= -1;
+                    obj_verticalpos[t] += obj_subKind[t];
+                    rebin(t);
                 }
             }
 
-            object[t].time = (object[t].time + 1) & 0x1f;
+            obj_time[t] = (obj_time[t] + 1) & 0x1f;
             break;
         }
     }
@@ -588,13 +689,13 @@ void rob_update(void) {
 
 int rob_gothit(int nr) {
 
-    if (object[nr].kind == OBJ_KIND_FREEZEBALL) {
-        object[nr].time = 0x4b;
-        object[nr].kind = OBJ_KIND_FREEZEBALL_FROZEN;
+    if (obj_kind[nr] == OBJ_KIND_FREEZEBALL) {
+        obj_time[nr] = 0x4b;
+        obj_kind[nr] = OBJ_KIND_FREEZEBALL_FROZEN;
         return 0;
-    } else if (object[nr].kind == OBJ_KIND_JUMPBALL) {
-        object[nr].kind = OBJ_KIND_DISAPPEAR;
-        object[nr].time = 0;
+    } else if (obj_kind[nr] == OBJ_KIND_JUMPBALL) {
+        obj_kind[nr] = OBJ_KIND_DISAPPEAR;
+        obj_time[nr] = 0;
         return 100;
     } else
         return 0;
@@ -602,11 +703,51 @@ int rob_gothit(int nr) {
 
 void rob_disappearall(void) {
 
-    for (int t = 0; t < MAX_OBJECTS; t++) {
-        if (object[t].kind != OBJ_KIND_NOTHING) {
-            object[t].kind = OBJ_KIND_DISAPPEAR;
-            object[t].time = 0;
+    for (int t = 0; t < capacity; t++) {
+        if (obj_kind[t] != OBJ_KIND_NOTHING) {
+            obj_kind[t] = OBJ_KIND_DISAPPEAR;
+            obj_time[t] = 0;
         }
     }
 }
 
+/* the capacity is set by rob_initialize() and doesn't change during the
+ game, so it is not saved. The robots still waiting in the tower come
+ from the level's row masks, they are part of the tower state */
+void rob_savestate(unsigned char *&p) {
+    SNP_PUTN(p, obj_anglepos, capacity);
+    SNP_PUTN(p, obj_verticalpos, capacity);
+    SNP_PUTN(p, obj_kind, capacity);
+    SNP_PUTN(p, obj_subKind, capacity);
+    SNP_PUTN(p, obj_futureKind, capacity);
+    SNP_PUTN(p, obj_time, capacity);
+    SNP_PUTN(p, bin_first, BINS_PER_AXIS * BINS_PER_AXIS);
+    SNP_PUTN(p, obj_bin, capacity);
+    SNP_PUTN(p, obj_binnext, capacity);
+    SNP_PUTN(p, obj_binprev, capacity);
+    SNP_PUT(p, cross_nr);
+    SNP_PUT(p, robots_ready);
+    SNP_PUT(p, robots_angle);
+    SNP_PUT(p, next_cross_timer);
+    SNP_PUT(p, cross_direction);
+    SNP_PUT(p, nextcrosscolor);
+}
+
+void rob_loadstate(const unsigned char *&p) {
+    SNP_GETN(p, obj_anglepos, capacity);
+    SNP_GETN(p, obj_verticalpos, capacity);
+    SNP_GETN(p, obj_kind, capacity);
+    SNP_GETN(p, obj_subKind, capacity);
+    SNP_GETN(p, obj_futureKind, capacity);
+    SNP_GETN(p, obj_time, capacity);
+    SNP_GETN(p, bin_first, BINS_PER_AXIS * BINS_PER_AXIS);
+    SNP_GETN(p, obj_bin, capacity);
+    SNP_GETN(p, obj_binnext, capacity);
+    SNP_GETN(p, obj_binprev, capacity);
+    SNP_GET(p, cross_nr);
+    SNP_GET(p, robots_ready);
+    SNP_GET(p, robots_angle);
+    SNP_GET(p, next_cross_timer);
+    SNP_GET(p, cross_direction);
+    SNP_GET(p, nextcrosscolor);
+}
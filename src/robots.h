@@ -19,6 +19,8 @@
 #ifndef ROBOTS_H
 #define ROBOTS_H
 
+#include "decl.h"
+
 /* this module handles the movement of up to 4 robots */
 
 /* values for kinds of robots */
@@ -35,8 +37,11 @@ typedef enum {
     OBJ_KIND_ROBOT_HORIZ
 } rob_kinds;
 
-/* initialize all fields, call this when you start a new towergame */
-void rob_initialize(void);
+/* initialize all fields, call this when you start a new towergame.
+ robots is the number of robots that can be there at the same time.
+ Demos, simulations and the tools always use DEFAULT_ROBOTS, only the
+ player may choose more in a normal game */
+void rob_initialize(int robots = DEFAULT_ROBOTS);
 
 /* return the position and state of one robot */
 rob_kinds rob_kind(int nr);
@@ -44,6 +49,10 @@ int rob_time(int nr);
 int rob_angle(int nr);
 int rob_vertical(int nr);
 
+/* the number of robots, the functions above can be called for
+ all robots from 0 up to this number */
+int rob_count(void);
+
 /* returns the object the snowball or animal collides with or -1 */
 int rob_topplercollision(int angle, int vertical);
 int rob_snowballcollision(int angle, int vertical);
@@ -62,4 +71,8 @@ int rob_gothit(int nr);
 /* makes all the robots disappear */
 void rob_disappearall(void);
 
+/* snapshot support, see snapshot.h */
+void rob_savestate(unsigned char *&p);
+void rob_loadstate(const unsigned char *&p);
+
 #endif
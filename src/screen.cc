@@ -19,6 +19,7 @@
 #include "screen.h"
 
 #include "archi.h"
+#include "assetpack.h"
 #include "sprites.h"
 #include "robots.h"
 #include "stars.h"
@@ -29,6 +30,7 @@
 #include "decl.h"
 #include "keyb.h"
 #include "configuration.h"
+#include "timing.h"
 
 #include <string.h>
 #include <stdlib.h>
@@ -176,6 +178,19 @@ Uint16 scr_loadsprites(spritecontainer *spr, file * fi, int num, int w, int h, b
     Uint32 pixel;
 
     for (int t = 0; t < num; t++) {
+
+        /* when the sprite is in the asset pack we only need to skip its data */
+        z = pak_getsurface(w, h);
+        if (z) {
+            fi->skip(w * h * (sprite ? 2 : 1));
+
+            if (t == 0)
+                erg = spr->save(z);
+            else
+                spr->save(z);
+            continue;
+        }
+
         z = SDL_CreateRGBSurface(SDL_SWSURFACE | (sprite) ? SDL_SRCALPHA : 0,
                 w, h,
                 32,
@@ -223,6 +238,8 @@ Uint16 scr_loadsprites(spritecontainer *spr, file * fi, int num, int w, int h, b
         SDL_FreeSurface(z);
         z = z2;
 
+        pak_putsurface(z);
+
         if (t == 0) {
             erg = spr->save(z);
         } else {
@@ -389,6 +406,8 @@ static void loadgraphics(Uint8 what) {
             pal[3 * t + 2] = c2;
         }
 
+        pak_beginsection(PAK_SEC_TOWER, false);
+
         step = scr_loadsprites(&restsprites, &fi, SPR_STEPFRAMES, SPR_STEPWID, SPR_STEPHEI, false,
                 pal, false);
         elevatorsprite = scr_loadsprites(&restsprites, &fi, SPR_ELEVAFRAMES, SPR_ELEVAWID,
@@ -402,6 +421,8 @@ static void loadgraphics(Uint8 what) {
 
         scr_read_palette(&fi, pal);
 
+        pak_beginsection(PAK_SEC_OBJECTS, config.use_alpha_sprites());
+
         topplerstart = scr_loadsprites(&objectsprites, &fi, 74, SPR_HEROWID, SPR_HEROHEI, true, pal,
                 config.use_alpha_sprites());
     }
@@ -526,6 +547,10 @@ void scr_setcrosscolor(Uint8 rk, Uint8 gk, Uint8 bk) {
 
     int t, r, g, b;
 
+    /* the simulation runs without any graphics */
+    if (!crossdata)
+        return;
+
     for (t = 0; t < 256; t++) {
         r = g = b = crosspal[2 * t];
 
@@ -562,6 +587,8 @@ static void loadfont(void) {
 
     scr_read_palette(&fi, pal);
 
+    pak_beginsection(PAK_SEC_FONT, config.use_alpha_font());
+
     fontheight = fi.getbyte();
 
     while (!fi.eof()) {
@@ -601,6 +628,8 @@ static void loadscroller(void) {
     sl_tower_num = fi.getword();
     sl_tower_den = fi.getword();
 
+    pak_beginsection(PAK_SEC_SCROLLER, config.use_alpha_layers());
+
     for (int i = 0; i < layers; i++) {
         _scroll_layer &current = scroll_layers[i];
         current.xpos = fi.getword();
@@ -645,6 +674,7 @@ static void free_memory(Uint8 what) {
 
     if (what & RL_OBJECTS) {
         free(crossdata);
+        crossdata = NULL;
         delete[] robots;
     }
 
@@ -666,6 +696,11 @@ void scr_reload_sprites(Uint8 what) {
 
 void scr_init(void) {
     scr_reinit();
+
+    /* the pack depends on the display format, so it can only be
+     * checked after the display has been opened */
+    pak_open(dataarchive);
+
     load_sprites(0xff);
 
     /* initialize sine table */
@@ -694,6 +729,7 @@ void scr_reinit() {
 void scr_done(void) {
     free_memory(0xff);
     sts_done();
+    pak_close();
 }
 
 static void cleardesk(long height) {
@@ -738,13 +774,28 @@ void scr_darkenscreen(void) {
  height: 0 means row 0 is in the middle
  4 means row 1 ...
  */
+/* returns the lowest slice that is not below the screen, when slice 0
+ * is at ypos, and moves ypos to that slice. So the slices below are
+ * skipped at once and drawing a tower only costs its visible slices,
+ * however high it is */
+static int first_slice(int &ypos) {
+    if (ypos < SCREEN_HEIGHT)
+        return 0;
+
+    int n = (ypos - SCREEN_HEIGHT) / SPRITE_SLICE_HEIGHT + 1;
+    ypos -= n * SPRITE_SLICE_HEIGHT;
+    return n;
+}
+
 static void puttower(long angle, long height, long towerheight, int shift = 0) {
 
     /* calculate the blit position of the lowest slice considering the current
      * vertical position
      */
-    int slice = 0;
     int ypos = SCREEN_HEIGHT / 2 - SPRITE_SLICE_HEIGHT + height;
+    int slice = first_slice(ypos);
+
+    angle = (angle + slice * (SPR_SLICEANGLES / 2)) % TOWER_ANGLES;
 
     /* now go up until we go over the top of the screen or reach the
      * top of the tower
@@ -998,6 +1049,8 @@ void scr_swap(void) {
         wait_for_focus();
     }
     SDL_UpdateRect(display, 0, 0, 0, 0);
+    key_frame();
+    tim_frame();
 }
 
 void scr_setclipping(int x, int y, int w, int h) {
@@ -1036,13 +1089,8 @@ static void draw_tower(long vert, long angle) {
 
     puttower(angle, vert, lev_towerrows());
 
-    int slice = 0;
     int ypos = SCREEN_HEIGHT / 2 - SPRITE_SLICE_HEIGHT + vert;
-
-    while (ypos > SCREEN_HEIGHT) {
-        slice++;
-        ypos -= SPRITE_SLICE_HEIGHT;
-    }
+    int slice = first_slice(ypos);
 
     while ((ypos > -SPRITE_SLICE_HEIGHT) && (slice < lev_towerrows())) {
 
@@ -1077,13 +1125,8 @@ static void draw_tower_editor(long vert, long angle, int state) {
 
     puttower(angle, vert, lev_towerrows());
 
-    int slice = 0;
     int ypos = SCREEN_HEIGHT / 2 - SPRITE_SLICE_HEIGHT + vert;
-
-    while (ypos > SCREEN_HEIGHT) {
-        slice++;
-        ypos -= SPRITE_SLICE_HEIGHT;
-    }
+    int slice = first_slice(ypos);
 
     while ((ypos > -SPRITE_SLICE_HEIGHT) && (slice < lev_towerrows())) {
 
@@ -1580,8 +1623,8 @@ static void putthings(long vert, long a, long angle) {
         /* calc the x pos where the thing has to be drawn */
         int x = sintab[a % TOWER_ANGLES] + (SCREEN_WIDTH / 2);
 
-        int slice = 0;
         int ypos = SCREEN_HEIGHT / 2 - SPRITE_SLICE_HEIGHT + vert;
+        int slice = first_slice(ypos);
 
         while ((ypos > -SPRITE_SLICE_HEIGHT) && (slice < lev_towerrows())) {
 
@@ -1595,7 +1638,7 @@ static void putthings(long vert, long a, long angle) {
     }
 
     /* and now check for robots to be drawn */
-    for (int rob = 0; rob < 4; rob++) {
+    for (int rob = 0; rob < rob_count(); rob++) {
 
         /* if the the current robot is active and not the cross */
         if (rob_kind(rob) != OBJ_KIND_NOTHING && rob_kind(rob) != OBJ_KIND_CROSS) {
@@ -1625,8 +1668,8 @@ static void putthings_editor(long vert, long a, long angle, int state) {
         /* calc the x pos where the thing has to be drawn */
         int x = sintab[a % TOWER_ANGLES] + (SCREEN_WIDTH / 2);
 
-        int slice = 0;
         int ypos = SCREEN_HEIGHT / 2 - SPRITE_SLICE_HEIGHT + vert;
+        int slice = first_slice(ypos);
 
         while ((ypos > -SPRITE_SLICE_HEIGHT) && (slice < lev_towerrows())) {
 
@@ -1683,7 +1726,7 @@ static void draw_before_editor(long vert, long angle, int state) {
 static void putcross(long vert) {
     long i, y;
 
-    for (int t = 0; t < 4; t++) {
+    for (int t = 0; t < rob_count(); t++) {
         if (rob_kind(t) == OBJ_KIND_CROSS) {
             i = (rob_angle(t) - 60) * 5;
             y = (vert - rob_vertical(t)) * 4 + (SCREEN_HEIGHT / 2) - SPR_CROSSHEI;
@@ -0,0 +1,282 @@
+/* Tower Toppler - Nebulus
+ * Copyright (C) 2000-2006  Andreas Rver
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+#include "snapshot.h"
+
+#include "decl.h"
+#include "level.h"
+#include "toppler.h"
+#include "robots.h"
+#include "elevators.h"
+#include "snowball.h"
+#include "points.h"
+#include "random.h"
+
+/* the ring keeps the snapshots one after the other in a byte buffer,
+ * when the end is reached it continues at the start and the oldest
+ * snapshots that are in the way are dropped. At 18 ticks per second
+ * and a keyframe every 64 ticks this is enough for a few minutes. It
+ * must hold at least one snapshot of SNP_MAXSIZE bytes */
+#define RING_BYTES (512 * 1024)
+
+#if RING_BYTES < SNP_MAXSIZE
+#error "RING_BYTES can't hold the biggest snapshot"
+#endif
+#define RING_ENTRIES 4096
+
+Uint32 snp_save(Uint8 *buf, const snp_loop &loop) {
+    unsigned char *p = buf;
+
+    SNP_PUT(p, loop);
+    top_savestate(p);
+    rob_savestate(p);
+    ele_savestate(p);
+    snb_savestate(p);
+    pts_savestate(p);
+    rnd_savestate(p);
+    lev_savestate(p);
+
+    assert_msg(p - buf <= SNP_MAXSIZE, "Snapshot is too big.");
+
+    return p - buf;
+}
+
+Uint32 snp_savekey(Uint8 *buf) {
+    unsigned char *p = buf;
+
+    top_savestate(p);
+    rob_savestate(p);
+    ele_savestate(p);
+    snb_savestate(p);
+    rnd_savestate(p);
+    lev_savestate(p);
+
+    assert_msg(p - buf <= SNP_MAXSIZE, "Snapshot is too big.");
+
+    return p - buf;
+}
+
+void snp_restore(const Uint8 *buf, snp_loop &loop) {
+    const unsigned char *p = buf;
+
+    SNP_GET(p, loop);
+    top_loadstate(p);
+    rob_loadstate(p);
+    ele_loadstate(p);
+    snb_loadstate(p);
+    pts_loadstate(p);
+    rnd_loadstate(p);
+    lev_loadstate(p);
+}
+
+static Uint8 ring[RING_BYTES];
+
+/* key is the entry of the keyframe the entry depends on, for
+ keyframes it is the entry itself */
+static struct {
+    Uint32 tick;
+    Uint32 ofs, len;
+    int key;
+} entries[RING_ENTRIES];
+
+static int first, count;
+static Uint32 writepos, usedbytes;
+
+/* the last keyframe, the following ticks are stored relative to it */
+static Uint8 keydata[SNP_MAXSIZE];
+static Uint32 keylen, keytick;
+static int keyentry = -1;
+
+static Uint8 current[SNP_MAXSIZE];
+static Uint8 delta[SNP_MAXSIZE];
+
+static int entry(int n) {
+    return (first + n) % RING_ENTRIES;
+}
+
+/* drops the oldest entry, when it is a keyframe all the entries
+ depending on it go as well */
+static void drop_oldest(void) {
+    int e = first;
+
+    do {
+        if (first == keyentry)
+            keyentry = -1;
+        usedbytes -= entries[first].len;
+        first = entry(1);
+        count--;
+    } while (count && (entries[first].key == e));
+}
+
+/* finds a place for len bytes in the ring and drops the entries
+ that are in the way */
+static Uint32 reserve(Uint32 len) {
+    if (writepos + len > RING_BYTES)
+        writepos = 0;
+
+    while (count && ((count == RING_ENTRIES) || ((entries[first].ofs < writepos + len)
+            && (entries[first].ofs + entries[first].len > writepos))))
+        drop_oldest();
+
+    Uint32 ofs = writepos;
+    writepos += len;
+    usedbytes += len;
+    return ofs;
+}
+
+/* the delta is a list of runs, each run has the number of equal bytes
+ to skip, the number of changed bytes and the changed bytes */
+Uint32 snp_delta(const Uint8 *key, const Uint8 *cur, Uint32 len, Uint8 *out) {
+    Uint32 i = 0, o = 0;
+
+    while (i < len) {
+        Uint32 same = i;
+        while ((i < len) && (key[i] == cur[i]) && (i - same < 0xffff))
+            i++;
+        Uint32 diff = i;
+        while ((i < len) && (key[i] != cur[i]) && (i - diff < 0xffff))
+            i++;
+
+        if (o + 4 + (i - diff) >= len)
+            return 0;
+
+        out[o++] = (diff - same) & 0xff;
+        out[o++] = (diff - same) >> 8;
+        out[o++] = (i - diff) & 0xff;
+        out[o++] = (i - diff) >> 8;
+        memcpy(out + o, cur + diff, i - diff);
+        o += i - diff;
+    }
+
+    return o;
+}
+
+void snp_undelta(const Uint8 *in, Uint32 inlen, Uint8 *frame) {
+    Uint32 i = 0, f = 0;
+
+    while (i < inlen) {
+        Uint32 same = in[i] + (Uint32(in[i + 1]) << 8);
+        Uint32 diff = in[i + 2] + (Uint32(in[i + 3]) << 8);
+        i += 4;
+        f += same;
+        memcpy(frame + f, in + i, diff);
+        f += diff;
+        i += diff;
+    }
+}
+
+void snp_ring_clear(void) {
+    first = count = 0;
+    writepos = usedbytes = 0;
+    keyentry = -1;
+}
+
+void snp_ring_push(Uint32 tick, const snp_loop &loop) {
+    Uint32 len = snp_save(current, loop);
+    Uint32 dlen = 0;
+
+    assert_msg(!count || (tick > entries[entry(count - 1)].tick),
+            "Snapshot ticks must increase.");
+
+    if ((keyentry != -1) && (len == keylen) && (tick - keytick < SNP_KEYINTERVAL))
+        dlen = snp_delta(keydata, current, len, delta);
+
+    if (dlen) {
+        int key = keyentry;
+        Uint32 ofs = reserve(dlen);
+
+        /* the keyframe might have been dropped to make room */
+        if (keyentry != -1) {
+            int e = entry(count);
+            memcpy(ring + ofs, delta, dlen);
+            entries[e].tick = tick;
+            entries[e].ofs = ofs;
+            entries[e].len = dlen;
+            entries[e].key = key;
+            count++;
+            return;
+        }
+        writepos = ofs;
+        usedbytes -= dlen;
+    }
+
+    Uint32 ofs = reserve(len);
+    int e = entry(count);
+
+    memcpy(ring + ofs, current, len);
+    entries[e].tick = tick;
+    entries[e].ofs = ofs;
+    entries[e].len = len;
+    entries[e].key = e;
+    count++;
+
+    memcpy(keydata, current, len);
+    keylen = len;
+    keytick = tick;
+    keyentry = e;
+}
+
+bool snp_ring_restore(Uint32 tick, snp_loop &loop) {
+    int n;
+
+    for (n = count - 1; n >= 0; n--)
+        if (entries[entry(n)].tick <= tick)
+            break;
+
+    if ((n < 0) || (entries[entry(n)].tick != tick))
+        return false;
+
+    int e = entry(n);
+    int k = entries[e].key;
+
+    memcpy(keydata, ring + entries[k].ofs, entries[k].len);
+    keylen = entries[k].len;
+    keytick = entries[k].tick;
+    keyentry = k;
+
+    memcpy(current, keydata, keylen);
+    if (k != e)
+        snp_undelta(ring + entries[e].ofs, entries[e].len, current);
+
+    snp_restore(current, loop);
+
+    /* forget everything after the restored tick */
+    while (count > n + 1) {
+        count--;
+        usedbytes -= entries[entry(count)].len;
+    }
+    writepos = entries[e].ofs + entries[e].len;
+
+    return true;
+}
+
+bool snp_ring_empty(void) {
+    return count == 0;
+}
+
+Uint32 snp_ring_oldest(void) {
+    return entries[first].tick;
+}
+
+Uint32 snp_ring_newest(void) {
+    return entries[entry(count - 1)].tick;
+}
+
+Uint32 snp_ring_bytes(void) {
+    return usedbytes;
+}
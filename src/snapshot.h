@@ -0,0 +1,103 @@
+/* Tower Toppler - Nebulus
+ * Copyright (C) 2000-2006  Andreas Rver
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include "level.h"
+
+#include <SDL_types.h>
+#include <string.h>
+
+/* this module takes snapshots of the complete state of a running
+ * towergame: the toppler, robots, elevators, snowball, points, the game
+ * logic random numbers and the tower itself. A snapshot can only be
+ * restored into the same towergame, because the robot count, which is
+ * set up when the tower starts, is not in it.
+ *
+ * Besides single snapshots there is a ring buffer for one snapshot per
+ * tick. Every SNP_KEYINTERVAL ticks a complete snapshot is stored, the
+ * ticks in between only store the bytes that differ from it. The demo
+ * player keeps the ticks it played last in there, so stepping and
+ * seeking back doesn't need to simulate the ticks again.
+ */
+
+/* the maximal size of a snapshot. Usually the tower only takes room for
+ * a few changed rows, but a game may change every row of the tallest
+ * tower, the rest of the state fits into the first 8 KiB */
+#define SNP_MAXSIZE (8192 + LEV_MAXSTATE)
+
+/* a complete keyframe is stored every this many ticks */
+#define SNP_KEYINTERVAL 64
+
+/* the variables of the game loop that belong to the state */
+typedef struct {
+    int time;
+    int timecount;
+    int reached_height;
+} snp_loop;
+
+/* writes the current state into buf, that must have room for SNP_MAXSIZE
+ bytes and returns the size of the snapshot */
+Uint32 snp_save(Uint8 *buf, const snp_loop &loop);
+
+/* restores the state saved with snp_save */
+void snp_restore(const Uint8 *buf, snp_loop &loop);
+
+/* writes only the part of the state that decides how the game goes on,
+ without the variables of the game loop and the points. Two states with
+ the same key behave the same for the same keys, only the time left and
+ the points can differ. The key can't be restored */
+Uint32 snp_savekey(Uint8 *buf);
+
+/* writes the bytes of cur that differ from base, both len bytes long,
+ into out and returns the size of the delta, or 0 when it is not
+ smaller than cur. snp_undelta() applies a delta to a copy of base */
+Uint32 snp_delta(const Uint8 *base, const Uint8 *cur, Uint32 len, Uint8 *out);
+void snp_undelta(const Uint8 *in, Uint32 inlen, Uint8 *frame);
+
+/* empties the ring, call this when a towergame starts */
+void snp_ring_clear(void);
+
+/* stores the current state for the given tick, the ticks must be
+ given in increasing order. When the ring is full the oldest ticks
+ are dropped */
+void snp_ring_push(Uint32 tick, const snp_loop &loop);
+
+/* restores the state of the given tick, returns false when that tick
+ is not in the ring. All the ticks after the restored one are removed
+ from the ring */
+bool snp_ring_restore(Uint32 tick, snp_loop &loop);
+
+/* the range of ticks in the ring, only valid when snp_ring_empty()
+ returns false */
+bool snp_ring_empty(void);
+Uint32 snp_ring_oldest(void);
+Uint32 snp_ring_newest(void);
+
+/* the bytes used by the snapshots in the ring */
+Uint32 snp_ring_bytes(void);
+
+/* used by the modules to write their variables into a snapshot
+ and to read them back */
+#define SNP_PUT(p, v) (memcpy((p), &(v), sizeof(v)), (p) += sizeof(v))
+#define SNP_GET(p, v) (memcpy(&(v), (p), sizeof(v)), (p) += sizeof(v))
+#define SNP_PUTN(p, a, n) (memcpy((p), (a), (n) * sizeof(*(a))), (p) += (n) * sizeof(*(a)))
+#define SNP_GETN(p, a, n) (memcpy((a), (p), (n) * sizeof(*(a))), (p) += (n) * sizeof(*(a)))
+
+#endif
@@ -20,11 +20,14 @@
 #include "level.h"
 #include "points.h"
 #include "sound.h"
+#include "events.h"
+#include "decl.h"
+#include "snapshot.h"
 
-static int an;
-static long subKind;
-static long ve;
-static long time;
+static GAME_STATE int an;
+static GAME_STATE long subKind;
+static GAME_STATE long ve;
+static GAME_STATE long time;
 
 void snb_init(void) {
     time = -1;
@@ -60,7 +63,7 @@ void snb_movesnowball(void) {
     if (nr == -1)
         return;
     else {
-        ttsounds::instance()->startsound(SND_HIT);
+        evt_sound(SND_HIT);
         pts_add(rob_gothit(nr));
         time = -1;
     }
@@ -91,3 +94,16 @@ int snb_anglepos(void) {
     return an;
 }
 
+void snb_savestate(unsigned char *&p) {
+    SNP_PUT(p, an);
+    SNP_PUT(p, subKind);
+    SNP_PUT(p, ve);
+    SNP_PUT(p, time);
+}
+
+void snb_loadstate(const unsigned char *&p) {
+    SNP_GET(p, an);
+    SNP_GET(p, subKind);
+    SNP_GET(p, ve);
+    SNP_GET(p, time);
+}
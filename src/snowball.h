@@ -38,4 +38,8 @@ void snb_start(int verticalpos, int anglepos, bool look_left);
 int snb_verticalpos(void);
 int snb_anglepos(void);
 
+/* snapshot support, see snapshot.h */
+void snb_savestate(unsigned char *&p);
+void snb_loadstate(const unsigned char *&p);
+
 #endif
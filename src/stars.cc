@@ -21,6 +21,7 @@
 #include "decl.h"
 #include "sprites.h"
 #include "screen.h"
+#include "random.h"
 
 #include "SDL.h"
 #include "stdlib.h"
@@ -59,10 +60,10 @@ void sts_init(int sn, int nstar) {
     num_stars = nstar;
 
     for (int t = 0; t < num_stars; t++) {
-        stars[t].x = rand() / (RAND_MAX / SCREEN_WIDTH) - SPR_STARWID;
-        stars[t].y = rand() / (RAND_MAX / SCREEN_HEIGHT) - SPR_STARHEI;
+        stars[t].x = rnd_range(RND_COSMETIC, SCREEN_WIDTH) - SPR_STARWID;
+        stars[t].y = rnd_range(RND_COSMETIC, SCREEN_HEIGHT) - SPR_STARHEI;
         stars[t].state = 0;
-        stars[t].size = rand() / (RAND_MAX / 7);
+        stars[t].size = rnd_range(RND_COSMETIC, 7);
     }
 
     star_spr_nr = sn;
@@ -79,7 +80,7 @@ void sts_blink(void) {
     for (int t = 0; t < num_stars; t++) {
         if (stars[t].state > 0)
             stars[t].state = (stars[t].state + 1) % 4;
-        else if (!(rand() & 0xff))
+        else if (!(rnd_next(RND_COSMETIC) & 0xff))
             stars[t].state++;
     }
 }
@@ -91,21 +92,21 @@ void sts_move(long x, long y) {
         stars[t].x += starstep * x;
         stars[t].y += y;
         if (stars[t].x > SCREEN_WIDTH) {
-            stars[t].x = rand() / (RAND_MAX / starstep) - SPR_STARWID;
-            stars[t].y = rand() / (RAND_MAX / SCREEN_HEIGHT);
+            stars[t].x = rnd_range(RND_COSMETIC, starstep) - SPR_STARWID;
+            stars[t].y = rnd_range(RND_COSMETIC, SCREEN_HEIGHT);
         } else {
             if (stars[t].x < -SPR_STARWID) {
-                stars[t].x = SCREEN_WIDTH - rand() / (RAND_MAX / starstep);
-                stars[t].y = rand() / (RAND_MAX / SCREEN_HEIGHT);
+                stars[t].x = SCREEN_WIDTH - rnd_range(RND_COSMETIC, starstep);
+                stars[t].y = rnd_range(RND_COSMETIC, SCREEN_HEIGHT);
             }
         }
         if (stars[t].y > SCREEN_HEIGHT) {
             stars[t].y = -SPR_STARHEI;
-            stars[t].x = rand() / (RAND_MAX / (SCREEN_WIDTH + SPR_STARWID)) - SPR_STARWID;
+            stars[t].x = rnd_range(RND_COSMETIC, SCREEN_WIDTH + SPR_STARWID) - SPR_STARWID;
         } else {
             if (stars[t].y < -SPR_STARHEI) {
                 stars[t].y = SCREEN_HEIGHT;
-                stars[t].x = rand() / (RAND_MAX / (SCREEN_WIDTH + SPR_STARWID)) - SPR_STARWID;
+                stars[t].x = rnd_range(RND_COSMETIC, SCREEN_WIDTH + SPR_STARWID) - SPR_STARWID;
             }
         }
     }
@@ -0,0 +1,134 @@
+/* Tower Toppler - Nebulus
+ * Copyright (C) 2000-2006  Andreas Rver
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+#include "timing.h"
+
+#include "decl.h"
+
+#include <SDL.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef WIN32
+#include <time.h>
+#include <unistd.h>
+#endif
+
+#define MAX_PHASES 20
+
+static struct {
+    const char *name;
+    double end;
+} phases[MAX_PHASES];
+
+static int numphases;
+static bool started;
+static bool firstframe = true;
+static bool report;
+static char reportfile[MAX_PATH];
+static int benchfd = -1;
+
+#ifndef WIN32
+static struct timespec origin;
+#else
+static Uint32 origin;
+#endif
+
+double tim_ms(void) {
+#ifndef WIN32
+    struct timespec now;
+
+    if (!started) {
+        clock_gettime(CLOCK_MONOTONIC, &origin);
+        started = true;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - origin.tv_sec) * 1000.0 + (now.tv_nsec - origin.tv_nsec) / 1000000.0;
+#else
+    /* no better clock available here */
+    if (!started) {
+        origin = SDL_GetTicks();
+        started = true;
+    }
+    return SDL_GetTicks() - origin;
+#endif
+}
+
+void tim_mark(const char *phase) {
+    if (numphases < MAX_PHASES) {
+        phases[numphases].name = phase;
+        phases[numphases].end = tim_ms();
+        numphases++;
+    }
+}
+
+void tim_reportfile(const char *fname) {
+    snprintf(reportfile, sizeof(reportfile), "%s", fname ? fname : "");
+    report = true;
+}
+
+void tim_report(bool on) {
+    report = on;
+}
+
+void tim_benchmark(int fd) {
+    benchfd = fd;
+}
+
+void tim_print(FILE *out) {
+    double start = 0;
+
+    fprintf(out, "startup timeline:\n");
+    for (int i = 0; i < numphases; i++) {
+        fprintf(out, "  %-16s %9.3f ms  (at %9.3f ms)\n", phases[i].name, phases[i].end - start,
+                phases[i].end);
+        start = phases[i].end;
+    }
+}
+
+void tim_frame(void) {
+    if (!firstframe)
+        return;
+
+    firstframe = false;
+    tim_mark("first frame");
+
+    if (report) {
+        FILE *out = reportfile[0] ? fopen(reportfile, "w") : stdout;
+
+        if (out) {
+            tim_print(out);
+            if (out != stdout)
+                fclose(out);
+        }
+    }
+
+#ifndef WIN32
+    if (benchfd >= 0) {
+        char line[30];
+        int len = snprintf(line, sizeof(line), "%.3f\n", phases[numphases - 1].end);
+
+        if (write(benchfd, line, len) != len)
+            exit(1);
+        close(benchfd);
+        exit(0);
+    }
+#endif
+}
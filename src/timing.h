@@ -0,0 +1,49 @@
+/* Tower Toppler - Nebulus
+ * Copyright (C) 2000-2006  Andreas Rver
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+#ifndef TIMING_H
+#define TIMING_H
+
+#include <stdio.h>
+
+/* this module records how long the different phases of the startup
+ * take, so that we can see where the time goes and find regressions */
+
+/* milliseconds since the first call, with sub millisecond resolution */
+double tim_ms(void);
+
+/* the phase with the given name ends now, it started with the
+ * previous mark or at program start */
+void tim_mark(const char *phase);
+
+/* call this whenever a frame is shown, the first call ends the
+ * startup, marks the last phase and writes the report */
+void tim_frame(void);
+
+/* where to write the report at the end of the startup, NULL for stdout */
+void tim_reportfile(const char *fname);
+void tim_report(bool on);
+
+/* in benchmark mode the program writes the time to the first frame
+ * to the given file descriptor and exits at the first frame */
+void tim_benchmark(int fd);
+
+/* prints the timeline */
+void tim_print(FILE *out);
+
+#endif
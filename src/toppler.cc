@@ -18,55 +18,58 @@
 
 #include "toppler.h"
 
+#include "decl.h"
 #include "robots.h"
 #include "elevators.h"
 #include "snowball.h"
 #include "level.h"
 #include "sound.h"
+#include "events.h"
+#include "snapshot.h"
 
 /* the position of the animal on the tower */
-int anglepos;
-long verticalpos;
+GAME_STATE int anglepos;
+GAME_STATE long verticalpos;
 
 /* the state of the toppler */
-int state, substate;
+GAME_STATE int state, substate;
 
 /* have we entered the target door */
-bool targetdoor;
+GAME_STATE bool targetdoor;
 
 /* some help variables for the falling toppler */
-int falling_howmuch;
-long falling_direction;
-int falling_minimum;
+GAME_STATE int falling_howmuch;
+GAME_STATE long falling_direction;
+GAME_STATE int falling_minimum;
 
 /* some variables defining how to jump */
-int jumping_direction, jumping_how, jumping_howlong;
+GAME_STATE int jumping_direction, jumping_how, jumping_howlong;
 
 /* used to time the turning of the tower when a door was entered */
-int door_turner;
+GAME_STATE int door_turner;
 
-long elevator_direction;
+GAME_STATE long elevator_direction;
 
 /* how much must the toppler topple down */
-int topple_min;
+GAME_STATE int topple_min;
 
 /* used when on an elevator to delay the toppling until we
  reached the next brick layer */
-bool topple_delay;
+GAME_STATE bool topple_delay;
 
 /* technique points; is decreased each time the toppler gets
  thrown down */
-int technic;
+GAME_STATE int technic;
 
 /* true if the toppler is visible */
-static bool tvisible;
+static GAME_STATE bool tvisible;
 /* should the output routine put an elevator
  platform below the toppler ? */
-static bool on_elevator;
+static GAME_STATE bool on_elevator;
 /* the actual shape of the toppler */
-static int topplershape;
+static GAME_STATE int topplershape;
 /* the direction the toppler is looking at */
-static bool look_left;
+static GAME_STATE bool look_left;
 
 /* values for status */
 #define STATE_STANDING 0
@@ -110,11 +113,14 @@ static int testunderground(int verticalpos, int anglepos, bool look_left) {
     int r = (verticalpos / 4) - 1;
     int c = ((anglepos + 0x7a) / 8) & 0xf;
 
-    erg = (lev_is_empty(r, c) || lev_is_door(r, c)) ? 0 : 2;
+    /* the blocks of the row below we can stand on */
+    Uint16 solid = ~(lev_rowmask(TMASK_EMPTY, r) | lev_rowmask(TMASK_DOOR, r));
 
-    c = ((anglepos + 0x7a) / 8 + 1) & 0xf;
+    erg = (solid & (1 << c)) ? 2 : 0;
 
-    if ((!lev_is_empty(r, c)) && (!lev_is_door(r, c)))
+    c = (c + 1) & 0xf;
+
+    if (solid & (1 << c))
         erg++;
 
     erg = unter[(anglepos & 0x7) * 4 + erg];
@@ -192,7 +198,7 @@ static void shooting(void) {
     state = STATE_SHOOTING;
     substate = 0;
     topplershape = 0;
-    ttsounds::instance()->startsound(SND_SHOOT);
+    evt_sound(SND_SHOOT);
 }
 
 static void door(void) {
@@ -231,8 +237,8 @@ static void drown(void) {
     substate = 0;
     verticalpos = 0;
 
-    ttsounds::instance()->setsoundvol(SND_SPLASH, MIX_MAX_VOLUME*3/4);
-    ttsounds::instance()->startsound(SND_SPLASH);
+    evt_soundvol(SND_SPLASH, MIX_MAX_VOLUME*3/4);
+    evt_sound(SND_SPLASH);
 }
 
 static void topple(void) {
@@ -341,7 +347,7 @@ void top_updatetoppler(int left_right, int up_down, bool space) {
                 }
             } else {
                 if ((substate == 2) || (substate == 6))
-                    ttsounds::instance()->startsound(SND_TAP);
+                    evt_sound(SND_TAP);
                 if (left_right == -1) {
                     if (look_left)
                         turn();
@@ -418,7 +424,7 @@ void top_updatetoppler(int left_right, int up_down, bool space) {
             } while (!((inh == 0) || movetoppler(0L, inh)));
             if (b < 0) {
                 walking();
-                ttsounds::instance()->startsound(SND_TAP);
+                evt_sound(SND_TAP);
             } else {
                 substate++;
                 if (substate >= jumping_howlong) {
@@ -446,7 +452,7 @@ void top_updatetoppler(int left_right, int up_down, bool space) {
                 do {
                     falling_howmuch--;
                 } while (falling_howmuch && !movetoppler(0, -falling_howmuch));
-                ttsounds::instance()->startsound(SND_TAP);
+                evt_sound(SND_TAP);
                 if (falling_howmuch != 0) {
                     falling_howmuch++;
                     if (falling_howmuch > 4)
@@ -478,7 +484,7 @@ void top_updatetoppler(int left_right, int up_down, bool space) {
         topplershape = umdreh[substate];
         substate++;
         if ((substate == 4) || (substate == 7))
-            ttsounds::instance()->startsound(SND_TAP);
+            evt_sound(SND_TAP);
         if (substate == 4)
             look_left = !look_left;
         if (substate == 7)
@@ -555,12 +561,12 @@ void top_updatetoppler(int left_right, int up_down, bool space) {
         default:
             if (substate >= 13 && substate <= 28) {
                 if ((door_turner % 4) == 0)
-                    ttsounds::instance()->startsound(SND_DOORTAP);
+                    evt_sound(SND_DOORTAP);
 
                 tvisible = false;
                 if (targetdoor) {
                     state = STATE_FINISHED;
-                    ttsounds::instance()->startsound(SND_FANFARE);
+                    evt_sound(SND_FANFARE);
                 } else {
                     if (look_left)
                         anglepos += 2;
@@ -604,7 +610,7 @@ void top_updatetoppler(int left_right, int up_down, bool space) {
             substate++;
             on_elevator = true;
             ele_activate((Sint8) elevator_direction);
-            ttsounds::instance()->startsound(SND_TICK);
+            evt_sound(SND_TICK);
             return;
         }
         verticalpos += elevator_direction;
@@ -617,7 +623,7 @@ void top_updatetoppler(int left_right, int up_down, bool space) {
                 walking();
             } else {
                 ele_move();
-                ttsounds::instance()->startsound(SND_TICK);
+                evt_sound(SND_TICK);
             }
         }
         break;
@@ -649,7 +655,7 @@ void top_updatetoppler(int left_right, int up_down, bool space) {
 
     case STATE_DROWN:
         if (substate == 0x8)
-            ttsounds::instance()->startsound(SND_DROWN);
+            evt_sound(SND_DROWN);
         if (substate < 0x18) {
             topplershape = substate / 4 + 31;
             substate++;
@@ -803,3 +809,48 @@ void top_sidemove(void) {
     }
 }
 
+void top_savestate(unsigned char *&p) {
+    SNP_PUT(p, anglepos);
+    SNP_PUT(p, verticalpos);
+    SNP_PUT(p, state);
+    SNP_PUT(p, substate);
+    SNP_PUT(p, targetdoor);
+    SNP_PUT(p, falling_howmuch);
+    SNP_PUT(p, falling_direction);
+    SNP_PUT(p, falling_minimum);
+    SNP_PUT(p, jumping_direction);
+    SNP_PUT(p, jumping_how);
+    SNP_PUT(p, jumping_howlong);
+    SNP_PUT(p, door_turner);
+    SNP_PUT(p, elevator_direction);
+    SNP_PUT(p, topple_min);
+    SNP_PUT(p, topple_delay);
+    SNP_PUT(p, technic);
+    SNP_PUT(p, tvisible);
+    SNP_PUT(p, on_elevator);
+    SNP_PUT(p, topplershape);
+    SNP_PUT(p, look_left);
+}
+
+void top_loadstate(const unsigned char *&p) {
+    SNP_GET(p, anglepos);
+    SNP_GET(p, verticalpos);
+    SNP_GET(p, state);
+    SNP_GET(p, substate);
+    SNP_GET(p, targetdoor);
+    SNP_GET(p, falling_howmuch);
+    SNP_GET(p, falling_direction);
+    SNP_GET(p, falling_minimum);
+    SNP_GET(p, jumping_direction);
+    SNP_GET(p, jumping_how);
+    SNP_GET(p, jumping_howlong);
+    SNP_GET(p, door_turner);
+    SNP_GET(p, elevator_direction);
+    SNP_GET(p, topple_min);
+    SNP_GET(p, topple_delay);
+    SNP_GET(p, technic);
+    SNP_GET(p, tvisible);
+    SNP_GET(p, on_elevator);
+    SNP_GET(p, topplershape);
+    SNP_GET(p, look_left);
+}
@@ -86,4 +86,9 @@ void top_show(int shape, int vpos, int apos);
  push the animal aside  */
 void top_sidemove(void);
 
+/* snapshot support, see snapshot.h. Writes the state of the toppler
+ to p or reads it back, p is moved behind the data */
+void top_savestate(unsigned char *&p);
+void top_loadstate(const unsigned char *&p);
+
 #endif
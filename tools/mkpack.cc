@@ -0,0 +1,118 @@
+/* Tower Toppler - Nebulus
+ * Copyright (C) 2000-2006  Andreas Rver
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+/* converter that creates the asset pack (see assetpack.h) out of
+ * toppler.dat. It links with all the sources of the game except main.cc
+ * and runs the normal loading code with the pack recorder switched on,
+ * once with and once without alpha blending, so that the pack fits
+ * every configuration.
+ *
+ * build (from this directory):
+ *   g++ -I../src -o mkpack mkpack.cc <all .cc files of ../src except main.cc> \
+ *       `sdl-config --cflags --libs` -lSDL_mixer -lz
+ *
+ * usage: mkpack [-z] [outputfile]
+ *   -z  deflate the blocks, smaller but slower to load
+ *
+ * The sprites are stored in the pixel format of the display, so the
+ * converter must run with the same display depth as the game, the pack
+ * is ignored by the game when the format doesn't fit.
+ */
+
+#include "archi.h"
+#include "assetpack.h"
+#include "screen.h"
+#include "sprites.h"
+#include "configuration.h"
+#include "menu.h"
+#include "decl.h"
+
+#include <SDL.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static void setalpha(bool on) {
+    config.use_alpha_sprites(on);
+    config.use_alpha_font(on);
+    config.use_alpha_layers(on);
+}
+
+int main(int argc, char *argv[]) {
+    const char *outname = PAK_FILENAME;
+    bool compress = false;
+
+    for (int t = 1; t < argc; t++) {
+        if (!strcmp(argv[t], "-z"))
+            compress = true;
+        else if (argv[t][0] == '-') {
+            printf("usage: %s [-z] [outputfile]\n", argv[0]);
+            return 1;
+        } else
+            outname = argv[t];
+    }
+
+    /* we don't need a window, only the display format */
+    if (!getenv("SDL_VIDEODRIVER"))
+        putenv((char *) "SDL_VIDEODRIVER=dummy");
+
+    if (SDL_Init(SDL_INIT_VIDEO) < 0) {
+        printf("could not initialize SDL\n");
+        return 1;
+    }
+
+    dataarchive = new archive(open_data_file("toppler.dat"));
+
+    bool sprites = config.use_alpha_sprites();
+    bool font = config.use_alpha_font();
+    bool layers = config.use_alpha_layers();
+
+    pak_record_begin(dataarchive, compress);
+
+    setalpha(false);
+    scr_init();
+    men_init();
+
+    setalpha(true);
+    fontsprites.freedata();
+    objectsprites.freedata();
+    layersprites.freedata();
+    scr_reload_sprites(RL_FONT | RL_OBJECTS | RL_SCROLLER);
+    men_init();
+
+    bool ok = pak_record_finish(outname);
+
+    scr_done();
+
+    /* leave the users configuration as it was */
+    config.use_alpha_sprites(sprites);
+    config.use_alpha_font(font);
+    config.use_alpha_layers(layers);
+
+    delete dataarchive;
+    SDL_Quit();
+
+    if (!ok) {
+        printf("could not write %s\n", outname);
+        return 1;
+    }
+
+    printf("%s written\n", outname);
+    return 0;
+}
@@ -0,0 +1,676 @@
+/* Tower Toppler - Nebulus
+ * Copyright (C) 2000-2006  Andreas Rver
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+/* tower solver. It searches the fastest way through one tower of a
+ * mission with the game logic itself (gam_simstep()) and prints the
+ * minimum number of ticks to the target door and how much of the tower
+ * time is left then. It links with all the sources of the game except
+ * main.cc.
+ *
+ * build (from this directory):
+ *   g++ -I../src -o solve solve.cc <all .cc files of ../src except main.cc> \
+ *       `sdl-config --cflags --libs` -lSDL_mixer -lz
+ *
+ * usage: solve [-jN] [-wW] [-sS] [-nN] [-rSEED] [-oFILE] mission tower
+ *   -jN     use N threads instead of one per processor
+ *   -wW     weight of the estimate, bigger values find a first way
+ *           sooner, the result is the fastest way in any case (default 1)
+ *   -sS     keep each key combination for S ticks, faster but the result
+ *           is only the fastest way with this restriction (default 1)
+ *   -nN     give up after N million states (default 20)
+ *   -rSEED  the seed for the game logic, default is the seed of the
+ *           tower demo. The robots depend on it, so does the result
+ *   -oFILE  save the tower with the found way as its demo into FILE
+ *           in the directory where the editor keeps its towers
+ *
+ * The search is a best first search over snapshots of the game (see
+ * snapshot.h). The states are ordered by the ticks used plus an estimate
+ * of the ticks still needed that is never too big: the height still to
+ * climb or the way around the tower to the target door, divided by the
+ * fastest possible movement. To get away from places where the toppler
+ * only walks around, states in fields of the tower that many states
+ * reached before come later. States that are the same except for the
+ * time and the points are only kept when they are reached faster than
+ * before. Each thread has its own queue of states and takes from the
+ * others when it runs empty. The search ends when no state is left that
+ * could still be faster than the best way found, then the way found is
+ * the fastest one.
+ */
+
+#include "archi.h"
+#include "level.h"
+#include "game.h"
+#include "toppler.h"
+#include "snapshot.h"
+#include "keyb.h"
+#include "timing.h"
+#include "decl.h"
+
+#include <SDL.h>
+#include <SDL_thread.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/* no tick moves the toppler more than this up or around the tower */
+#define SLV_MAXRISE 4
+#define SLV_MAXTURN 4
+
+/* the node ids are taken in blocks, so that the threads seldom meet */
+#define SLV_IDBLOCK 4096
+
+/* the columns of the tower, TOWERWID in level.cc */
+#define SLV_COLUMNS 16
+
+#define SLV_SHARDS 1024
+#define SLV_MAXTHREADS 256
+
+/* every possible combination of the keys the game logic looks at */
+#define SLV_KEYS 18
+
+/* the way to a state, the parent state and the keys pressed to get
+ from there to here */
+typedef struct {
+    Uint32 parent;
+    Uint16 keys;
+} slv_node;
+
+/* a state waiting to be expanded. data holds the snapshot as delta
+ to the snapshot of the start, or the complete snapshot if raw is set */
+typedef struct {
+    Uint32 f, g, h;
+    Uint32 node;
+    Uint32 len;
+    bool raw;
+    Uint8 *data;
+} slv_open;
+
+typedef struct {
+    slv_open *heap;
+    int count, size;
+    SDL_mutex *lock;
+} slv_queue;
+
+/* the visited states, hash of the key of the state (see snp_savekey())
+ and the fewest ticks it was reached with */
+typedef struct {
+    Uint64 *hash;
+    Uint32 *g;
+    Uint32 size, count;
+    SDL_mutex *lock;
+} slv_shard;
+
+static Uint16 keyset[SLV_KEYS];
+
+static Uint16 mission;
+static Uint16 tower;
+static Uint32 seed;
+static int steplen = 1;
+static int weight = 1;
+
+/* the position where the toppler enters the target door */
+static int targetpos;
+static int targetfrom, targetto;
+
+static Uint8 root[SNP_MAXSIZE];
+static Uint32 rootlen;
+
+static slv_node *nodes;
+static Uint32 maxnodes, nodecount;
+static SDL_mutex *nodelock;
+
+static slv_queue queues[SLV_MAXTHREADS];
+static slv_shard shards[SLV_SHARDS];
+static int threads;
+
+static SDL_mutex *statelock;
+static int idle, running;
+static bool full;
+
+/* the best way found so far */
+static volatile Uint32 best = 0xffffffff;
+static Uint32 bestnode, bestticks;
+static Uint16 bestkeys;
+
+static Uint32 expanded, generated, duplicates;
+
+/* how often states in each field of the tower were stored by
+ each thread, for the rows of the tower */
+static Uint32 (*visits[SLV_MAXTHREADS])[SLV_COLUMNS];
+static int visitrows;
+
+/* the estimate of the ticks still needed from the current state */
+static Uint32 estimate(void) {
+    int h = targetpos - top_verticalpos();
+    int a = top_anglepos();
+    int up = (h > 0) ? (h + SLV_MAXRISE - 1) / SLV_MAXRISE : 0;
+    int around = 0;
+
+    if ((a < targetfrom) || (a > targetto)) {
+        int l = (targetfrom - a) & 0x7f;
+        int r = (a - targetto) & 0x7f;
+        around = ((l < r ? l : r) + SLV_MAXTURN - 1) / SLV_MAXTURN;
+    }
+
+    return (up > around) ? up : around;
+}
+
+static Uint64 hash(const Uint8 *p, Uint32 len) {
+    Uint64 h = 0xcbf29ce484222325ULL;
+
+    while (len--)
+        h = (h ^ *p++) * 0x100000001b3ULL;
+
+    /* 0 marks empty places in the table */
+    return h ? h : 1;
+}
+
+/* returns true, when the state wasn't reached with g or less ticks before */
+static bool visit(Uint64 h, Uint32 g) {
+    slv_shard &s = shards[h % SLV_SHARDS];
+    bool result = true;
+
+    SDL_LockMutex(s.lock);
+
+    if (2 * (s.count + 1) > s.size) {
+        Uint32 size = s.size ? 2 * s.size : 1024;
+        Uint64 *nh = new Uint64[size];
+        Uint32 *ng = new Uint32[size];
+
+        memset(nh, 0, size * sizeof(Uint64));
+        for (Uint32 i = 0; i < s.size; i++)
+            if (s.hash[i]) {
+                Uint32 j = (s.hash[i] / SLV_SHARDS) & (size - 1);
+                while (nh[j])
+                    j = (j + 1) & (size - 1);
+                nh[j] = s.hash[i];
+                ng[j] = s.g[i];
+            }
+
+        if (s.size) {
+            delete[] s.hash;
+            delete[] s.g;
+        }
+        s.hash = nh;
+        s.g = ng;
+        s.size = size;
+    }
+
+    Uint32 j = (h / SLV_SHARDS) & (s.size - 1);
+    while (s.hash[j] && (s.hash[j] != h))
+        j = (j + 1) & (s.size - 1);
+
+    if (!s.hash[j]) {
+        s.hash[j] = h;
+        s.g[j] = g;
+        s.count++;
+    } else if (g < s.g[j])
+        s.g[j] = g;
+    else
+        result = false;
+
+    SDL_UnlockMutex(s.lock);
+    return result;
+}
+
+/* the order in the queues, fewest estimated ticks first and for the
+ same estimate the state closest to the target */
+static bool before(const slv_open &a, const slv_open &b) {
+    if (a.f != b.f)
+        return a.f < b.f;
+    return a.g > b.g;
+}
+
+static void push(slv_queue &q, const slv_open &o) {
+    SDL_LockMutex(q.lock);
+
+    if (q.count == q.size) {
+        q.size = q.size ? 2 * q.size : 1024;
+        q.heap = (slv_open *) realloc(q.heap, q.size * sizeof(slv_open));
+        assert_msg(q.heap != NULL, "out of memory");
+    }
+
+    int i = q.count++;
+    while (i && before(o, q.heap[(i - 1) / 2])) {
+        q.heap[i] = q.heap[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    q.heap[i] = o;
+
+    SDL_UnlockMutex(q.lock);
+}
+
+static bool pop(slv_queue &q, slv_open &o) {
+    SDL_LockMutex(q.lock);
+
+    if (!q.count) {
+        SDL_UnlockMutex(q.lock);
+        return false;
+    }
+
+    o = q.heap[0];
+    slv_open last = q.heap[--q.count];
+    int i = 0;
+
+    while (2 * i + 1 < q.count) {
+        int c = 2 * i + 1;
+        if ((c + 1 < q.count) && before(q.heap[c + 1], q.heap[c]))
+            c++;
+        if (!before(q.heap[c], last))
+            break;
+        q.heap[i] = q.heap[c];
+        i = c;
+    }
+    if (q.count)
+        q.heap[i] = last;
+
+    SDL_UnlockMutex(q.lock);
+    return true;
+}
+
+/* gets the next state for thread me, from its own queue or from the
+ others. Returns false when there is no work left for anybody */
+static bool take(int me, slv_open &o) {
+    bool waiting = false;
+
+    while (true) {
+        for (int t = 0; t < threads; t++)
+            if (pop(queues[(me + t) % threads], o)) {
+                if (waiting) {
+                    SDL_LockMutex(statelock);
+                    idle--;
+                    SDL_UnlockMutex(statelock);
+                }
+                return true;
+            }
+
+        SDL_LockMutex(statelock);
+        if (!waiting) {
+            idle++;
+            waiting = true;
+        }
+        bool done = (idle == threads) || full;
+        SDL_UnlockMutex(statelock);
+
+        if (done)
+            return false;
+
+        SDL_Delay(1);
+    }
+}
+
+/* returns a new node, or 0 when there is no room left */
+static Uint32 newnode(Uint32 &next, Uint32 &end, Uint32 parent, Uint16 keys) {
+    if (next == end) {
+        SDL_LockMutex(nodelock);
+        if (nodecount + SLV_IDBLOCK > maxnodes) {
+            full = true;
+            SDL_UnlockMutex(nodelock);
+            return 0;
+        }
+        next = nodecount;
+        end = nodecount += SLV_IDBLOCK;
+        SDL_UnlockMutex(nodelock);
+    }
+
+    nodes[next].parent = parent;
+    nodes[next].keys = keys;
+    return next++;
+}
+
+static void found(Uint32 g, Uint32 node, Uint16 keys, Uint32 ticks) {
+    SDL_LockMutex(statelock);
+    if (g < best) {
+        best = g;
+        bestnode = node;
+        bestkeys = keys;
+        bestticks = ticks;
+    }
+    SDL_UnlockMutex(statelock);
+}
+
+static int worker(void *arg) {
+    int me = (long) arg;
+    Uint32 next = 0, end = 0;
+    Uint32 exp = 0, gen = 0, dup = 0;
+
+    Uint8 *bufs = new Uint8[4 * SNP_MAXSIZE];
+    Uint8 *state = bufs;
+    Uint8 *child = bufs + SNP_MAXSIZE;
+    Uint8 *key = bufs + 2 * SNP_MAXSIZE;
+    Uint8 *delta = bufs + 3 * SNP_MAXSIZE;
+
+    snp_loop loop;
+    slv_open o;
+
+    /* the game logic of this thread has to be set up for the tower
+     before the snapshots can be restored */
+    lev_loadmission(mission);
+    lev_selecttower(tower);
+    gam_simstart(seed, loop);
+
+    visits[me] = new Uint32[visitrows][SLV_COLUMNS];
+    memset(visits[me], 0, visitrows * sizeof(visits[me][0]));
+
+    while (!full && take(me, o)) {
+
+        memcpy(state, root, rootlen);
+        if (o.raw)
+            memcpy(state, o.data, o.len);
+        else
+            snp_undelta(o.data, o.len, state);
+        delete[] o.data;
+
+        if (o.g + o.h >= best)
+            continue;
+
+        exp++;
+
+        for (int k = 0; k < SLV_KEYS; k++) {
+            bool playing = true;
+            int t;
+
+            snp_restore(state, loop);
+
+            for (t = 0; playing && (t < steplen); t++)
+                playing = gam_simstep(keyset[k], loop);
+
+            Uint32 g = o.g + t;
+
+            if (top_targetreached()) {
+                found(g, o.node, keyset[k], t);
+                continue;
+            }
+
+            /* died or the time is over */
+            if (!playing)
+                continue;
+
+            Uint32 h = estimate();
+            if (g + h >= best)
+                continue;
+
+            if (!visit(hash(key, snp_savekey(key)), g)) {
+                dup++;
+                continue;
+            }
+
+            slv_open c;
+
+            c.node = newnode(next, end, o.node, keyset[k]);
+            if (!c.node)
+                break;
+
+            Uint32 len = snp_save(child, loop);
+            Uint32 dlen = (len == rootlen) ? snp_delta(root, child, len, delta) : 0;
+
+            int row = top_verticalpos() / 4;
+
+            c.g = g;
+            c.h = h;
+            c.f = g + weight * h + visits[me][row < visitrows ? row : visitrows - 1][top_anglepos() / 8]++;
+            c.raw = !dlen;
+            c.len = dlen ? dlen : len;
+            c.data = new Uint8[c.len];
+            memcpy(c.data, dlen ? delta : child, c.len);
+
+            push(queues[me], c);
+            gen++;
+        }
+    }
+
+    /* with a full node table the rest of the queues is thrown away */
+    while (pop(queues[me], o))
+        delete[] o.data;
+
+    SDL_LockMutex(statelock);
+    expanded += exp;
+    generated += gen;
+    duplicates += dup;
+    running--;
+    SDL_UnlockMutex(statelock);
+
+    delete[] visits[me];
+    delete[] bufs;
+    lev_donethread();
+    return 0;
+}
+
+static int processors(void) {
+#ifdef _SC_NPROCESSORS_ONLN
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    if (n > 0)
+        return n;
+#endif
+    return 1;
+}
+
+/* finds the lowest row with a part of the target door, the toppler
+ enters the door there. Returns false if there is no target door */
+static bool findtarget(void) {
+    for (int r = 0; r < lev_towerrows(); r++)
+        for (int c = 0; c < SLV_COLUMNS; c++)
+            switch (lev_tower(r, c)) {
+            case TB_DOOR_TARGET:
+            case TB_STICK_DOOR_TARGET:
+            case TB_ELEV_DOOR_TARGET:
+                targetpos = r * 4;
+                targetfrom = c * 8;
+                targetto = c * 8 + 7;
+                return true;
+            }
+    return false;
+}
+
+int main(int argc, char *argv[]) {
+    const char *missionname = NULL;
+    const char *outname = NULL;
+    int towernr = 0;
+    int million = 20;
+    bool seedgiven = false;
+    bool usage = false;
+
+    threads = processors();
+
+    for (int t = 1; t < argc; t++) {
+        if (!strncmp(argv[t], "-j", 2) && (atoi(argv[t] + 2) > 0))
+            threads = atoi(argv[t] + 2);
+        else if (!strncmp(argv[t], "-w", 2) && (atoi(argv[t] + 2) > 0))
+            weight = atoi(argv[t] + 2);
+        else if (!strncmp(argv[t], "-s", 2) && (atoi(argv[t] + 2) > 0))
+            steplen = atoi(argv[t] + 2);
+        else if (!strncmp(argv[t], "-n", 2) && (atoi(argv[t] + 2) > 0))
+            million = atoi(argv[t] + 2);
+        else if (!strncmp(argv[t], "-r", 2) && argv[t][2]) {
+            seed = strtoul(argv[t] + 2, NULL, 0);
+            seedgiven = true;
+        } else if (!strncmp(argv[t], "-o", 2) && argv[t][2])
+            outname = argv[t] + 2;
+        else if ((argv[t][0] != '-') && !missionname)
+            missionname = argv[t];
+        else if ((argv[t][0] != '-') && !towernr)
+            towernr = atoi(argv[t]);
+        else
+            usage = true;
+    }
+
+    if (usage || !missionname || (towernr < 1)) {
+        printf("usage: %s [-jN] [-wW] [-sS] [-nN] [-rSEED] [-oFILE] mission tower\n", argv[0]);
+        return 1;
+    }
+
+    if (threads > SLV_MAXTHREADS)
+        threads = SLV_MAXTHREADS;
+
+    if (SDL_Init(0) < 0) {
+        printf("could not initialize SDL\n");
+        return 1;
+    }
+
+    dataarchive = new archive(open_data_file("toppler.dat"));
+
+    /* the mission list is shared by all threads, it must be complete
+     * before they start */
+    lev_findmissions();
+
+    for (mission = 0; mission < lev_missionnumber(); mission++)
+        if (!strcmp(lev_missionname(mission), missionname))
+            break;
+
+    if ((mission == lev_missionnumber()) || !lev_loadmission(mission)) {
+        printf("Mission %s not found.\n", missionname);
+        return 1;
+    }
+
+    if (towernr > lev_towercount()) {
+        printf("The mission has only %i towers.\n", lev_towercount());
+        return 1;
+    }
+
+    tower = towernr - 1;
+    lev_selecttower(tower);
+    visitrows = lev_towerrows() + 1;
+
+    if (!seedgiven)
+        seed = lev_towerdemoseed();
+
+    if (!findtarget()) {
+        printf("The tower has no target door.\n");
+        return 1;
+    }
+
+    int i = 0;
+    for (int lr = 0; lr < 3; lr++)
+        for (int ud = 0; ud < 3; ud++)
+            for (int fire = 0; fire < 2; fire++)
+                keyset[i++] = (lr == 1 ? left_key : 0) | (lr == 2 ? right_key : 0)
+                        | (ud == 1 ? up_key : 0) | (ud == 2 ? down_key : 0)
+                        | (fire ? fire_key : 0);
+
+    nodelock = SDL_CreateMutex();
+    statelock = SDL_CreateMutex();
+    for (int s = 0; s < SLV_SHARDS; s++)
+        shards[s].lock = SDL_CreateMutex();
+    for (int t = 0; t < threads; t++)
+        queues[t].lock = SDL_CreateMutex();
+
+    /* the start of the search */
+    snp_loop loop;
+    gam_simstart(seed, loop);
+    rootlen = snp_save(root, loop);
+
+    static Uint8 key[SNP_MAXSIZE];
+    visit(hash(key, snp_savekey(key)), 0);
+
+    maxnodes = million * 1000000;
+    nodes = new slv_node[maxnodes];
+    nodes[0].parent = 0;
+    nodes[0].keys = 0;
+    nodecount = SLV_IDBLOCK;
+
+    slv_open o;
+    o.g = 0;
+    o.h = estimate();
+    o.f = weight * o.h;
+    o.node = 0;
+    o.raw = true;
+    o.len = rootlen;
+    o.data = new Uint8[rootlen];
+    memcpy(o.data, root, rootlen);
+    push(queues[0], o);
+
+    printf("%s, tower %i \"%s\", time %i, seed %u, %i threads\n", missionname, towernr,
+            lev_towername(), lev_towertime(), seed, threads);
+
+    double start = tim_ms();
+
+    running = threads;
+    SDL_Thread **th = new SDL_Thread *[threads];
+    for (int t = 0; t < threads; t++)
+        th[t] = SDL_CreateThread(worker, (void *) (long) t);
+
+    /* show the progress while the threads work */
+    while (true) {
+        SDL_Delay(1000);
+        SDL_LockMutex(statelock);
+        bool done = !running;
+        SDL_UnlockMutex(statelock);
+        if (done)
+            break;
+        printf("%u states, best %s%u ticks\n", nodecount, (best == 0xffffffff) ? "none " : "",
+                (best == 0xffffffff) ? 0 : best);
+        fflush(stdout);
+    }
+
+    for (int t = 0; t < threads; t++)
+        SDL_WaitThread(th[t], NULL);
+    delete[] th;
+
+    double ms = tim_ms() - start;
+
+    printf("%u states expanded, %u stored, %u duplicates in %.1f s, %.0f states/s\n",
+            expanded, generated, duplicates, ms / 1000, ms > 0 ? expanded * 1000.0 / ms : 0.0);
+
+    if (best == 0xffffffff) {
+        printf(full ? "No way found, the search gave up.\n" : "The tower can't be finished.\n");
+        return 1;
+    }
+
+    /* collect the keys backwards from the target */
+    int demolen = best;
+    Uint16 *demo = new Uint16[demolen];
+    int pos = demolen;
+
+    for (Uint32 t = 0; t < bestticks; t++)
+        demo[--pos] = bestkeys;
+    for (Uint32 n = bestnode; n; n = nodes[n].parent)
+        for (int t = 0; t < steplen; t++)
+            demo[--pos] = nodes[n].keys;
+
+    /* check the way with the normal simulation, the tower is changed
+     * by playing it, so it is restored before it is saved */
+    gam_simresult res;
+    unsigned char *tower;
+
+    lev_save(tower);
+    gam_newgame();
+    gam_simulate(demo, demolen, seed, res);
+    lev_restore(tower);
+
+    printf("%s way: %i ticks, time left %i of %i%s\n", full ? "Best found" : "Fastest",
+            demolen, res.resttime, lev_towertime(),
+            (res.result == GAME_FINISHED) ? "" : ", but the replay doesn't finish");
+
+    if (outname && (res.result == GAME_FINISHED)) {
+        lev_set_towerdemo(demolen, demo, seed);
+        if (!lev_savetower(outname))
+            printf("could not write %s\n", outname);
+    } else {
+        if (outname)
+            printf("%s not written\n", outname);
+        delete[] demo;
+    }
+
+    lev_done();
+    delete dataarchive;
+    SDL_Quit();
+
+    return (res.result == GAME_FINISHED) ? 0 : 1;
+}
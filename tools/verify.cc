@@ -0,0 +1,455 @@
+/* Tower Toppler - Nebulus
+ * Copyright (C) 2000-2006  Andreas Rver
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+/* batch verifier for submitted demos. It replays every demo file of a
+ * directory with the simulation of the game (gam_simulate()) on as many
+ * threads as there are processors and compares the outcome, the points
+ * and the time left with what the player claimed. It links with all the
+ * sources of the game except main.cc.
+ *
+ * The threads only run the game logic, which keeps its state per thread
+ * and reports sounds and the cross color as events (events.h) instead of
+ * calling the sound system and the screen. The verifier drops those
+ * events, nothing it does touches the sound system or the screen. With
+ * -j1 the demos are verified on the main thread without starting one.
+ *
+ * build (from this directory):
+ *   g++ -I../src -o verify verify.cc <all .cc files of ../src except main.cc> \
+ *       `sdl-config --cflags --libs` -lSDL_mixer -lz
+ *
+ * usage: verify [-jN] [-oREPORT] directory
+ *   -jN      use N threads instead of one per processor
+ *   -oREPORT write the report into the file REPORT instead of stdout
+ *
+ * The demo files are text files with sections like the tower files of the
+ * editor:
+ *
+ *   [mission]
+ *   Mission 1
+ *   [tower]
+ *   1                      (counted from 1)
+ *   [result]
+ *   finished               (finished, died, timeout or unfinished)
+ *   [points]
+ *   12345
+ *   [time]
+ *   420                    (time left)
+ *   [robots]
+ *   4                      (optional, 4 when missing)
+ *   [keys]
+ *   1800 3141592653        (number of keys and seed)
+ *   A12C3B140...           (the runs of keys, see dem_text() in demo.h)
+ *
+ * The keys section is the same as in those, the older form of the
+ * tower files with a [demo] section and one key state per line is
+ * read as well.
+ *
+ * Every demo is played as the first tower of a new game, so the points
+ * are those of this tower alone, including the bonus. The program returns
+ * 0 when all demos passed.
+ */
+
+#include "archi.h"
+#include "level.h"
+#include "game.h"
+#include "demo.h"
+#include "events.h"
+#include "timing.h"
+#include "decl.h"
+
+#include <SDL.h>
+#include <SDL_thread.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <dirent.h>
+
+#define MAXDEMOLEN 100000
+
+typedef enum {
+    RES_FINISHED,
+    RES_DIED,
+    RES_TIMEOUT,
+    RES_UNFINISHED,
+    NUM_RESULTS
+} vfy_result;
+
+static const char *resultstr[NUM_RESULTS] = {
+        "finished", "died", "timeout", "unfinished" };
+
+/* one demo file, the claim read from the file and what the simulation
+ * found */
+typedef struct {
+    char fname[256];
+    const char *error; // the file could not be used, NULL if ok
+
+    Uint16 mission;
+    Uint16 tower;
+    Uint8 *demo; // packed, see demo.h
+    Uint32 demosize;
+    int keylen;
+    Uint32 seed;
+    int robots;
+
+    vfy_result claimed;
+    unsigned int claimed_points;
+    int claimed_time;
+
+    vfy_result result;
+    unsigned int points;
+    int time;
+    int frames;
+    bool passed;
+} vfy_demo;
+
+static vfy_demo *demos = NULL;
+static int demonum = 0;
+
+/* the next demo to verify, taken by the threads */
+static int nextdemo = 0;
+static SDL_mutex *nextlock = NULL;
+
+static int cmpdemos(const void *a, const void *b) {
+    const vfy_demo *da = (const vfy_demo *) a;
+    const vfy_demo *db = (const vfy_demo *) b;
+
+    /* demos of the same tower one after the other, so that the threads
+     * seldom need to load another mission */
+    if (da->mission != db->mission)
+        return da->mission - db->mission;
+    if (da->tower != db->tower)
+        return da->tower - db->tower;
+    return strcmp(da->fname, db->fname);
+}
+
+static void chop(char *line) {
+    int l = strlen(line);
+    while ((l > 0) && ((line[l - 1] == '\n') || (line[l - 1] == '\r')))
+        line[--l] = 0;
+}
+
+/* reads one demo file, on error d.error explains what is wrong */
+static void readdemo(const char *dir, vfy_demo &d) {
+    char line[200];
+    char path[1024];
+    bool hasmission = false, hastower = false, hasresult = false;
+    bool haspoints = false, hastime = false;
+
+    d.error = NULL;
+    d.demo = NULL;
+    d.demosize = 0;
+    d.keylen = 0;
+    d.seed = 0;
+    d.robots = DEFAULT_ROBOTS;
+    d.passed = false;
+
+    snprintf(path, sizeof(path), "%s/%s", dir, d.fname);
+    FILE *in = fopen(path, "r");
+    if (!in) {
+        d.error = "can not be opened";
+        return;
+    }
+
+    while (!d.error && fgets(line, 200, in)) {
+
+        if (line[0] != '[')
+            continue;
+
+        if (!strncmp(line, "[mission]", 9)) {
+            if (!fgets(line, 200, in))
+                break;
+            chop(line);
+            for (d.mission = 0; d.mission < lev_missionnumber(); d.mission++)
+                if (!strcmp(lev_missionname(d.mission), line))
+                    break;
+            if (d.mission == lev_missionnumber())
+                d.error = "unknown mission";
+            hasmission = true;
+        } else if (!strncmp(line, "[tower]", 7)) {
+            int t;
+            if (!fgets(line, 200, in) || (sscanf(line, "%i", &t) != 1) || (t < 1) || (t > 0xffff))
+                d.error = "bad tower number";
+            else
+                d.tower = t - 1;
+            hastower = true;
+        } else if (!strncmp(line, "[result]", 8)) {
+            if (!fgets(line, 200, in))
+                break;
+            chop(line);
+            for (d.claimed = RES_FINISHED; d.claimed < NUM_RESULTS; d.claimed = (vfy_result) (d.claimed + 1))
+                if (!strcmp(resultstr[d.claimed], line))
+                    break;
+            if (d.claimed == NUM_RESULTS)
+                d.error = "unknown result";
+            hasresult = true;
+        } else if (!strncmp(line, "[points]", 8)) {
+            if (!fgets(line, 200, in) || (sscanf(line, "%u", &d.claimed_points) != 1))
+                d.error = "bad points";
+            haspoints = true;
+        } else if (!strncmp(line, "[time]", 6)) {
+            if (!fgets(line, 200, in) || (sscanf(line, "%i", &d.claimed_time) != 1))
+                d.error = "bad time";
+            hastime = true;
+        } else if (!strncmp(line, "[robots]", 8)) {
+            if (!fgets(line, 200, in) || (sscanf(line, "%i", &d.robots) != 1) || (d.robots < 1)
+                    || (d.robots > MAX_ROBOTS))
+                d.error = "bad robot count";
+        } else if (!strncmp(line, "[keys]", 6) || !strncmp(line, "[demo]", 6)) {
+            bool runs = line[1] == 'k';
+            int len = 0;
+            dem_packer p;
+
+            if (!fgets(line, 200, in) || (sscanf(line, "%i %u", &len, &d.seed) < 1)
+                    || (len <= 0) || (len > MAXDEMOLEN)) {
+                d.error = "bad demo length";
+                break;
+            }
+
+            dem_pack_start(p);
+            while (p.len < len) {
+                Uint16 keys;
+
+                if (!fgets(line, 200, in))
+                    break;
+                if (runs) {
+                    if (!dem_parse(p, line))
+                        break;
+                } else if (sscanf(line, "%hu", &keys) == 1)
+                    dem_pack(p, keys);
+                else
+                    break;
+            }
+
+            if (p.len != len)
+                d.error = "demo too short";
+
+            if (d.demo)
+                delete[] d.demo;
+            d.demo = dem_pack_finish(p, d.demosize, d.keylen);
+        }
+    }
+
+    fclose(in);
+
+    if (d.error)
+        return;
+
+    if (!hasmission || !hastower || !hasresult || !haspoints || !hastime || !d.demo)
+        d.error = "incomplete";
+}
+
+static void verifydemo(vfy_demo &d, int &loaded) {
+    gam_simresult res;
+
+    if (loaded != d.mission) {
+        if (!lev_loadmission(d.mission)) {
+            loaded = -1;
+            d.error = "mission can not be loaded";
+            return;
+        }
+        loaded = d.mission;
+    }
+
+    if (d.tower >= lev_towercount()) {
+        d.error = "the mission has no such tower";
+        return;
+    }
+
+    lev_selecttower(d.tower);
+    gam_newgame();
+    dem_stream keys;
+
+    dem_start(keys, d.demo, d.demosize);
+    gam_simulate(keys, d.keylen, d.seed, res, d.robots);
+    evt_clear();
+
+    switch (res.result) {
+    case GAME_FINISHED:
+        d.result = RES_FINISHED;
+        break;
+    case GAME_DIED:
+        d.result = res.timeout ? RES_TIMEOUT : RES_DIED;
+        break;
+    default:
+        d.result = RES_UNFINISHED;
+        break;
+    }
+
+    d.points = res.points;
+    d.time = res.resttime;
+    d.frames = res.frames;
+    d.passed = (d.result == d.claimed) && (d.points == d.claimed_points)
+            && (d.time == d.claimed_time);
+}
+
+static int worker(void *) {
+    int loaded = -1;
+
+    while (true) {
+        SDL_LockMutex(nextlock);
+        int n = nextdemo++;
+        SDL_UnlockMutex(nextlock);
+
+        if (n >= demonum)
+            break;
+
+        if (!demos[n].error)
+            verifydemo(demos[n], loaded);
+    }
+
+    lev_donethread();
+    return 0;
+}
+
+static int processors(void) {
+#ifdef _SC_NPROCESSORS_ONLN
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    if (n > 0)
+        return n;
+#endif
+    return 1;
+}
+
+int main(int argc, char *argv[]) {
+    const char *dirname = NULL;
+    const char *reportname = NULL;
+    int threads = processors();
+    bool usage = false;
+
+    for (int t = 1; t < argc; t++) {
+        if (!strncmp(argv[t], "-j", 2) && (atoi(argv[t] + 2) > 0))
+            threads = atoi(argv[t] + 2);
+        else if (!strncmp(argv[t], "-o", 2) && argv[t][2])
+            reportname = argv[t] + 2;
+        else if ((argv[t][0] != '-') && !dirname)
+            dirname = argv[t];
+        else
+            usage = true;
+    }
+
+    if (usage || !dirname) {
+        printf("usage: %s [-jN] [-oREPORT] directory\n", argv[0]);
+        return 1;
+    }
+
+    if (SDL_Init(0) < 0) {
+        printf("could not initialize SDL\n");
+        return 1;
+    }
+
+    dataarchive = new archive(open_data_file("toppler.dat"));
+
+    /* the mission list is shared by all threads, it must be complete
+     * before they start */
+    lev_findmissions();
+
+    DIR *dir = opendir(dirname);
+    if (!dir) {
+        printf("could not open %s\n", dirname);
+        return 1;
+    }
+
+    int size = 0;
+    struct dirent *e;
+    while ((e = readdir(dir)) != NULL) {
+        if (e->d_name[0] == '.')
+            continue;
+        if (demonum == size) {
+            size = size ? 2 * size : 64;
+            demos = (vfy_demo *) realloc(demos, size * sizeof(vfy_demo));
+            assert_msg(demos != NULL, "out of memory");
+        }
+        strncpy(demos[demonum].fname, e->d_name, sizeof(demos[demonum].fname) - 1);
+        demos[demonum].fname[sizeof(demos[demonum].fname) - 1] = 0;
+        readdemo(dirname, demos[demonum]);
+        demonum++;
+    }
+    closedir(dir);
+
+    qsort(demos, demonum, sizeof(vfy_demo), cmpdemos);
+
+    if (threads > demonum)
+        threads = demonum ? demonum : 1;
+
+    double start = tim_ms();
+
+    nextlock = SDL_CreateMutex();
+    if (threads == 1)
+        worker(NULL);
+    else {
+        SDL_Thread **th = new SDL_Thread *[threads];
+        for (int t = 0; t < threads; t++)
+            th[t] = SDL_CreateThread(worker, NULL);
+        for (int t = 0; t < threads; t++)
+            SDL_WaitThread(th[t], NULL);
+        delete[] th;
+    }
+    SDL_DestroyMutex(nextlock);
+
+    double ms = tim_ms() - start;
+
+    FILE *out = reportname ? fopen(reportname, "w") : stdout;
+    if (!out) {
+        printf("could not write %s\n", reportname);
+        return 1;
+    }
+
+    int passed = 0, failed = 0, broken = 0;
+    long frames = 0;
+
+    for (int n = 0; n < demonum; n++) {
+        vfy_demo &d = demos[n];
+
+        if (d.error) {
+            fprintf(out, "%s: FAIL, %s\n", d.fname, d.error);
+            broken++;
+        } else if (d.passed) {
+            fprintf(out, "%s: PASS, %s, %u points, time %i\n", d.fname,
+                    resultstr[d.result], d.points, d.time);
+            passed++;
+        } else {
+            fprintf(out, "%s: FAIL, claimed %s, %u points, time %i, replay gives %s, %u points, time %i after %i frames\n",
+                    d.fname, resultstr[d.claimed], d.claimed_points, d.claimed_time,
+                    resultstr[d.result], d.points, d.time, d.frames);
+            failed++;
+        }
+
+        if (!d.error)
+            frames += d.frames;
+
+        if (d.demo)
+            delete[] d.demo;
+    }
+
+    fprintf(out, "\n%i demos: %i passed, %i failed, %i unusable\n", demonum, passed,
+            failed, broken);
+    fprintf(out, "%i threads, %.1f ms, %.1f demos/s, %.0f frames/s\n", threads, ms,
+            ms > 0 ? demonum * 1000.0 / ms : 0.0, ms > 0 ? frames * 1000.0 / ms : 0.0);
+
+    if (out != stdout)
+        fclose(out);
+
+    free(demos);
+    lev_done();
+    delete dataarchive;
+    SDL_Quit();
+
+    return (passed == demonum) ? 0 : 1;
+}